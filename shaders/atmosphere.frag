@@ -7,6 +7,31 @@ layout(location = 2) in float inTime;
 
 layout(location = 0) out vec4 outColor;
 
+/*
+Built with -DCLASSIFY the shader only writes the class of the pixel into depth.
+Shading variants are drawn with the viewport depth range collapsed to their class
+and depth test EQUAL, fragments of other classes are rejected before they are shaded.
+Depths are always specialized with the class depths of main.cpp, defaults are the same
+*/
+layout(constant_id = 1) const float EMPTY_DEPTH = 0.749996185; //49151 / 65535
+layout(constant_id = 2) const float LIMB_DEPTH = 0.249988556; //16383 / 65535
+layout(constant_id = 3) const float DISK_DEPTH = 0.499992371; //32767 / 65535
+
+//Specialized per class, draws which are not classified test every pixel
+const int VARIANT_ANY = 0;
+const int VARIANT_LIMB = 1; //ray passes through the atmosphere only
+const int VARIANT_DISK = 2; //ray hits the planet
+layout(constant_id = 0) const int ATMOSPHERE_VARIANT = VARIANT_ANY;
+
+#ifndef CLASSIFY
+layout(early_fragment_tests) in;
+#endif
+
+//Tail of DrawConstants, quality scales the number of scattering samples
+layout(push_constant) uniform drawConstants {
+    layout(offset = 12) float quality;
+} constants;
+
 
 /*
 * Constants
@@ -63,12 +88,17 @@ float density(vec3 position, float ph) {
     return exp( -max( length(position) - RADIUS_P, 0.0f) / ph);
 }
 
+int sample_count(int samples) {
+    return max(int(float(samples) * constants.quality), 1);
+}
+
 float optic(vec3 p, vec3 q, float ph) {
-    vec3 s = ( q - p ) / float(NUM_OUT_SCATTER);
+    int out_scatter = sample_count(NUM_OUT_SCATTER);
+    vec3 s = ( q - p ) / float(out_scatter);
     vec3 v = p + s * 0.5f;
 
     float sum = 0.0f;
-    for (int i = 0; i < NUM_OUT_SCATTER; i++ ) {
+    for (int i = 0; i < out_scatter; i++ ) {
         sum += density(v, ph);
         v += s;
     }
@@ -91,11 +121,12 @@ vec3 scattering_function(vec3 position, vec3 direction, vec3 sun, vec2 roots) {
     float n_ray0 = 0.0f;
     float n_mie0 = 0.0f;
 
-    float len = ( roots.y - roots.x) / float(NUM_IN_SCATTER);
+    int in_scatter = sample_count(NUM_IN_SCATTER);
+    float len = ( roots.y - roots.x) / float(in_scatter);
     vec3 s = direction * len;
     vec3 v = position + direction * (roots.x + len * 0.5);
 
-    for (int i = 0; i < NUM_IN_SCATTER; i++, v += s) {
+    for (int i = 0; i < in_scatter; i++, v += s) {
         float d_ray = density(v, ph_rayleigh) * len;
         float d_mie = density(v, ph_mie) * len;
 
@@ -151,14 +182,25 @@ void main() {
     camera = rot * camera;
 
     vec2 roots_outer = sphere_intersect(camera, dir, RADIUS_A);
-    if(roots_outer.x > roots_outer.y) {
+#ifdef CLASSIFY
+	vec2 roots_inner = sphere_intersect(camera, dir, RADIUS_P);
+	gl_FragDepth = roots_outer.x > roots_outer.y ? EMPTY_DEPTH : (roots_inner.x > roots_inner.y ? LIMB_DEPTH : DISK_DEPTH);
+	//Empty pixels stay black, shading variants overwrite the rest
+	outColor = vec4(0.0, 0.0, 0.0, 1.0);
+#else
+    if(ATMOSPHERE_VARIANT == VARIANT_ANY && roots_outer.x > roots_outer.y) {
         outColor = vec4(fragColor, 1.0 );
         return;
     }
-	vec2 roots_inner = sphere_intersect(camera, dir, RADIUS_P);
-	roots_outer.y = min(roots_outer.y, roots_inner.x);
+	//Limb rays miss the planet, its intersection would not shorten the segment
+	if (ATMOSPHERE_VARIANT != VARIANT_LIMB) {
+		vec2 roots_inner = sphere_intersect(camera, dir, RADIUS_P);
+		roots_outer.y = min(roots_outer.y, roots_inner.x);
+	}
 
     vec3 I = scattering_function(camera, dir, sun_dir, roots_outer);
 
-	outColor = vec4( pow( I, vec3(1.0 / 2.2) ), 1.0 );
+	//Linear radiance into the HDR target, tone mapping encodes it for display
+	outColor = vec4( I, 1.0 );
+#endif
 }
\ No newline at end of file
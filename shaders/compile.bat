@@ -1,3 +1,17 @@
-D:\Libs\VulkanSDK\1.0.68.0\Bin32\glslangValidator.exe -V triangle.vert
-D:\Libs\VulkanSDK\1.0.68.0\Bin32\glslangValidator.exe -V triangle.frag
+REM Vulkan SDK of the environment, otherwise the one of the project
+if defined VULKAN_SDK (set GLSLANG="%VULKAN_SDK%\Bin\glslangValidator.exe") else (set GLSLANG=D:\Libs\VulkanSDK\1.0.68.0\Bin32\glslangValidator.exe)
+%GLSLANG% -V test.vert -o test.vert.spv
+%GLSLANG% -V test.frag -o test.frag.spv
+%GLSLANG% -V atmosphere.vert -o atmosphere.vert.spv
+%GLSLANG% -V atmosphere.frag -o atmosphere.frag.spv
+%GLSLANG% -V -DCLASSIFY atmosphere.frag -o atmosphere.classify.frag.spv
+REM Bindless variants need GL_EXT_nonuniform_qualifier, which older glslang lacks. Without them classic descriptors are used
+%GLSLANG% -V -DBINDLESS test.vert -o test.bindless.vert.spv || del test.bindless.vert.spv 2>nul
+%GLSLANG% -V -DBINDLESS atmosphere.vert -o atmosphere.bindless.vert.spv || del atmosphere.bindless.vert.spv 2>nul
+%GLSLANG% -V fullscreen.vert -o fullscreen.vert.spv
+%GLSLANG% -V tonemap.frag -o tonemap.frag.spv
+%GLSLANG% -V histogram.comp -o histogram.comp.spv
+%GLSLANG% -V exposure.comp -o exposure.comp.spv
+REM Subgroup arithmetic needs SPIR-V 1.3, glslang of a Vulkan 1.1 SDK. Without it the shared memory variant is used
+%GLSLANG% -V --target-env vulkan1.1 -DSUBGROUP exposure.comp -o exposure.subgroup.comp.spv || del exposure.subgroup.comp.spv 2>nul
 pause
\ No newline at end of file
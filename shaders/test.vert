@@ -1,12 +1,43 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+
+//All buffers live in one array, blocks alias it and push constants select slots
+layout(std430, set = 0, binding = 0) readonly buffer uniformBuffers {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} uniforms[];
+
+layout(std430, set = 0, binding = 0) readonly buffer objectBuffers {
+    mat4 world[];
+} objectArrays[];
+
+#define ubo uniforms[constants.uniformSlot]
+#define objects objectArrays[constants.objectSlot]
+#else
 layout(binding = 0) uniform uniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
+layout(std430, binding = 1) readonly buffer objectBuffer {
+    mat4 world[];
+} objects;
+#endif
+
+//Must match DrawConstants
+layout(push_constant) uniform drawConstants {
+    uint uniformSlot;
+    uint objectSlot;
+    float time;
+    float quality;
+    uint objectBase;
+} constants;
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
@@ -18,7 +49,7 @@ out gl_PerVertex {
 };
 
 void main() {
-    gl_Position = vec4(inPosition, 0.0f, 1.0f);
+    gl_Position = objects.world[constants.objectBase + gl_InstanceIndex] * vec4(inPosition, 0.0f, 1.0f);
     fragColor = inColor;
     outUV = inPosition;
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform sampler2D hdrImage;
+
+//Must match ExposureBuffer, written by exposure.comp
+layout(std430, binding = 1) readonly buffer exposureBuffer {
+    uint bins[256];
+    float averageLuminance;
+} exposure;
+
+//Must match ToneMapConstants
+layout(push_constant) uniform toneMapConstants {
+    float key;
+    uint encodeGamma;
+    vec2 uvScale;
+    vec2 uvMax;
+} constants;
+
+layout(location = 0) out vec4 outColor;
+
+//Narkowicz fit of the ACES filmic curve, highlights roll off instead of clipping
+vec3 aces(vec3 x) {
+    return clamp((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f), 0.0f, 1.0f);
+}
+
+//Interleaved gradient noise, hides quantization bands of 8-bit swapchains
+float dither(vec2 position) {
+    return fract(52.9829189f * fract(dot(position, vec2(0.06711056f, 0.00583715f)))) - 0.5f;
+}
+
+void main() {
+    //Bilinear upscale of the rendered part, taps do not reach the unrendered rest
+    vec2 uv = min(gl_FragCoord.xy * constants.uvScale, constants.uvMax);
+    vec3 radiance = textureLod(hdrImage, uv, 0.0f).rgb;
+    vec3 color = aces(radiance * (constants.key / max(exposure.averageLuminance, 1e-4f)));
+    //sRGB swapchains encode on their own
+    if (constants.encodeGamma != 0) {
+        color = pow(color, vec3(1.0f / 2.2f));
+    }
+    outColor = vec4(color + dither(gl_FragCoord.xy) / 255.0f, 1.0f);
+}
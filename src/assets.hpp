@@ -0,0 +1,353 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+Packed asset archive layout (all values little endian):
+	ArchiveHeader
+	ArchiveEntry[entryCount] : sorted by name, so lookups are a binary search
+	data blobs               : each starts at ASSET_ALIGNMENT boundary
+Since the whole archive is mapped and mapping starts at page boundary,
+every blob is handed out aligned without any copy
+*/
+const uint32_t ASSET_ALIGNMENT = 16;
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const size_t ASSET_NAME_LENGTH = 48;
+
+struct ArchiveHeader {
+	char magic[4]; //"VTPK"
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+};
+
+struct ArchiveEntry {
+	char name[ASSET_NAME_LENGTH];
+	uint64_t offset; //from the start of the archive
+	uint64_t size;
+};
+
+static_assert(sizeof(ArchiveHeader) == 16, "ArchiveHeader must stay tightly packed");
+static_assert(sizeof(ArchiveEntry) == 64, "ArchiveEntry must stay tightly packed");
+
+/*
+Non-owning view into mapped memory.
+Valid as long as the AssetLoader which returned it is alive
+*/
+struct AssetView {
+	const char* data = nullptr;
+	size_t size = 0;
+
+	//SPIR-V consumers want words, mapped data is always at least 4B aligned
+	const uint32_t* words() const {
+		return reinterpret_cast<const uint32_t*>(data);
+	}
+
+	bool empty() const {
+		return data == nullptr;
+	}
+};
+
+/*
+Read-only memory mapped file.
+Pages are loaded lazily by the OS, so nothing is read or copied until touched
+*/
+class MappedFile {
+public:
+	MappedFile() = default;
+
+	explicit MappedFile(const std::string& filename) {
+		open(filename);
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			close();
+			m_data = other.m_data;
+			m_size = other.m_size;
+#ifdef _WIN32
+			m_file = other.m_file;
+			m_mapping = other.m_mapping;
+			other.m_file = INVALID_HANDLE_VALUE;
+			other.m_mapping = nullptr;
+#endif
+			other.m_data = nullptr;
+			other.m_size = 0;
+		}
+		return *this;
+	}
+
+	void open(const std::string& filename) {
+		close();
+#ifdef _WIN32
+		m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("ERROR: Failed to open file " + filename + "!");
+		}
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(m_file, &fileSize);
+		m_size = static_cast<size_t>(fileSize.QuadPart);
+
+		//Empty files can not be mapped, they are represented by empty view
+		if (m_size > 0) {
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping == nullptr) {
+				close();
+				throw std::runtime_error("ERROR: Failed to map file " + filename + "!");
+			}
+			m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("ERROR: Failed to open file " + filename + "!");
+		}
+
+		struct stat fileStat;
+		fstat(fd, &fileStat);
+		m_size = static_cast<size_t>(fileStat.st_size);
+
+		if (m_size > 0) {
+			void* mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			m_data = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+		}
+		::close(fd); //Mapping keeps its own reference to the file
+#endif
+		if (m_size > 0 && m_data == nullptr) {
+			close();
+			throw std::runtime_error("ERROR: Failed to map file " + filename + "!");
+		}
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (m_data) {
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping) {
+			CloseHandle(m_mapping);
+		}
+		if (m_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(m_file);
+		}
+		m_mapping = nullptr;
+		m_file = INVALID_HANDLE_VALUE;
+#else
+		if (m_data) {
+			munmap(const_cast<char*>(m_data), m_size);
+		}
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	AssetView view() const {
+		AssetView assetView;
+		assetView.data = m_data;
+		assetView.size = m_size;
+		return assetView;
+	}
+
+	bool isOpen() const {
+		return m_data != nullptr;
+	}
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+#endif
+};
+
+inline bool fileExists(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	return file.good();
+}
+
+/*
+Hands out views into a mounted archive or, as a fallback, into
+individually mapped loose files (useful while iterating on shaders)
+*/
+class AssetLoader {
+public:
+	/*
+	Maps the archive and validates its index.
+	Nothing besides the header and index is touched here
+	*/
+	void mount(const std::string& archiveName) {
+		m_archive.open(archiveName);
+		AssetView archive = m_archive.view();
+
+		if (archive.size < sizeof(ArchiveHeader)) {
+			throw std::runtime_error("ERROR: Asset archive " + archiveName + " is truncated!");
+		}
+		m_header = reinterpret_cast<const ArchiveHeader*>(archive.data);
+		if (memcmp(m_header->magic, "VTPK", 4) != 0 || m_header->version != ASSET_ARCHIVE_VERSION) {
+			throw std::runtime_error("ERROR: " + archiveName + " is not a supported asset archive!");
+		}
+		if (m_header->entryCount > (archive.size - sizeof(ArchiveHeader)) / sizeof(ArchiveEntry)) {
+			throw std::runtime_error("ERROR: Asset archive " + archiveName + " has corrupted index!");
+		}
+		m_entries = reinterpret_cast<const ArchiveEntry*>(archive.data + sizeof(ArchiveHeader));
+
+		for (uint32_t i = 0; i < m_header->entryCount; i++) {
+			//Sum of corrupted values could wrap around, each is compared on its own
+			if (m_entries[i].offset > archive.size || m_entries[i].size > archive.size - m_entries[i].offset) {
+				throw std::runtime_error("ERROR: Asset archive " + archiveName + " has corrupted index!");
+			}
+		}
+	}
+
+	bool isMounted() const {
+		return m_archive.isOpen();
+	}
+
+	bool contains(const std::string& name) const {
+		return isMounted() && findEntry(name) != nullptr;
+	}
+
+	/*
+	Asset is either in the archive or a loose file
+	*/
+	bool exists(const std::string& name) const {
+		return contains(name) || fileExists(name);
+	}
+
+	/*
+	Returns view of the asset, archive has priority over loose files
+	*/
+	AssetView load(const std::string& name) {
+		if (isMounted()) {
+			const ArchiveEntry* entry = findEntry(name);
+			if (entry) {
+				AssetView assetView;
+				assetView.data = m_archive.view().data + entry->offset;
+				assetView.size = static_cast<size_t>(entry->size);
+				return assetView;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_looseFilesMutex);
+		auto it = m_looseFiles.find(name);
+		if (it == m_looseFiles.end()) {
+			it = m_looseFiles.emplace(name, MappedFile(name)).first;
+		}
+		return it->second.view();
+	}
+
+	/*
+	Unmaps loose file once its content was consumed eg. by vkCreateShaderModule
+	*/
+	void release(const std::string& name) {
+		std::lock_guard<std::mutex> lock(m_looseFilesMutex);
+		m_looseFiles.erase(name);
+	}
+
+private:
+	const ArchiveEntry* findEntry(const std::string& name) const {
+		const ArchiveEntry* begin = m_entries;
+		const ArchiveEntry* end = m_entries + m_header->entryCount;
+		const ArchiveEntry* it = std::lower_bound(begin, end, name, [](const ArchiveEntry& entry, const std::string& key) {
+			return strncmp(entry.name, key.c_str(), ASSET_NAME_LENGTH) < 0;
+		});
+
+		if (it != end && strncmp(it->name, name.c_str(), ASSET_NAME_LENGTH) == 0) {
+			return it;
+		}
+		return nullptr;
+	}
+
+	MappedFile									m_archive;
+	const ArchiveHeader*						m_header = nullptr;
+	const ArchiveEntry*							m_entries = nullptr;
+	std::unordered_map<std::string, MappedFile>	m_looseFiles;
+	std::mutex									m_looseFilesMutex; //startup tasks load assets concurrently
+};
+
+/*
+Packs given files into one archive, names are stored as passed in
+so they can be requested by the same relative path later
+*/
+inline void writeAssetArchive(const std::string& archiveName, std::vector<std::string> files) {
+	std::sort(files.begin(), files.end());
+	files.erase(std::unique(files.begin(), files.end()), files.end());
+
+	ArchiveHeader header = {};
+	memcpy(header.magic, "VTPK", 4);
+	header.version = ASSET_ARCHIVE_VERSION;
+	header.entryCount = static_cast<uint32_t>(files.size());
+
+	std::vector<ArchiveEntry> entries(files.size());
+	std::vector<MappedFile> contents(files.size());
+	uint64_t offset = sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry);
+
+	for (size_t i = 0; i < files.size(); i++) {
+		if (files[i].size() >= ASSET_NAME_LENGTH) {
+			throw std::runtime_error("ERROR: Asset name " + files[i] + " is too long for the archive!");
+		}
+		contents[i].open(files[i]);
+
+		offset = (offset + ASSET_ALIGNMENT - 1) & ~static_cast<uint64_t>(ASSET_ALIGNMENT - 1);
+		memcpy(entries[i].name, files[i].c_str(), files[i].size()); //Rest stays zeroed
+		entries[i].offset = offset;
+		entries[i].size = contents[i].view().size;
+		offset += entries[i].size;
+	}
+
+	std::ofstream archive(archiveName, std::ios::binary | std::ios::trunc);
+	if (!archive.is_open()) {
+		throw std::runtime_error("ERROR: Failed to create asset archive " + archiveName + "!");
+	}
+
+	archive.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	archive.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+
+	const char padding[ASSET_ALIGNMENT] = {};
+	for (size_t i = 0; i < files.size(); i++) {
+		uint64_t position = static_cast<uint64_t>(archive.tellp());
+		archive.write(padding, static_cast<std::streamsize>(entries[i].offset - position));
+		AssetView content = contents[i].view();
+		archive.write(content.data, content.size);
+	}
+
+	if (!archive.good()) {
+		throw std::runtime_error("ERROR: Failed to write asset archive " + archiveName + "!");
+	}
+}
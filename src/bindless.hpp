@@ -0,0 +1,248 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+/*
+Upper bounds of the bindless arrays, clamped further by device limits
+*/
+const uint32_t BINDLESS_MAX_BUFFERS = 16384;
+const uint32_t BINDLESS_MAX_IMAGES = 16384;
+
+const uint32_t BINDLESS_BINDING_BUFFERS = 0;
+const uint32_t BINDLESS_BINDING_IMAGES = 1;
+
+/*
+Hands out array slots. Released slots are retired with the frame which
+released them and reused only once that frame completed on the GPU,
+so descriptors still read by frames in flight are never overwritten
+*/
+class BindlessSlotAllocator {
+public:
+	void init(uint32_t capacity) {
+		m_capacity = capacity;
+		m_next = 0;
+		m_free.clear();
+		m_retired.clear();
+	}
+
+	uint32_t allocate() {
+		if (!m_free.empty()) {
+			uint32_t slot = m_free.back();
+			m_free.pop_back();
+			return slot;
+		}
+		if (m_next == m_capacity) {
+			throw std::runtime_error("ERROR: Bindless descriptor array is full!");
+		}
+		return m_next++;
+	}
+
+	void release(uint32_t slot, uint64_t frame) {
+		m_retired.push_back({ frame, slot });
+	}
+
+	/*
+	Recycles slots released in frames up to completedFrame
+	*/
+	void collect(uint64_t completedFrame) {
+		while (!m_retired.empty() && m_retired.front().frame <= completedFrame) {
+			m_free.push_back(m_retired.front().slot);
+			m_retired.pop_front();
+		}
+	}
+
+	uint32_t capacity() const {
+		return m_capacity;
+	}
+
+	uint32_t used() const {
+		return m_next - static_cast<uint32_t>(m_free.size());
+	}
+
+private:
+	struct RetiredSlot {
+		uint64_t frame;
+		uint32_t slot;
+	};
+
+	uint32_t				m_capacity = 0;
+	uint32_t				m_next = 0;
+	std::vector<uint32_t>	m_free;
+	std::deque<RetiredSlot>	m_retired;
+};
+
+/*
+One descriptor set holding every buffer and image as large, partially bound
+arrays (VK_EXT_descriptor_indexing). It is bound once, shaders pick resources
+by slot indices passed in push constants, so draws need no set binds or updates.
+Slots are written with update-after-bind, registering resources does not
+invalidate recorded command buffers as long as pending frames do not use the slot.
+Storage buffers share one binding, shaders alias it with their own block types
+*/
+class BindlessDescriptors {
+public:
+	void init(VkDevice device, const VkPhysicalDeviceLimits& limits) {
+#ifdef VK_EXT_descriptor_indexing
+		m_device = device;
+		uint32_t bufferCount = std::min({ BINDLESS_MAX_BUFFERS, limits.maxPerStageDescriptorStorageBuffers, limits.maxDescriptorSetStorageBuffers });
+		uint32_t imageCount = std::min({ BINDLESS_MAX_IMAGES, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages });
+		m_buffers.init(bufferCount);
+		m_images.init(imageCount);
+
+		VkDescriptorSetLayoutBinding bindings[2] = {};
+		bindings[0].binding = BINDLESS_BINDING_BUFFERS;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].descriptorCount = bufferCount;
+		bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+		bindings[1].binding = BINDLESS_BINDING_IMAGES;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[1].descriptorCount = imageCount;
+		bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+		//Unused slots may stay empty and may be written while frames using other slots are in flight
+		const VkDescriptorBindingFlagsEXT flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+		VkDescriptorBindingFlagsEXT bindingFlags[2] = { flags, flags };
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = 2;
+		bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		layoutInfo.bindingCount = 2;
+		layoutInfo.pBindings = bindings;
+
+		if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_layout) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create bindless descriptor set layout!");
+		}
+
+		VkDescriptorPoolSize poolSizes[2] = {};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[0].descriptorCount = bufferCount;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[1].descriptorCount = imageCount;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.poolSizeCount = 2;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.maxSets = 1;
+
+		if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pool) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create bindless descriptor pool!");
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_layout;
+
+		if (vkAllocateDescriptorSets(m_device, &allocInfo, &m_set) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to allocate bindless descriptor set!");
+		}
+#else
+		throw std::runtime_error("ERROR: Vulkan headers without VK_EXT_descriptor_indexing, bindless is not available!");
+#endif
+	}
+
+	void cleanup() {
+		if (m_pool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+			m_pool = VK_NULL_HANDLE;
+		}
+		if (m_layout != VK_NULL_HANDLE) {
+			vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+			m_layout = VK_NULL_HANDLE;
+		}
+	}
+
+	uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) {
+		uint32_t slot = m_buffers.allocate();
+
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = buffer;
+		bufferInfo.offset = offset;
+		bufferInfo.range = range;
+
+		VkWriteDescriptorSet write = makeWrite(BINDLESS_BINDING_BUFFERS, slot, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		write.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+		return slot;
+	}
+
+	uint32_t addImage(VkImageView imageView, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+		uint32_t slot = m_images.allocate();
+
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.sampler = sampler;
+		imageInfo.imageView = imageView;
+		imageInfo.imageLayout = layout;
+
+		VkWriteDescriptorSet write = makeWrite(BINDLESS_BINDING_IMAGES, slot, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+		return slot;
+	}
+
+	/*
+	Resource may be destroyed once frame completed, its slot is recycled by collect
+	*/
+	void releaseBuffer(uint32_t slot, uint64_t frame) {
+		m_buffers.release(slot, frame);
+	}
+
+	void releaseImage(uint32_t slot, uint64_t frame) {
+		m_images.release(slot, frame);
+	}
+
+	void collect(uint64_t completedFrame) {
+		m_buffers.collect(completedFrame);
+		m_images.collect(completedFrame);
+	}
+
+	VkDescriptorSetLayout layout() const {
+		return m_layout;
+	}
+
+	VkDescriptorSet set() const {
+		return m_set;
+	}
+
+	const BindlessSlotAllocator& buffers() const {
+		return m_buffers;
+	}
+
+	const BindlessSlotAllocator& images() const {
+		return m_images;
+	}
+
+private:
+	VkWriteDescriptorSet makeWrite(uint32_t binding, uint32_t slot, VkDescriptorType type) const {
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = m_set;
+		write.dstBinding = binding;
+		write.dstArrayElement = slot;
+		write.descriptorCount = 1;
+		write.descriptorType = type;
+		return write;
+	}
+
+	VkDevice				m_device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout	m_layout = VK_NULL_HANDLE;
+	VkDescriptorPool		m_pool = VK_NULL_HANDLE;
+	VkDescriptorSet			m_set = VK_NULL_HANDLE;
+	BindlessSlotAllocator	m_buffers;
+	BindlessSlotAllocator	m_images;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/*
+Longest wall time one realtime frame may advance the simulation by,
+after a hitch the simulation slows down instead of running hundreds of steps
+*/
+const double CLOCK_MAX_FRAME_SECONDS = 0.25;
+
+/*
+Time seen by the simulation and by rendering.
+Simulation advances in fixed steps, tick returns how many steps the frame runs.
+Render time lies between the last step and the next one, alpha is the fraction,
+so animation is smooth at any frame rate while simulation results do not depend on it.
+	Realtime: frames advance by the wall time elapsed since the previous frame
+	Offline: frame N (from 0) is at exactly N / fps seconds, however long rendering takes,
+			so batch renders and benchmarks produce identical frames on every run and machine
+*/
+class SimulationClock {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	/*
+	offlineFps of 0 runs in realtime
+	*/
+	void init(double stepRate, double offlineFps) {
+		m_stepRate = std::max(stepRate, 1.0);
+		m_stepSeconds = 1.0 / m_stepRate;
+		m_offlineFps = offlineFps;
+		m_frames = 0;
+		m_steps = 0;
+		m_time = 0.0;
+		m_lastFrame = Clock::time_point();
+	}
+
+	bool offline() const {
+		return m_offlineFps > 0.0;
+	}
+
+	/*
+	Advances to the next frame, returns the number of fixed steps to simulate
+	*/
+	uint32_t tick() {
+		if (offline()) {
+			//Computed from the frame number, so no error accumulates over long renders
+			m_time = static_cast<double>(m_frames) / m_offlineFps;
+		}
+		else {
+			Clock::time_point now = Clock::now();
+			if (m_lastFrame != Clock::time_point()) {
+				double elapsed = std::chrono::duration<double>(now - m_lastFrame).count();
+				m_time += std::min(elapsed, CLOCK_MAX_FRAME_SECONDS);
+			}
+			m_lastFrame = now;
+		}
+
+		//Epsilon keeps exact step boundaries (time 1/fps * fps) from rounding down
+		uint64_t steps = static_cast<uint64_t>(std::floor(m_time * m_stepRate + 1e-9));
+		uint32_t newSteps = static_cast<uint32_t>(steps - std::min(steps, m_steps));
+		m_steps = std::max(steps, m_steps);
+		m_frames++;
+		return newSteps;
+	}
+
+	/*
+	Time of the last simulated step
+	*/
+	double simulationTime() const {
+		return static_cast<double>(m_steps) * m_stepSeconds;
+	}
+
+	/*
+	Time the frame shows, simulationTime() <= renderTime() < simulationTime() + stepSeconds()
+	*/
+	double renderTime() const {
+		return m_time;
+	}
+
+	/*
+	Interpolation factor between the last simulated state and the next one
+	*/
+	double alpha() const {
+		return std::min(std::max((m_time - simulationTime()) / m_stepSeconds, 0.0), 1.0);
+	}
+
+	double stepSeconds() const {
+		return m_stepSeconds;
+	}
+
+	/*
+	Number of frames ticked so far
+	*/
+	uint64_t frames() const {
+		return m_frames;
+	}
+
+private:
+	double				m_stepRate = 60.0;
+	double				m_stepSeconds = 1.0 / 60.0;
+	double				m_offlineFps = 0.0;
+	uint64_t			m_frames = 0;
+	uint64_t			m_steps = 0;
+	double				m_time = 0.0;
+	Clock::time_point	m_lastFrame;
+};
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+/*
+Validation, debug messages, object names and labels exist in debug builds only.
+In release DebugMessenger is an empty class, calls on it compile to nothing
+*/
+#ifdef _DEBUG
+#define VULKAN_DEBUG 1
+#else
+#define VULKAN_DEBUG 0
+#endif
+
+/*
+Vulkan handles for object names: dispatchable ones are pointers,
+non-dispatchable ones are pointers or uint64_t on 32-bit builds
+*/
+template<typename T>
+inline uint64_t debugObjectHandle(T* handle) {
+	return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+}
+
+inline uint64_t debugObjectHandle(uint64_t handle) {
+	return handle;
+}
+
+#if VULKAN_DEBUG
+
+/*
+Bounded multi-producer multi-consumer queue without locks. Every cell carries
+a sequence number telling whether it is free for the producer at a position or
+filled for the consumer at it, so threads only race on the position counters
+(D. Vyukov's bounded queue). Push fails instead of waiting when the queue is full
+*/
+template<typename T>
+class BoundedQueue {
+public:
+	/*
+	Capacity is rounded up to a power of two
+	*/
+	explicit BoundedQueue(size_t capacity) {
+		size_t size = 1;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		m_mask = size - 1;
+		m_cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; i++) {
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	bool push(T&& value) {
+		size_t position = m_enqueue.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;) {
+			cell = &m_cells[position & m_mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (difference == 0) {
+				if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = m_enqueue.load(std::memory_order_relaxed);
+			}
+		}
+		cell->value = std::move(value);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value) {
+		size_t position = m_dequeue.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;) {
+			cell = &m_cells[position & m_mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+			if (difference == 0) {
+				if (m_dequeue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = m_dequeue.load(std::memory_order_relaxed);
+			}
+		}
+		value = std::move(cell->value);
+		cell->sequence.store(position + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<Cell[]>	m_cells;
+	size_t					m_mask = 0;
+	//Producers and consumer touch different counters, keep them on separate cache lines
+	alignas(64) std::atomic<size_t>	m_enqueue{ 0 };
+	alignas(64) std::atomic<size_t>	m_dequeue{ 0 };
+};
+
+/*
+Messages waiting for the logger, repeated messages are reported every
+interval as counts instead of being printed again
+*/
+const size_t DEBUG_MESSAGE_QUEUE_SIZE = 1024;
+const double DEBUG_REPEAT_REPORT_SECONDS = 5.0;
+
+enum class DebugSeverity {
+	Info,
+	Warning,
+	Performance,
+	Error
+};
+
+/*
+Receives validation messages through VK_EXT_debug_utils (VK_EXT_debug_report on older
+loaders). The callback runs on whichever thread made the Vulkan call, it only formats
+the message and pushes it to a lock-free queue. Logger thread prints new messages,
+counts repeated ones and reports the counts periodically.
+Message counts per severity are kept for the profiler, performance warnings included
+*/
+class DebugMessenger {
+public:
+	DebugMessenger()
+		: m_queue(DEBUG_MESSAGE_QUEUE_SIZE) {
+		for (auto& count : m_counts) {
+			count.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	~DebugMessenger() {
+		stopLogger();
+	}
+
+	/*
+	Picks the messenger extension, the result is enabled on the instance
+	*/
+	const char* selectExtension(const std::vector<VkExtensionProperties>& available) {
+		m_utils = false;
+#ifdef VK_EXT_debug_utils
+		for (const auto& extension : available) {
+			if (strcmp(extension.extensionName, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0) {
+				m_utils = true;
+				return VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+			}
+		}
+#else
+		(void)available;
+#endif
+		return VK_EXT_DEBUG_REPORT_EXTENSION_NAME;
+	}
+
+	void init(VkInstance instance) {
+		m_instance = instance;
+		m_loggerThread = std::thread([this]() { loggerLoop(); });
+
+#ifdef VK_EXT_debug_utils
+		if (m_utils) {
+			auto createMessenger = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+			m_setObjectName = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT");
+			m_beginLabel = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+			m_endLabel = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+
+			VkDebugUtilsMessengerCreateInfoEXT createInfo = {};
+			createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+			createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+			createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+			createInfo.pfnUserCallback = utilsCallback;
+			createInfo.pUserData = this;
+			if (!createMessenger || createMessenger(instance, &createInfo, nullptr, &m_messenger) != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to set up debug messenger!");
+			}
+			return;
+		}
+#endif
+		auto createCallback = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
+
+		VkDebugReportCallbackCreateInfoEXT createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
+		createInfo.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
+		createInfo.pfnCallback = reportCallback;
+		createInfo.pUserData = this;
+		if (!createCallback || createCallback(instance, &createInfo, nullptr, &m_reportCallback) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to set up debug callback!");
+		}
+	}
+
+	/*
+	Object names need the device they belong to
+	*/
+	void setDevice(VkDevice device) {
+		m_device = device;
+	}
+
+	/*
+	Names appear in validation messages instead of bare handles. Core object
+	types have the same values in VkDebugReportObjectTypeEXT and VkObjectType
+	*/
+	void setObjectName(VkDebugReportObjectTypeEXT type, uint64_t handle, const char* name) const {
+#ifdef VK_EXT_debug_utils
+		if (m_setObjectName && m_device != VK_NULL_HANDLE) {
+			VkDebugUtilsObjectNameInfoEXT nameInfo = {};
+			nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+			nameInfo.objectType = static_cast<VkObjectType>(type);
+			nameInfo.objectHandle = handle;
+			nameInfo.pObjectName = name;
+			m_setObjectName(m_device, &nameInfo);
+		}
+#else
+		(void)type;
+		(void)handle;
+		(void)name;
+#endif
+	}
+
+	/*
+	Labels group commands, messages about them name the enclosing labels
+	*/
+	void beginLabel(VkCommandBuffer commandBuffer, const char* name) const {
+#ifdef VK_EXT_debug_utils
+		if (m_beginLabel) {
+			VkDebugUtilsLabelEXT label = {};
+			label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+			label.pLabelName = name;
+			m_beginLabel(commandBuffer, &label);
+		}
+#else
+		(void)commandBuffer;
+		(void)name;
+#endif
+	}
+
+	void endLabel(VkCommandBuffer commandBuffer) const {
+#ifdef VK_EXT_debug_utils
+		if (m_endLabel) {
+			m_endLabel(commandBuffer);
+		}
+#else
+		(void)commandBuffer;
+#endif
+	}
+
+	uint64_t errors() const {
+		return m_counts[static_cast<int>(DebugSeverity::Error)].load(std::memory_order_relaxed);
+	}
+
+	uint64_t warnings() const {
+		return m_counts[static_cast<int>(DebugSeverity::Warning)].load(std::memory_order_relaxed);
+	}
+
+	uint64_t performanceWarnings() const {
+		return m_counts[static_cast<int>(DebugSeverity::Performance)].load(std::memory_order_relaxed);
+	}
+
+	/*
+	Must run before the instance is destroyed, remaining messages and repeat counts are printed
+	*/
+	void cleanup() {
+#ifdef VK_EXT_debug_utils
+		if (m_messenger != VK_NULL_HANDLE) {
+			auto destroyMessenger = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(m_instance, "vkDestroyDebugUtilsMessengerEXT");
+			if (destroyMessenger) {
+				destroyMessenger(m_instance, m_messenger, nullptr);
+			}
+			m_messenger = VK_NULL_HANDLE;
+		}
+#endif
+		if (m_reportCallback != VK_NULL_HANDLE) {
+			auto destroyCallback = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(m_instance, "vkDestroyDebugReportCallbackEXT");
+			if (destroyCallback) {
+				destroyCallback(m_instance, m_reportCallback, nullptr);
+			}
+			m_reportCallback = VK_NULL_HANDLE;
+		}
+		stopLogger();
+	}
+
+private:
+	struct Message {
+		DebugSeverity severity;
+		int32_t id;
+		std::string text;
+	};
+
+	struct Repeat {
+		uint64_t count;
+		uint64_t reported;
+		std::string summary;
+	};
+
+	static const char* severityName(DebugSeverity severity) {
+		switch (severity) {
+		case DebugSeverity::Info: return "info";
+		case DebugSeverity::Warning: return "warning";
+		case DebugSeverity::Performance: return "performance";
+		case DebugSeverity::Error: return "error";
+		}
+		return "unknown";
+	}
+
+	void post(DebugSeverity severity, int32_t id, std::string text) {
+		m_counts[static_cast<int>(severity)].fetch_add(1, std::memory_order_relaxed);
+		if (!m_queue.push({ severity, id, std::move(text) })) {
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+#ifdef VK_EXT_debug_utils
+	static VKAPI_ATTR VkBool32 VKAPI_CALL utilsCallback(
+		VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+		VkDebugUtilsMessageTypeFlagsEXT types,
+		const VkDebugUtilsMessengerCallbackDataEXT* data,
+		void* userData) {
+
+		DebugSeverity messageSeverity = DebugSeverity::Info;
+		if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+			messageSeverity = DebugSeverity::Error;
+		}
+		else if (types & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) {
+			messageSeverity = DebugSeverity::Performance;
+		}
+		else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+			messageSeverity = DebugSeverity::Warning;
+		}
+
+		std::ostringstream text;
+		text << (data->pMessageIdName ? data->pMessageIdName : "") << ": " << data->pMessage;
+		for (uint32_t i = 0; i < data->objectCount; i++) {
+			const VkDebugUtilsObjectNameInfoEXT& object = data->pObjects[i];
+			text << "\n  object " << (object.pObjectName ? object.pObjectName : "unnamed") << " (0x" << std::hex << object.objectHandle << std::dec << ")";
+		}
+		for (uint32_t i = 0; i < data->cmdBufLabelCount; i++) {
+			text << "\n  in " << data->pCmdBufLabels[i].pLabelName;
+		}
+
+		reinterpret_cast<DebugMessenger*>(userData)->post(messageSeverity, data->messageIdNumber, text.str());
+		return VK_FALSE;
+	}
+#endif
+
+	static VKAPI_ATTR VkBool32 VKAPI_CALL reportCallback(
+		VkDebugReportFlagsEXT flags,
+		VkDebugReportObjectTypeEXT objectType,
+		uint64_t object,
+		size_t location,
+		int32_t code,
+		const char* layerPrefix,
+		const char* message,
+		void* userData) {
+
+		DebugSeverity severity = DebugSeverity::Info;
+		if (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) {
+			severity = DebugSeverity::Error;
+		}
+		else if (flags & VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT) {
+			severity = DebugSeverity::Performance;
+		}
+		else if (flags & VK_DEBUG_REPORT_WARNING_BIT_EXT) {
+			severity = DebugSeverity::Warning;
+		}
+
+		std::ostringstream text;
+		text << layerPrefix << ": " << message << "\n  object type " << objectType << " (0x" << std::hex << object << std::dec << ")";
+		reinterpret_cast<DebugMessenger*>(userData)->post(severity, code, text.str());
+		(void)location;
+		return VK_FALSE;
+	}
+
+	/*
+	Messages are identified by id and text, so one check failing
+	for different objects is still reported for each of them
+	*/
+	void loggerLoop() {
+		std::unordered_map<std::string, Repeat> seen;
+		auto lastReport = std::chrono::steady_clock::now();
+		bool stopping = false;
+		while (!stopping) {
+			stopping = m_stop.load(std::memory_order_acquire);
+
+			std::ostringstream output;
+			Message message;
+			while (m_queue.pop(message)) {
+				std::string key = std::to_string(message.id) + message.text;
+				auto found = seen.find(key);
+				if (found != seen.end()) {
+					found->second.count++;
+					continue;
+				}
+				std::string summary = message.text.substr(0, message.text.find('\n'));
+				seen.emplace(key, Repeat{ 1, 1, summary });
+				output << "Validation " << severityName(message.severity) << ": " << message.text << "\n";
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			if (stopping || std::chrono::duration<double>(now - lastReport).count() >= DEBUG_REPEAT_REPORT_SECONDS) {
+				lastReport = now;
+				for (auto& entry : seen) {
+					Repeat& repeat = entry.second;
+					if (repeat.count > repeat.reported) {
+						output << "Validation: repeated " << repeat.count - repeat.reported << " more times (" << repeat.count << " total): " << repeat.summary << "\n";
+						repeat.reported = repeat.count;
+					}
+				}
+				uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+				if (dropped > 0) {
+					output << "Validation: " << dropped << " messages dropped, logger fell behind\n";
+				}
+			}
+
+			std::string text = output.str();
+			if (!text.empty()) {
+				std::cerr << text << std::flush;
+			}
+			if (!stopping) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+	}
+
+	void stopLogger() {
+		if (m_loggerThread.joinable()) {
+			m_stop.store(true, std::memory_order_release);
+			m_loggerThread.join();
+		}
+	}
+
+	VkInstance					m_instance = VK_NULL_HANDLE;
+	VkDevice					m_device = VK_NULL_HANDLE;
+	bool						m_utils = false;
+	VkDebugReportCallbackEXT	m_reportCallback = VK_NULL_HANDLE;
+#ifdef VK_EXT_debug_utils
+	VkDebugUtilsMessengerEXT	m_messenger = VK_NULL_HANDLE;
+	PFN_vkSetDebugUtilsObjectNameEXT	m_setObjectName = nullptr;
+	PFN_vkCmdBeginDebugUtilsLabelEXT	m_beginLabel = nullptr;
+	PFN_vkCmdEndDebugUtilsLabelEXT		m_endLabel = nullptr;
+#endif
+	BoundedQueue<Message>		m_queue;
+	std::atomic<uint64_t>		m_counts[4]; //per DebugSeverity
+	std::atomic<uint64_t>		m_dropped{ 0 };
+	std::atomic<bool>			m_stop{ false };
+	std::thread					m_loggerThread;
+};
+
+#else
+
+/*
+Release build: nothing is created, named or labeled
+*/
+class DebugMessenger {
+public:
+	const char* selectExtension(const std::vector<VkExtensionProperties>&) { return nullptr; }
+	void init(VkInstance) {}
+	void setDevice(VkDevice) {}
+	void setObjectName(VkDebugReportObjectTypeEXT, uint64_t, const char*) const {}
+	void beginLabel(VkCommandBuffer, const char*) const {}
+	void endLabel(VkCommandBuffer) const {}
+	uint64_t errors() const { return 0; }
+	uint64_t warnings() const { return 0; }
+	uint64_t performanceWarnings() const { return 0; }
+	void cleanup() {}
+};
+
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+
+/*
+GPU objects waiting for destruction. Each is queued with the GpuTimeline value
+of the last submission which may use it and destroyed by collect once the GPU
+completed that value, so replacing resources never drains the device.
+Objects can be queued from any thread, collect runs once per frame
+*/
+class DeletionQueue {
+public:
+	void init(VkDevice device) {
+		m_device = device;
+	}
+
+	void push(uint64_t value, std::function<void()> destroy) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.push_back({ value, std::move(destroy) });
+	}
+
+	void destroyBuffer(VkBuffer buffer, uint64_t value) {
+		VkDevice device = m_device;
+		push(value, [device, buffer]() { vkDestroyBuffer(device, buffer, nullptr); });
+	}
+
+	void freeMemory(VkDeviceMemory memory, uint64_t value) {
+		VkDevice device = m_device;
+		push(value, [device, memory]() { vkFreeMemory(device, memory, nullptr); });
+	}
+
+	void destroyImageView(VkImageView view, uint64_t value) {
+		VkDevice device = m_device;
+		push(value, [device, view]() { vkDestroyImageView(device, view, nullptr); });
+	}
+
+	void destroyFramebuffer(VkFramebuffer framebuffer, uint64_t value) {
+		VkDevice device = m_device;
+		push(value, [device, framebuffer]() { vkDestroyFramebuffer(device, framebuffer, nullptr); });
+	}
+
+	void destroyPipeline(VkPipeline pipeline, uint64_t value) {
+		VkDevice device = m_device;
+		push(value, [device, pipeline]() { vkDestroyPipeline(device, pipeline, nullptr); });
+	}
+
+	void destroyPipelineLayout(VkPipelineLayout layout, uint64_t value) {
+		VkDevice device = m_device;
+		push(value, [device, layout]() { vkDestroyPipelineLayout(device, layout, nullptr); });
+	}
+
+	void destroyRenderPass(VkRenderPass renderPass, uint64_t value) {
+		VkDevice device = m_device;
+		push(value, [device, renderPass]() { vkDestroyRenderPass(device, renderPass, nullptr); });
+	}
+
+	void destroySwapchain(VkSwapchainKHR swapchain, uint64_t value) {
+		VkDevice device = m_device;
+		push(value, [device, swapchain]() { vkDestroySwapchainKHR(device, swapchain, nullptr); });
+	}
+
+	/*
+	Destroys objects whose last use completed
+	*/
+	void collect(uint64_t completedValue) {
+		std::vector<Entry> ready;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto finished = std::stable_partition(m_pending.begin(), m_pending.end(), [completedValue](const Entry& entry) {
+				return entry.value > completedValue;
+			});
+			ready.assign(std::make_move_iterator(finished), std::make_move_iterator(m_pending.end()));
+			m_pending.erase(finished, m_pending.end());
+		}
+		for (auto& entry : ready) {
+			entry.destroy();
+		}
+	}
+
+	/*
+	Destroys everything, the GPU must be idle
+	*/
+	void flush() {
+		collect(UINT64_MAX);
+	}
+
+	size_t size() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_pending.size();
+	}
+
+private:
+	struct Entry {
+		uint64_t value;
+		std::function<void()> destroy;
+	};
+
+	VkDevice			m_device = VK_NULL_HANDLE;
+	std::mutex			m_mutex;
+	std::vector<Entry>	m_pending;
+};
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+/*
+Sets per descriptor pool, pool sizes scale with it
+*/
+const uint32_t DESCRIPTOR_POOL_SETS = 256;
+
+/*
+Average descriptor counts per set used to size new pools.
+Pools which run out of one type are not an error, allocator just chains another
+*/
+struct DescriptorPoolRatio {
+	VkDescriptorType type;
+	float perSet;
+};
+
+const DescriptorPoolRatio DESCRIPTOR_POOL_RATIOS[] = {
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+	{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+	{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2.0f },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+	{ VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f }
+};
+
+/*
+Growable descriptor set allocator. Sets come from the current pool, when it is
+exhausted (or fragmented) a new pool is chained. Pools never free sets one by one:
+a released set waits in a list of its layout and the next allocation of that layout
+reuses it. reset() recycles all pools at once, so an allocator per frame slot can
+hand out transient sets and reset once the slot's frame finished on the GPU
+*/
+class DescriptorAllocator {
+public:
+	void init(VkDevice device) {
+		m_device = device;
+	}
+
+	void cleanup() {
+		for (VkDescriptorPool pool : m_usedPools) {
+			vkDestroyDescriptorPool(m_device, pool, nullptr);
+		}
+		for (VkDescriptorPool pool : m_freePools) {
+			vkDestroyDescriptorPool(m_device, pool, nullptr);
+		}
+		m_usedPools.clear();
+		m_freePools.clear();
+		m_releasedSets.clear();
+		m_currentPool = VK_NULL_HANDLE;
+	}
+
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout) {
+		//Startup tasks and swapchain recreation allocate concurrently
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto released = m_releasedSets.find(layout);
+		if (released != m_releasedSets.end() && !released->second.empty()) {
+			VkDescriptorSet set = released->second.back();
+			released->second.pop_back();
+			return set;
+		}
+
+		if (m_currentPool == VK_NULL_HANDLE) {
+			m_currentPool = grabPool();
+		}
+
+		VkDescriptorSet set;
+		if (tryAllocate(layout, set)) {
+			return set;
+		}
+
+		//Vulkan 1.0 does not tell exhaustion apart from other failures, fresh pool decides
+		m_currentPool = grabPool();
+		if (!tryAllocate(layout, set)) {
+			throw std::runtime_error("ERROR: Failed to allocate descriptor set!");
+		}
+		return set;
+	}
+
+	/*
+	Set is rewritten by its next user, GPU must not use it anymore
+	*/
+	void release(VkDescriptorSet set, VkDescriptorSetLayout layout) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_releasedSets[layout].push_back(set);
+	}
+
+	/*
+	All sets allocated so far become invalid, GPU must not use them anymore
+	*/
+	void reset() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_releasedSets.clear();
+		for (VkDescriptorPool pool : m_usedPools) {
+			vkResetDescriptorPool(m_device, pool, 0);
+			m_freePools.push_back(pool);
+		}
+		m_usedPools.clear();
+		m_currentPool = VK_NULL_HANDLE;
+	}
+
+	size_t poolCount() const {
+		return m_usedPools.size() + m_freePools.size();
+	}
+
+private:
+	bool tryAllocate(VkDescriptorSetLayout layout, VkDescriptorSet& set) {
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_currentPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		return vkAllocateDescriptorSets(m_device, &allocInfo, &set) == VK_SUCCESS;
+	}
+
+	VkDescriptorPool grabPool() {
+		VkDescriptorPool pool;
+		if (!m_freePools.empty()) {
+			pool = m_freePools.back();
+			m_freePools.pop_back();
+		}
+		else {
+			pool = createPool();
+		}
+		m_usedPools.push_back(pool);
+		return pool;
+	}
+
+	VkDescriptorPool createPool() {
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const auto& ratio : DESCRIPTOR_POOL_RATIOS) {
+			VkDescriptorPoolSize poolSize = {};
+			poolSize.type = ratio.type;
+			poolSize.descriptorCount = static_cast<uint32_t>(ratio.perSet * DESCRIPTOR_POOL_SETS);
+			poolSizes.push_back(poolSize);
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = DESCRIPTOR_POOL_SETS;
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create descriptor set pool!");
+		}
+		return pool;
+	}
+
+	VkDevice						m_device = VK_NULL_HANDLE;
+	std::mutex						m_mutex;
+	VkDescriptorPool				m_currentPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorPool>	m_usedPools;
+	std::vector<VkDescriptorPool>	m_freePools;
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>>	m_releasedSets;
+};
+
+/*
+Deduplicates descriptor set layouts by their binding signature
+(binding, type, count, stages), so materials and passes asking for
+the same bindings share one layout and their sets stay compatible.
+Immutable samplers are not part of the signature and not supported
+*/
+class DescriptorLayoutCache {
+public:
+	void init(VkDevice device) {
+		m_device = device;
+	}
+
+	void cleanup() {
+		for (auto& layout : m_layouts) {
+			vkDestroyDescriptorSetLayout(m_device, layout.second, nullptr);
+		}
+		m_layouts.clear();
+	}
+
+	VkDescriptorSetLayout getLayout(std::vector<VkDescriptorSetLayoutBinding> bindings) {
+		std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+			return a.binding < b.binding;
+		});
+
+		LayoutKey key;
+		for (const auto& binding : bindings) {
+			if (binding.pImmutableSamplers) {
+				throw std::runtime_error("ERROR: Cached descriptor set layouts can not have immutable samplers!");
+			}
+			key.bindings.push_back({ binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags });
+		}
+
+		//Startup tasks may request layouts concurrently
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_layouts.find(key);
+		if (it != m_layouts.end()) {
+			return it->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create descriptor set layout!");
+		}
+		m_layouts.emplace(key, layout);
+		return layout;
+	}
+
+private:
+	struct BindingKey {
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count;
+		VkShaderStageFlags stages;
+	};
+
+	struct LayoutKey {
+		std::vector<BindingKey> bindings;
+
+		bool operator==(const LayoutKey& other) const {
+			if (bindings.size() != other.bindings.size()) {
+				return false;
+			}
+			for (size_t i = 0; i < bindings.size(); i++) {
+				const BindingKey& a = bindings[i];
+				const BindingKey& b = other.bindings[i];
+				if (a.binding != b.binding || a.type != b.type || a.count != b.count || a.stages != b.stages) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	struct LayoutKeyHash {
+		size_t operator()(const LayoutKey& key) const {
+			uint64_t hash = 14695981039346656037ull;
+			for (const auto& binding : key.bindings) {
+				uint32_t words[] = { binding.binding, static_cast<uint32_t>(binding.type), binding.count, static_cast<uint32_t>(binding.stages) };
+				for (uint32_t word : words) {
+					hash = (hash ^ word) * 1099511628211ull;
+				}
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	VkDevice														m_device = VK_NULL_HANDLE;
+	std::mutex														m_mutex;
+	std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash>	m_layouts;
+};
+
+/*
+Writes a whole descriptor set from one CPU struct. Entries say where in the struct
+the VkDescriptorBufferInfo / VkDescriptorImageInfo of each binding are.
+With VK_KHR_descriptor_update_template the driver consumes the struct directly
+in one call, otherwise the same entries are expanded into descriptor writes
+*/
+class DescriptorUpdater {
+public:
+	void init(VkDevice device, VkDescriptorSetLayout layout, const std::vector<VkDescriptorUpdateTemplateEntryKHR>& entries, bool useTemplate) {
+		m_device = device;
+		m_entries = entries;
+		if (!useTemplate) {
+			return;
+		}
+
+		m_createTemplate = reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR"));
+		m_destroyTemplate = reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR"));
+		m_updateWithTemplate = reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR"));
+		if (!m_createTemplate || !m_destroyTemplate || !m_updateWithTemplate) {
+			return;
+		}
+
+		VkDescriptorUpdateTemplateCreateInfoKHR createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+		createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(m_entries.size());
+		createInfo.pDescriptorUpdateEntries = m_entries.data();
+		createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+		createInfo.descriptorSetLayout = layout;
+
+		if (m_createTemplate(device, &createInfo, nullptr, &m_template) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create descriptor update template!");
+		}
+	}
+
+	void cleanup() {
+		if (m_template != VK_NULL_HANDLE) {
+			m_destroyTemplate(m_device, m_template, nullptr);
+			m_template = VK_NULL_HANDLE;
+		}
+	}
+
+	bool usesTemplate() const {
+		return m_template != VK_NULL_HANDLE;
+	}
+
+	void update(VkDescriptorSet set, const void* data) const {
+		if (m_template != VK_NULL_HANDLE) {
+			m_updateWithTemplate(m_device, set, m_template, data);
+			return;
+		}
+
+		const char* bytes = static_cast<const char*>(data);
+		std::vector<VkWriteDescriptorSet> writes;
+		for (const auto& entry : m_entries) {
+			for (uint32_t i = 0; i < entry.descriptorCount; i++) {
+				const char* info = bytes + entry.offset + i * entry.stride;
+				VkWriteDescriptorSet write = {};
+				write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.dstSet = set;
+				write.dstBinding = entry.dstBinding;
+				write.dstArrayElement = entry.dstArrayElement + i;
+				write.descriptorCount = 1;
+				write.descriptorType = entry.descriptorType;
+				if (isImageDescriptor(entry.descriptorType)) {
+					write.pImageInfo = reinterpret_cast<const VkDescriptorImageInfo*>(info);
+				}
+				else {
+					write.pBufferInfo = reinterpret_cast<const VkDescriptorBufferInfo*>(info);
+				}
+				writes.push_back(write);
+			}
+		}
+		vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+private:
+	static bool isImageDescriptor(VkDescriptorType type) {
+		return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+			type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	}
+
+	VkDevice									m_device = VK_NULL_HANDLE;
+	std::vector<VkDescriptorUpdateTemplateEntryKHR>	m_entries;
+	VkDescriptorUpdateTemplateKHR					m_template = VK_NULL_HANDLE;
+	PFN_vkCreateDescriptorUpdateTemplateKHR		m_createTemplate = nullptr;
+	PFN_vkDestroyDescriptorUpdateTemplateKHR	m_destroyTemplate = nullptr;
+	PFN_vkUpdateDescriptorSetWithTemplateKHR	m_updateWithTemplate = nullptr;
+};
+
+/*
+Template entry for a single descriptor whose info lives at offset in the update struct
+*/
+inline VkDescriptorUpdateTemplateEntryKHR makeDescriptorEntry(uint32_t binding, VkDescriptorType type, size_t offset) {
+	VkDescriptorUpdateTemplateEntryKHR entry = {};
+	entry.dstBinding = binding;
+	entry.dstArrayElement = 0;
+	entry.descriptorCount = 1;
+	entry.descriptorType = type;
+	entry.offset = offset;
+	entry.stride = 0;
+	return entry;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+/*
+Struct to hold indices of queue families.
+isComplete checks, if all families are present
+*/
+struct QueueFamilyIndices {
+	int graphicsFamily = -1;
+	int presentFamily = -1;
+
+	bool isComplete() const {
+		return graphicsFamily >= 0
+			&& presentFamily >= 0;
+	}
+};
+
+/*
+Struct to hold information need to create swapchain
+	capabilities : basic surface capabilities (min/max number of images in swap chain, min/max width and height of images)
+	surface formats (pixel format, color space)
+	available presentation modes
+*/
+struct SwapchainSupportDetails {
+	VkSurfaceCapabilitiesKHR capabilities;
+	std::vector<VkSurfaceFormatKHR> formats;
+	std::vector<VkPresentModeKHR> presentModes;
+};
+
+/*
+Everything the application asks about a physical device, queried once.
+Swapchain details are those of the surface the device was chosen for,
+swapchains query their own surface since the current extent follows the window
+*/
+struct DeviceCapabilities {
+	VkPhysicalDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties;
+	VkPhysicalDeviceFeatures features;
+	VkPhysicalDeviceMemoryProperties memory;
+	std::vector<VkQueueFamilyProperties> queueFamilyProperties;
+	std::vector<std::string> extensions; //sorted
+	QueueFamilyIndices queueFamilies;
+	SwapchainSupportDetails swapchain;
+	VkDeviceSize deviceLocalBytes = 0;
+
+	bool hasExtension(const char* name) const {
+		return std::binary_search(extensions.begin(), extensions.end(), std::string(name));
+	}
+
+	bool hasExtensions(const std::vector<const char*>& names) const {
+		for (const char* name : names) {
+			if (!hasExtension(name)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+	If there is a memory type suitable for the resource that also has
+	all of the properties we need, then we return its index
+	*/
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags flags) const {
+		for (uint32_t i = 0; i < memory.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memory.memoryTypes[i].propertyFlags & flags) == flags) {
+				return i;
+			}
+		}
+		throw std::runtime_error("ERROR: Failed to find suitable memory type!");
+	}
+};
+
+/*
+Formats, present modes and capabilities of one surface. Surfaces of other
+windows are queried separately, they may differ from the one the device was chosen for
+*/
+inline SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
+	SwapchainSupportDetails details;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+	uint32_t formatCount = 0;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+	details.formats.resize(formatCount);
+	if (formatCount != 0) {
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
+	}
+	uint32_t presentModesCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModesCount, nullptr);
+	details.presentModes.resize(presentModesCount);
+	if (presentModesCount != 0) {
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModesCount, details.presentModes.data());
+	}
+	return details;
+}
+
+/*
+Queries all capabilities of the device for given surface.
+Queue families: a family supporting both graphics and presenting is preferred,
+presenting then needs no ownership transfers between queues.
+Without a surface (offscreen rendering) nothing is presented, the graphics
+family stands in for the present one and swapchain details stay empty
+*/
+inline DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice device, VkSurfaceKHR surface) {
+	DeviceCapabilities caps;
+	caps.device = device;
+	vkGetPhysicalDeviceProperties(device, &caps.properties);
+	vkGetPhysicalDeviceFeatures(device, &caps.features);
+	vkGetPhysicalDeviceMemoryProperties(device, &caps.memory);
+	for (uint32_t i = 0; i < caps.memory.memoryHeapCount; i++) {
+		if (caps.memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			caps.deviceLocalBytes += caps.memory.memoryHeaps[i].size;
+		}
+	}
+
+	uint32_t extensionsCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionsCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionsCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionsCount, availableExtensions.data());
+	for (const auto& extension : availableExtensions) {
+		caps.extensions.push_back(extension.extensionName);
+	}
+	std::sort(caps.extensions.begin(), caps.extensions.end());
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	caps.queueFamilyProperties.resize(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, caps.queueFamilyProperties.data());
+
+	for (uint32_t i = 0; i < queueFamilyCount; i++) {
+		const VkQueueFamilyProperties& family = caps.queueFamilyProperties[i];
+		VkBool32 presentSupport = VK_FALSE;
+		if (surface != VK_NULL_HANDLE) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		}
+		bool graphics = family.queueCount > 0 && (family.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+		bool present = family.queueCount > 0 && (presentSupport || (surface == VK_NULL_HANDLE && graphics));
+
+		if (graphics && present) {
+			caps.queueFamilies.graphicsFamily = static_cast<int>(i);
+			caps.queueFamilies.presentFamily = static_cast<int>(i);
+			break;
+		}
+		if (graphics && caps.queueFamilies.graphicsFamily < 0) {
+			caps.queueFamilies.graphicsFamily = static_cast<int>(i);
+		}
+		if (present && caps.queueFamilies.presentFamily < 0) {
+			caps.queueFamilies.presentFamily = static_cast<int>(i);
+		}
+	}
+
+	if (surface != VK_NULL_HANDLE) {
+		caps.swapchain = querySwapchainSupport(device, surface);
+	}
+
+	return caps;
+}
+
+/*
+Ranks a device, negative score means it can not run the application:
+missing required extensions, queue families or, when presenting, any surface format and present mode.
+Device type dominates (discrete > integrated > virtual > cpu), then device local
+memory in MB, optional features the renderer uses add a small bonus
+*/
+inline int64_t scoreDevice(const DeviceCapabilities& caps, const std::vector<const char*>& requiredExtensions, bool presents = true) {
+	if (!caps.queueFamilies.isComplete() || !caps.hasExtensions(requiredExtensions) ||
+		(presents && (caps.swapchain.formats.empty() || caps.swapchain.presentModes.empty()))) {
+		return -1;
+	}
+
+	int64_t typeRank = 0;
+	switch (caps.properties.deviceType) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeRank = 4; break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeRank = 3; break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeRank = 2; break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU: typeRank = 1; break;
+	default: break;
+	}
+
+	int64_t score = typeRank << 40;
+	score += static_cast<int64_t>(caps.deviceLocalBytes >> 20);
+	score += caps.features.multiDrawIndirect ? 256 : 0;
+	score += caps.features.fullDrawIndexUint32 ? 64 : 0;
+	score += caps.queueFamilies.graphicsFamily == caps.queueFamilies.presentFamily ? 64 : 0;
+	return score;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+
+/*
+Frame time is held this far below the budget, contention spikes then do not miss it at once
+*/
+const double RESOLUTION_HEADROOM = 0.9;
+
+/*
+Weight of the newest GPU time in the average the controller follows
+*/
+const double RESOLUTION_SMOOTHING = 0.2;
+
+/*
+Scale changes by multiples of this, GPU time noise does not change the extent every frame
+*/
+const double RESOLUTION_STEP = 1.0 / 16.0;
+
+/*
+Frames measured at a new scale before it changes again. Measurements arrive
+a frame late, without the wait the controller would overshoot
+*/
+const uint32_t RESOLUTION_COOLDOWN_FRAMES = 4;
+
+/*
+Frames whose timestamps may be pending at once
+*/
+const uint32_t GPU_TIMER_SLOTS = 4;
+
+struct DynamicResolutionOptions {
+	double targetMilliseconds = 0.0; //GPU time budget of a frame, 0 keeps full resolution
+	double minScale = 0.5; //render extent relative to the swapchain
+	double maxScale = 1.0;
+};
+
+/*
+GPU time of whole frames: a timestamp at the start of the first command buffer of a frame
+and one after the last. Results are read once the frame's timeline value completed,
+so the CPU never waits for them
+*/
+class GpuFrameTimer {
+public:
+	/*
+	Queue family without timestamp bits leaves the timer unsupported, begin and end then do nothing
+	*/
+	void init(VkDevice device, const VkPhysicalDeviceLimits& limits, uint32_t timestampValidBits) {
+		m_device = device;
+		m_supported = timestampValidBits > 0;
+		if (!m_supported) {
+			return;
+		}
+		m_nanosecondsPerTick = limits.timestampPeriod;
+		m_mask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+
+		VkQueryPoolCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		createInfo.queryCount = GPU_TIMER_SLOTS * 2;
+
+		if (vkCreateQueryPool(m_device, &createInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create timestamp query pool!");
+		}
+		for (uint32_t slot = 0; slot < GPU_TIMER_SLOTS; slot++) {
+			m_freeSlots.push_back(slot);
+		}
+	}
+
+	void cleanup() {
+		if (m_queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+			m_queryPool = VK_NULL_HANDLE;
+		}
+		m_freeSlots.clear();
+		m_inFlight.clear();
+	}
+
+	bool supported() const {
+		return m_supported;
+	}
+
+	/*
+	Recorded before any other command of the frame. Frame is not measured when all slots are pending
+	*/
+	void begin(VkCommandBuffer commandBuffer) {
+		if (!m_supported || m_freeSlots.empty()) {
+			return;
+		}
+		m_current = static_cast<int32_t>(m_freeSlots.back());
+		m_freeSlots.pop_back();
+		vkCmdResetQueryPool(commandBuffer, m_queryPool, m_current * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, m_current * 2);
+	}
+
+	/*
+	Recorded after all commands of the frame, possibly into another command buffer of the same submission
+	*/
+	void end(VkCommandBuffer commandBuffer) {
+		if (m_current < 0) {
+			return;
+		}
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, m_current * 2 + 1);
+	}
+
+	/*
+	Ties the measured frame to the timeline value of its submission
+	*/
+	void submitted(uint64_t value) {
+		if (m_current < 0) {
+			return;
+		}
+		m_inFlight.push_back({ static_cast<uint32_t>(m_current), value });
+		m_current = -1;
+	}
+
+	/*
+	Reads frames completed by now, returns false when none was. Milliseconds are of the newest one
+	*/
+	bool collect(uint64_t completedValue, double& milliseconds) {
+		bool measured = false;
+		while (!m_inFlight.empty() && m_inFlight.front().value <= completedValue) {
+			uint32_t slot = m_inFlight.front().slot;
+			m_inFlight.pop_front();
+			m_freeSlots.push_back(slot);
+
+			uint64_t ticks[2] = {};
+			if (vkGetQueryPoolResults(m_device, m_queryPool, slot * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+				milliseconds = static_cast<double>((ticks[1] - ticks[0]) & m_mask) * m_nanosecondsPerTick / 1e6;
+				measured = true;
+			}
+		}
+		return measured;
+	}
+
+private:
+	struct PendingFrame {
+		uint32_t slot;
+		uint64_t value;
+	};
+
+	VkDevice				m_device = VK_NULL_HANDLE;
+	bool					m_supported = false;
+	VkQueryPool				m_queryPool = VK_NULL_HANDLE;
+	double					m_nanosecondsPerTick = 1.0;
+	uint64_t				m_mask = ~0ull;
+	std::vector<uint32_t>	m_freeSlots;
+	std::deque<PendingFrame>	m_inFlight;
+	int32_t					m_current = -1; //slot of the frame being recorded
+};
+
+/*
+Render scale holding GPU frame time under the budget. Cost of the scene is mostly
+per pixel, so it grows with the square of the scale: the scale is corrected by the
+square root of budget over the average time. It drops at once when over budget and
+grows one step at a time, a frame missing the deadline costs more than one rendered
+a little softer. Disabled without a budget, the scale then stays at the maximum
+*/
+class ResolutionController {
+public:
+	void init(const DynamicResolutionOptions& options) {
+		m_options = options;
+		m_scale = options.maxScale;
+		m_average = 0.0;
+		m_cooldown = 0;
+	}
+
+	bool enabled() const {
+		return m_options.targetMilliseconds > 0.0;
+	}
+
+	void update(double gpuMilliseconds) {
+		if (!enabled() || gpuMilliseconds <= 0.0) {
+			return;
+		}
+		m_average = m_average > 0.0 ? m_average + (gpuMilliseconds - m_average) * RESOLUTION_SMOOTHING : gpuMilliseconds;
+		if (m_cooldown > 0) {
+			m_cooldown--;
+			return;
+		}
+
+		//Single frame over the budget is not averaged away
+		double measured = std::max(m_average, gpuMilliseconds > m_options.targetMilliseconds ? gpuMilliseconds : 0.0);
+		double desired = m_scale * std::sqrt(m_options.targetMilliseconds * RESOLUTION_HEADROOM / measured);
+		//Rounded down, the next step is taken only when its expected cost fits the budget
+		desired = std::floor(desired / RESOLUTION_STEP + 1e-6) * RESOLUTION_STEP;
+		desired = std::min(desired, m_scale + RESOLUTION_STEP);
+		desired = std::max(std::min(desired, m_options.maxScale), m_options.minScale);
+
+		if (desired != m_scale) {
+			//Average continues at the cost expected for the new scale
+			m_average *= (desired * desired) / (m_scale * m_scale);
+			m_scale = desired;
+			m_cooldown = RESOLUTION_COOLDOWN_FRAMES;
+		}
+	}
+
+	double scale() const {
+		return m_scale;
+	}
+
+	/*
+	Part of an image of given extent rendered at the current scale, at least one pixel
+	*/
+	VkExtent2D renderExtent(VkExtent2D extent) const {
+		VkExtent2D scaled;
+		scaled.width = std::max(static_cast<uint32_t>(std::lround(extent.width * m_scale)), 1u);
+		scaled.height = std::max(static_cast<uint32_t>(std::lround(extent.height * m_scale)), 1u);
+		scaled.width = std::min(scaled.width, extent.width);
+		scaled.height = std::min(scaled.height, extent.height);
+		return scaled;
+	}
+
+private:
+	DynamicResolutionOptions	m_options;
+	double						m_scale = 1.0;
+	double						m_average = 0.0; //smoothed GPU milliseconds
+	uint32_t					m_cooldown = 0;
+};
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <limits>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+
+/*
+Reads deflate (RFC 1951) bit stream, least significant bit first
+*/
+class InflateInput {
+public:
+	InflateInput(const uint8_t* data, size_t size)
+		: m_data(data), m_size(size) {
+	}
+
+	uint32_t bits(int count) {
+		while (m_bitCount < count) {
+			if (m_position >= m_size) {
+				throw std::runtime_error("ERROR: Deflate stream is truncated!");
+			}
+			m_bitBuffer |= static_cast<uint32_t>(m_data[m_position++]) << m_bitCount;
+			m_bitCount += 8;
+		}
+		uint32_t value = m_bitBuffer & ((1u << count) - 1);
+		m_bitBuffer >>= count;
+		m_bitCount -= count;
+		return value;
+	}
+
+	/*
+	Stored blocks start at a byte boundary
+	*/
+	void alignToByte() {
+		m_bitBuffer = 0;
+		m_bitCount = 0;
+	}
+
+	const uint8_t* take(size_t size) {
+		if (m_position + size > m_size) {
+			throw std::runtime_error("ERROR: Deflate stream is truncated!");
+		}
+		const uint8_t* data = m_data + m_position;
+		m_position += size;
+		return data;
+	}
+
+private:
+	const uint8_t*	m_data;
+	size_t			m_size;
+	size_t			m_position = 0;
+	uint32_t		m_bitBuffer = 0;
+	int				m_bitCount = 0;
+};
+
+/*
+Canonical Huffman code given by code lengths of its symbols
+*/
+class InflateHuffman {
+public:
+	static const int MAX_BITS = 15;
+
+	void build(const uint16_t* lengths, size_t count) {
+		std::fill(m_counts, m_counts + MAX_BITS + 1, static_cast<uint16_t>(0));
+		for (size_t i = 0; i < count; i++) {
+			m_counts[lengths[i]]++;
+		}
+		m_counts[0] = 0;
+
+		uint16_t offsets[MAX_BITS + 1] = {};
+		for (int length = 1; length < MAX_BITS; length++) {
+			offsets[length + 1] = offsets[length] + m_counts[length];
+		}
+		m_symbols.assign(count, 0);
+		for (size_t i = 0; i < count; i++) {
+			if (lengths[i] != 0) {
+				m_symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+			}
+		}
+	}
+
+	/*
+	Codes of one length are consecutive, so the symbol is found
+	by walking lengths without any lookup table
+	*/
+	uint16_t decode(InflateInput& input) const {
+		int code = 0, first = 0, index = 0;
+		for (int length = 1; length <= MAX_BITS; length++) {
+			code |= static_cast<int>(input.bits(1));
+			int count = m_counts[length];
+			if (code - count < first) {
+				return m_symbols[index + (code - first)];
+			}
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+		throw std::runtime_error("ERROR: Invalid Huffman code in deflate stream!");
+	}
+
+private:
+	uint16_t				m_counts[MAX_BITS + 1];
+	std::vector<uint16_t>	m_symbols;
+};
+
+inline void inflateBlock(InflateInput& input, std::vector<uint8_t>& out, const InflateHuffman& literals, const InflateHuffman& distances) {
+	static const uint16_t lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t distanceBase[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t distanceExtra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	for (;;) {
+		uint16_t symbol = literals.decode(input);
+		if (symbol < 256) {
+			out.push_back(static_cast<uint8_t>(symbol));
+			continue;
+		}
+		if (symbol == 256) {
+			return;
+		}
+		symbol -= 257;
+		if (symbol >= 29) {
+			throw std::runtime_error("ERROR: Invalid length in deflate stream!");
+		}
+		size_t length = lengthBase[symbol] + input.bits(lengthExtra[symbol]);
+		uint16_t distanceSymbol = distances.decode(input);
+		if (distanceSymbol >= 30) {
+			throw std::runtime_error("ERROR: Invalid distance in deflate stream!");
+		}
+		size_t distance = distanceBase[distanceSymbol] + input.bits(distanceExtra[distanceSymbol]);
+		if (distance > out.size()) {
+			throw std::runtime_error("ERROR: Distance too far back in deflate stream!");
+		}
+		//Source and destination may overlap, bytes are copied one by one
+		size_t from = out.size() - distance;
+		for (size_t i = 0; i < length; i++) {
+			out.push_back(out[from + i]);
+		}
+	}
+}
+
+/*
+Decompresses raw deflate data, appending them to out
+*/
+inline void inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+	InflateInput input(data, size);
+	InflateHuffman literals, distances;
+	bool last = false;
+	while (!last) {
+		last = input.bits(1) != 0;
+		uint32_t type = input.bits(2);
+		if (type == 0) {
+			input.alignToByte();
+			const uint8_t* header = input.take(4);
+			uint32_t length = header[0] | (header[1] << 8);
+			uint32_t complement = header[2] | (header[3] << 8);
+			if (length != (~complement & 0xFFFF)) {
+				throw std::runtime_error("ERROR: Corrupted stored block in deflate stream!");
+			}
+			const uint8_t* stored = input.take(length);
+			out.insert(out.end(), stored, stored + length);
+		}
+		else if (type == 1) {
+			uint16_t lengths[288 + 30];
+			std::fill(lengths, lengths + 144, static_cast<uint16_t>(8));
+			std::fill(lengths + 144, lengths + 256, static_cast<uint16_t>(9));
+			std::fill(lengths + 256, lengths + 280, static_cast<uint16_t>(7));
+			std::fill(lengths + 280, lengths + 288, static_cast<uint16_t>(8));
+			std::fill(lengths + 288, lengths + 318, static_cast<uint16_t>(5));
+			literals.build(lengths, 288);
+			distances.build(lengths + 288, 30);
+			inflateBlock(input, out, literals, distances);
+		}
+		else if (type == 2) {
+			uint32_t literalCount = input.bits(5) + 257;
+			uint32_t distanceCount = input.bits(5) + 1;
+			uint32_t codeLengthCount = input.bits(4) + 4;
+			static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			uint16_t codeLengths[19] = {};
+			for (uint32_t i = 0; i < codeLengthCount; i++) {
+				codeLengths[order[i]] = static_cast<uint16_t>(input.bits(3));
+			}
+			InflateHuffman lengthCode;
+			lengthCode.build(codeLengths, 19);
+
+			//Literal and distance lengths form one sequence, repeats may cross between them
+			uint16_t lengths[288 + 32] = {};
+			uint32_t count = 0;
+			while (count < literalCount + distanceCount) {
+				uint16_t symbol = lengthCode.decode(input);
+				uint32_t repeat = 0;
+				uint16_t value = 0;
+				if (symbol < 16) {
+					lengths[count++] = symbol;
+					continue;
+				}
+				else if (symbol == 16) {
+					if (count == 0) {
+						throw std::runtime_error("ERROR: Invalid length repeat in deflate stream!");
+					}
+					value = lengths[count - 1];
+					repeat = 3 + input.bits(2);
+				}
+				else if (symbol == 17) {
+					repeat = 3 + input.bits(3);
+				}
+				else {
+					repeat = 11 + input.bits(7);
+				}
+				if (count + repeat > literalCount + distanceCount) {
+					throw std::runtime_error("ERROR: Too many code lengths in deflate stream!");
+				}
+				std::fill(lengths + count, lengths + count + repeat, value);
+				count += repeat;
+			}
+			literals.build(lengths, literalCount);
+			distances.build(lengths + literalCount, distanceCount);
+			inflateBlock(input, out, literals, distances);
+		}
+		else {
+			throw std::runtime_error("ERROR: Invalid block type in deflate stream!");
+		}
+	}
+}
+
+/*
+8 bit RGBA image
+*/
+struct Image {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+/*
+Loads 8 bit RGB or RGBA, non interlaced PNG (what the capture writes and what
+image editors save by default) into RGBA pixels
+*/
+inline Image loadPng(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("ERROR: Failed to open " + filename + "!");
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (data.size() < 8 || memcmp(data.data(), signature, 8) != 0) {
+		throw std::runtime_error("ERROR: " + filename + " is not a PNG file!");
+	}
+
+	auto readBigEndian = [](const uint8_t* bytes) {
+		return (static_cast<uint32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+	};
+
+	Image image;
+	uint32_t channels = 0;
+	std::vector<uint8_t> compressed;
+	size_t position = 8;
+	while (position + 12 <= data.size()) {
+		uint32_t length = readBigEndian(&data[position]);
+		const char* type = reinterpret_cast<const char*>(&data[position + 4]);
+		const uint8_t* chunk = &data[position + 8];
+		if (position + 12 + length > data.size()) {
+			break;
+		}
+		if (memcmp(type, "IHDR", 4) == 0) {
+			image.width = readBigEndian(chunk);
+			image.height = readBigEndian(chunk + 4);
+			uint8_t bitDepth = chunk[8], colorType = chunk[9], interlace = chunk[12];
+			if (bitDepth != 8 || (colorType != 2 && colorType != 6) || interlace != 0) {
+				throw std::runtime_error("ERROR: " + filename + " is not 8 bit RGB(A) non interlaced PNG!");
+			}
+			channels = colorType == 6 ? 4 : 3;
+		}
+		else if (memcmp(type, "IDAT", 4) == 0) {
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		}
+		else if (memcmp(type, "IEND", 4) == 0) {
+			break;
+		}
+		position += 12 + length;
+	}
+	if (channels == 0 || compressed.size() < 6) {
+		throw std::runtime_error("ERROR: " + filename + " has no image data!");
+	}
+
+	//zlib header and adler checksum wrap the deflate stream
+	std::vector<uint8_t> raw;
+	const size_t stride = static_cast<size_t>(image.width) * channels;
+	raw.reserve((stride + 1) * image.height);
+	inflate(compressed.data() + 2, compressed.size() - 6, raw);
+	if (raw.size() < (stride + 1) * image.height) {
+		throw std::runtime_error("ERROR: " + filename + " has truncated image data!");
+	}
+
+	std::vector<uint8_t> previous(stride, 0), current(stride);
+	image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+	for (uint32_t y = 0; y < image.height; y++) {
+		const uint8_t* row = &raw[y * (stride + 1)];
+		uint8_t filter = row[0];
+		row++;
+		for (size_t i = 0; i < stride; i++) {
+			int left = i >= channels ? current[i - channels] : 0;
+			int up = previous[i];
+			int upLeft = i >= channels ? previous[i - channels] : 0;
+			int predictor = 0;
+			switch (filter) {
+			case 0: predictor = 0; break;
+			case 1: predictor = left; break;
+			case 2: predictor = up; break;
+			case 3: predictor = (left + up) / 2; break;
+			case 4: {
+				int estimate = left + up - upLeft;
+				int distanceLeft = std::abs(estimate - left);
+				int distanceUp = std::abs(estimate - up);
+				int distanceUpLeft = std::abs(estimate - upLeft);
+				predictor = distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft ? left : (distanceUp <= distanceUpLeft ? up : upLeft);
+				break;
+			}
+			default:
+				throw std::runtime_error("ERROR: " + filename + " uses unknown row filter!");
+			}
+			current[i] = static_cast<uint8_t>(row[i] + predictor);
+		}
+
+		uint8_t* dst = &image.pixels[static_cast<size_t>(y) * image.width * 4];
+		for (uint32_t x = 0; x < image.width; x++) {
+			dst[x * 4 + 0] = current[x * channels + 0];
+			dst[x * 4 + 1] = current[x * channels + 1];
+			dst[x * 4 + 2] = current[x * channels + 2];
+			dst[x * 4 + 3] = channels == 4 ? current[x * channels + 3] : 255;
+		}
+		std::swap(previous, current);
+	}
+	return image;
+}
+
+/*
+Result of comparing image with its reference. Pixels differ when their
+perceptual distance exceeds the threshold, psnr is over all RGB values
+*/
+struct ImageDifference {
+	uint64_t pixels = 0;
+	uint64_t differing = 0;
+	double maxDistance = 0.0;
+	double psnr = 0.0;
+
+	double differingFraction() const {
+		return pixels > 0 ? static_cast<double>(differing) / pixels : 0.0;
+	}
+};
+
+/*
+Compares RGBA pixels in YCbCr (BT.601): eyes are far more sensitive to luma,
+so chroma differences count half. Distance is in 8 bit units, GPUs disagree
+on rounding and transcendental precision by a few units, not by tens
+*/
+inline ImageDifference compareImages(const uint8_t* image, const uint8_t* reference, uint64_t pixelCount, double threshold) {
+	ImageDifference difference;
+	difference.pixels = pixelCount;
+	double squaredError = 0.0;
+	for (uint64_t i = 0; i < pixelCount; i++) {
+		const uint8_t* a = image + i * 4;
+		const uint8_t* b = reference + i * 4;
+		double red = static_cast<double>(a[0]) - b[0];
+		double green = static_cast<double>(a[1]) - b[1];
+		double blue = static_cast<double>(a[2]) - b[2];
+		squaredError += red * red + green * green + blue * blue;
+
+		double luma = 0.299 * red + 0.587 * green + 0.114 * blue;
+		double cb = -0.168736 * red - 0.331264 * green + 0.5 * blue;
+		double cr = 0.5 * red - 0.418688 * green - 0.081312 * blue;
+		double distance = std::sqrt(luma * luma + 0.25 * (cb * cb + cr * cr));
+		difference.maxDistance = std::max(difference.maxDistance, distance);
+		if (distance > threshold) {
+			difference.differing++;
+		}
+	}
+
+	double meanSquaredError = pixelCount > 0 ? squaredError / (pixelCount * 3.0) : 0.0;
+	difference.psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+	return difference;
+}
@@ -8,67 +8,122 @@
 #include <set>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
 
 #include <glm/glm.hpp>
 
 #include "math.hpp"
-
-#ifdef _DEBUG
-const bool enableValidationLayers = true;
-#else
-const bool enableValidationLayers = false;
-#endif
+#include "assets.hpp"
+#include "mesh.hpp"
+#include "mesh_import.hpp"
+#include "meshlet.hpp"
+#include "scene.hpp"
+#include "thread_pool.hpp"
+#include "task_graph.hpp"
+#include "visibility.hpp"
+#include "profiler.hpp"
+#include "descriptors.hpp"
+#include "bindless.hpp"
+#include "push_constants.hpp"
+#include "render_graph.hpp"
+#include "present.hpp"
+#include "options.hpp"
+#include "device_caps.hpp"
+#include "sync.hpp"
+#include "deletion_queue.hpp"
+#include "debug.hpp"
+#include "readback.hpp"
+#include "tonemap.hpp"
+#include "dynamic_resolution.hpp"
+#include "clock.hpp"
+#include "tools.hpp"
+
+const bool enableValidationLayers = VULKAN_DEBUG != 0;
 
 const unsigned int WIDTH = 1280;
 const unsigned int HEIGHT = 720;
 
-class HelloTriangleApplication;
+/*
+Packed assets, created with --pack. If missing, loose files are mapped instead
+*/
+const char* ASSET_ARCHIVE = "assets.pak";
 
+/*
+Mesh to render, converted with --convert-mesh. If missing, built-in quad is used
+*/
+const char* MESH_FILE = "meshes/scene.vmesh";
 
 /*
-Proxy function for creating and destroying extension function for debug messages
+Shaders of the graphics pipeline
 */
-VkResult CreateDebugReportCallbackEXT(VkInstance instance, const VkDebugReportCallbackCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugReportCallbackEXT* pCallback) {
-	auto func = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
-	if (func != nullptr) {
-		return func(instance, pCreateInfo, pAllocator, pCallback);
-	}
-	else {
-		return VK_ERROR_EXTENSION_NOT_PRESENT;
-	}
-}
+#ifdef _DEBUG
+const char* VERTEX_SHADER = "shaders/test.vert.spv";
+const char* VERTEX_SHADER_BINDLESS = "shaders/test.bindless.vert.spv";
+const char* FRAGMENT_SHADER = "shaders/test.frag.spv";
+const char* CLASSIFY_FRAGMENT_SHADER = nullptr; //test scene has no planet to classify
+#else
+const char* VERTEX_SHADER = "shaders/atmosphere.vert.spv";
+const char* VERTEX_SHADER_BINDLESS = "shaders/atmosphere.bindless.vert.spv";
+const char* FRAGMENT_SHADER = "shaders/atmosphere.frag.spv";
+const char* CLASSIFY_FRAGMENT_SHADER = "shaders/atmosphere.classify.frag.spv";
+#endif
 
-void DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback, const VkAllocationCallbacks* pAllocator) {
-	auto func = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
-	if (func != nullptr) {
-		func(instance, callback, pAllocator);
-	}
-}
+/*
+Shading variant of one class of atmosphere pixels. Classification draw writes the class
+depth of every pixel, each variant is then drawn with the viewport depth range collapsed
+to its depth and depth test EQUAL. Fragments of other classes (and empty space) are
+rejected before shading, so wavefronts are filled with pixels of one class only
+*/
+struct AtmosphereVariant {
+	const char* name;
+	uint32_t specialization; //ATMOSPHERE_VARIANT constant
+	float depth;
+};
 
-static std::vector<char> readFile(const std::string &filename) {
-	//ATE : at the end. Reasoning: start at the end can help determine the size of the file
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+/*
+EQUAL only passes when the depth written by classification and the collapsed viewport
+depth store the same SCENE_DEPTH_FORMAT value. Class depths are k / 65535, whose nearest
+floats lie slightly above it for these k: D16 conversion gives k whether the implementation
+rounds or truncates. Classification shader is specialized with these values, the shader
+does not repeat them
+*/
+const float ATMOSPHERE_EMPTY_DEPTH = 49151.0f / 65535.0f;
 
-	if (!file.is_open()) {
-		throw std::runtime_error("ERROR: Failed to open file!");
-	}
-	//Allocate buffer
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
+const AtmosphereVariant ATMOSPHERE_VARIANTS[] = {
+	{ "limb", 1, 16383.0f / 65535.0f },
+	{ "disk", 2, 32767.0f / 65535.0f }
+};
 
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-	file.close();
+/*
+Holds pixel classes only, every device can render into it
+*/
+const VkFormat SCENE_DEPTH_FORMAT = VK_FORMAT_D16_UNORM;
+
+/*
+Shaders of the tone mapping passes, the subgroup exposure variant needs Vulkan 1.1
+*/
+const char* FULLSCREEN_VERTEX_SHADER = "shaders/fullscreen.vert.spv";
+const char* TONEMAP_FRAGMENT_SHADER = "shaders/tonemap.frag.spv";
+const char* HISTOGRAM_SHADER = "shaders/histogram.comp.spv";
+const char* EXPOSURE_SHADER = "shaders/exposure.comp.spv";
+const char* EXPOSURE_SHADER_SUBGROUP = "shaders/exposure.subgroup.comp.spv";
+
+class HelloTriangleApplication;
 
-	return buffer;
-}
 
 /*
-Required device validation layers
+Validation layer, the first one available is used. Khronos layer
+replaced the LunarG meta layer, which older SDKs still ship
 */
 const std::vector<const char*> validationLayers = {
-	"VK_LAYER_LUNARG_standard_validation",
-	"VK_LAYER_LUNARG_assistant_layer"
+	"VK_LAYER_KHRONOS_validation",
+	"VK_LAYER_LUNARG_standard_validation"
 };
 
 /*
@@ -79,29 +134,60 @@ const std::vector<const char*> deviceExtensions = {
 };
 
 /*
-Struct to hold indices of queue families.
-isComplete checks, if all families are present
+Descriptors of the object set (uniforms and world matrices),
+laid out for DescriptorUpdater entries
 */
-struct QueueFamilyIndices {
-	int graphicsFamily = -1;
-	int presentFamily = -1;
+struct ObjectDescriptors {
+	VkDescriptorBufferInfo uniforms;
+	VkDescriptorBufferInfo objects;
+};
 
-	bool isComplete() {
-		return graphicsFamily >= 0
-			&& presentFamily >= 0;
-	}
+/*
+Per-frame values pushed with the draws instead of rewriting the uniform buffer.
+Slots of the same buffers are used by the bindless shaders only
+*/
+struct DrawConstants {
+	uint32_t uniformSlot;
+	uint32_t objectSlot;
+	float time;
+	float quality; //scales atmosphere scattering samples
+	uint32_t objectBase; //added to gl_InstanceIndex, holds the object index without drawIndirectFirstInstance
 };
 
+typedef PushConstantBlock<DrawConstants, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT> DrawPushConstants;
+
 /*
-Struct to hold information need to create swapchain
-	capabilities : basic surface capabilities (min/max number of images in swap chain, min/max width and height of images)
-	surface formats (pixel format, color space)
-	available presentation modes
+Everything one window renders into. Device, render passes, pipelines and all uploaded
+resources are shared, a window adds its swapchain, HDR target with its exposure
+and the frame recording into it.
+All windows are drawn with one submit and presented with one call.
+Headless context has no window, one offscreen image stands in for its swapchain
 */
-struct SwapchainSupportDetails {
-	VkSurfaceCapabilitiesKHR capabilities;
-	std::vector<VkSurfaceFormatKHR> formats;
-	std::vector<VkPresentModeKHR> presentModes;
+struct SurfaceContext {
+	GLFWwindow*						window = nullptr;
+	VkExtent2D						windowExtent = {};
+	VkSurfaceKHR					surface = VK_NULL_HANDLE;
+	SwapchainSupportDetails			support;
+	VkSwapchainKHR					swapchain = VK_NULL_HANDLE;
+	std::vector<VkImage>			images;
+	VkDeviceMemory					offscreenMemory = VK_NULL_HANDLE; //backs the image of a headless context
+	VkFormat						format = VK_FORMAT_UNDEFINED;
+	VkExtent2D						extent = {};
+	VkExtent2D						renderExtent = {}; //part of the HDR image the scene renders into this frame
+	std::vector<VkImageView>		imageViews;
+	std::vector<VkFramebuffer>		framebuffers; //tone map pass into swapchain images
+	VkFramebuffer					sceneFramebuffer = VK_NULL_HANDLE; //scene pass into the HDR image
+	RenderGraph						renderGraph;
+	RenderResource					swapchainResource = 0;
+	RenderResource					hdrResource = 0;
+	ExposureState					exposure;
+	ToneMapView						toneMapView;
+	std::vector<VkCommandBuffer>	commandBuffers;
+	std::vector<VkSwapchainKHR>		retiredSwapchains; //replaced ones, their presents may still be pending
+	VkSemaphore						imageAvailableSemaphore = VK_NULL_HANDLE;
+	VkSemaphore						renderFinishedSemaphore = VK_NULL_HANDLE;
+	uint32_t						imageIndex = 0;
+	bool							acquired = false; //swapchain image of the current frame was acquired
 };
 
 void windowKeyCallback(GLFWwindow *pWindow, int key, int scancode, int action, int mods) {
@@ -116,87 +202,342 @@ void windowKeyCallback(GLFWwindow *pWindow, int key, int scancode, int action, i
 
 class HelloTriangleApplication {
 public:
+	explicit HelloTriangleApplication(const AppOptions& options = AppOptions())
+		: m_options(options) {
+	}
+
+	/*
+	Window is created first, GLFW requires the main thread for it.
+	Asset loading and Vulkan setup then run as one task graph.
+	Headless runs create no window and stop after the captured frames
+	*/
 	void run() {
+		auto startupStart = std::chrono::high_resolution_clock::now();
 		initWindow();
-		initVulkan();
+
+		TaskGraph startup;
+		TaskId mount = startup.add("mount assets", [this]() { mountAssets(); });
+		TaskId assets = initAssets(startup, mount);
+		initVulkan(startup, mount, assets);
+		startup.run(m_threadPool);
+		printStartupTimes(startup, startupStart);
+
+		initFrameGraph();
+		//Bounded latency relies on pacing, FIFO alone lets the CPU run a frame ahead
+		m_frameLimiter.init(m_options.frameRateLimit, m_options.presentPolicy == PresentPolicy::BoundedLatency);
+		m_clock.init(m_options.simulationRate, m_options.offlineFps);
+		initDynamicResolution();
 		mainLoop();
 		cleanup();
+
+		if (m_readback.mismatches() > 0) {
+			throw std::runtime_error("ERROR: " + std::to_string(m_readback.mismatches()) + " frames do not match reference images!");
+		}
 	}
 
 	/*
-	Recreates whole swapchain if ie. window was resized
+	Recreates swapchain of the window if ie. it was resized. Viewport is dynamic,
+	so render pass and pipeline shared by all windows stay
 	*/
-	void recreateSwapchain() {
+	void recreateSwapchain(SurfaceContext& surface) {
 		int width, height;
-		glfwGetWindowSize(m_window, &width, &height);
+		glfwGetWindowSize(surface.window, &width, &height);
 		if (width == 0 || height == 0) {
 			return;
 		}
 
-		vkDeviceWaitIdle(m_logicalDevice);
-
-		cleanupSwapchain();
+		//Old objects are destroyed once frames using them completed
+		cleanupSwapchain(surface);
 
-		createSwapchain();
-		createImageViews();
-		createRenderPass();
-		createGraphicsPipeline();
-		createFramebuffers();
-		createCommandBuffers();
+		createSwapchain(surface);
+		createImageViews(surface);
+		createFramebuffers(surface);
+		createRenderGraph(surface);
+		createCommandBuffers(surface);
 	}
 
 private:
+	bool headless() const {
+		return m_options.headless.width > 0;
+	}
+
 	void initWindow() {
+		if (headless()) {
+			m_surfaces.resize(1);
+			m_surfaces.front().windowExtent = m_options.headless;
+			return;
+		}
 		glfwInit();
 
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+		//Captured frames keep one size
+		glfwWindowHint(GLFW_RESIZABLE, m_options.capture.path.empty() ? GLFW_TRUE : GLFW_FALSE);
+
+		//Contexts are never added later, render graph passes keep pointers to them
+		m_surfaces.resize(m_options.windows);
+		for (size_t i = 0; i < m_surfaces.size(); i++) {
+			std::string title = i == 0 ? "Vulkan Triangle" : "Vulkan Triangle " + std::to_string(i + 1);
+			GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, title.c_str(), nullptr, nullptr);
+			if (!window) {
+				glfwTerminate();
+				throw std::runtime_error("ERROR: Failed to create GLFW window!");
+			}
+
+			m_surfaces[i].window = window;
+			m_surfaces[i].windowExtent = { WIDTH, HEIGHT };
+			glfwSetWindowUserPointer(window, this);
+			glfwSetKeyCallback(window, windowKeyCallback);
+			glfwSetWindowSizeCallback(window, windowSizeCallback);
+		}
+	}
+
+	/*
+	Closing any window ends the application
+	*/
+	bool windowsShouldClose() const {
+		if (headless()) {
+			return m_closeRequested;
+		}
+		return std::any_of(m_surfaces.begin(), m_surfaces.end(), [](const SurfaceContext& surface) {
+			return glfwWindowShouldClose(surface.window) != 0;
+		});
+	}
+
+	void requestClose() {
+		if (headless()) {
+			m_closeRequested = true;
+		}
+		else {
+			glfwSetWindowShouldClose(m_surfaces.front().window, GLFW_TRUE);
+		}
+	}
+
+	/*
+	Mounts the asset archive if present, otherwise assets are
+	mapped one by one from their loose files
+	*/
+	void mountAssets() {
+		if (fileExists(ASSET_ARCHIVE)) {
+			m_assets.mount(ASSET_ARCHIVE);
+		}
+	}
+
+	/*
+	Only mesh header is read here, data are streamed on buffer creation
+	*/
+	TaskId initAssets(TaskGraph& startup, TaskId mount) {
+		TaskId mesh = startup.add("open mesh", [this]() { openMesh(); }, { mount });
+		TaskId meshlets = startup.add("load meshlets", [this]() { loadMeshlets(); }, { mesh });
+		return startup.add("init scene", [this]() { initScene(); }, { meshlets });
+	}
 
-		m_window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Triangle", nullptr, nullptr);
-		if (!m_window) {
-			glfwTerminate();
-			throw std::runtime_error("ERROR: Failed to create GLFW window!");
+	void openMesh() {
+		if (m_assets.contains(MESH_FILE)) {
+			m_mesh.open(m_assets.load(MESH_FILE), MESH_FILE);
+		}
+		else if (fileExists(MESH_FILE)) {
+			m_mesh.open(MESH_FILE);
+		}
+		else {
+			std::ostringstream stream;
+			writeMeshFile(stream, buildMeshData<MeshVertexLayout>(builtinMesh()));
+			m_builtinMesh = stream.str();
+
+			AssetView builtin;
+			builtin.data = m_builtinMesh.data();
+			builtin.size = m_builtinMesh.size();
+			m_mesh.open(builtin, "built-in quad");
 		}
+	}
+
+	/*
+	Scene so far holds just the mesh, its world matrix reaches
+	shaders through the object buffer at the node's index
+	*/
+	void initScene() {
+		m_meshNode = m_scene.addNode();
+
+		glm::vec3 center, extent;
+		computeMeshletBounds(m_meshlets, center, extent);
+		m_scene.setLocalBounds(m_meshNode, center, extent);
+		m_scene.setDrawState(m_meshNode, makeDrawStateKey(0, 0, 0));
+	}
 
-		glfwSetWindowUserPointer(m_window, this);
-		glfwSetKeyCallback(m_window, windowKeyCallback);
-		glfwSetWindowSizeCallback(m_window, windowSizeCallback);
+	/*
+	Meshes converted before meshlets existed are drawn as one never culled meshlet
+	*/
+	void loadMeshlets() {
+		VkDeviceSize meshletSize = m_mesh.sectionSize(MESH_SECTION_MESHLETS);
+		if (meshletSize > 0) {
+			std::vector<char> meshletData(static_cast<size_t>(meshletSize));
+			m_mesh.readSection(MESH_SECTION_MESHLETS, meshletData.data());
+			m_meshlets.deserialize(meshletData.data(), meshletData.size());
+		}
+		else {
+			m_meshlets.resize(1);
+			m_meshlets.radius[0] = std::numeric_limits<float>::max();
+			m_meshlets.coneCutoff[0] = 2.0f;
+			m_meshlets.firstIndex[0] = 0;
+			m_meshlets.indexCount[0] = m_mesh.header().indexCount;
+		}
 	}
 
 	static void windowSizeCallback(GLFWwindow* window, int width, int height) {
 		HelloTriangleApplication* app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
-		app->recreateSwapchain();
-	}
-
-	void initVulkan() {
-		createInstance();
-		setupDebugCallback();
-		createSurface();
-		selectPhysicalDevice();
-		createLogicalDevice();
-		createSwapchain();
-		createImageViews();
-		createRenderPass();
-		createDescriptorSetLayout();
-		createGraphicsPipeline();
-		createFramebuffers();
-		createCommandPool();
-		createVertexBuffer();
-		createIndexBuffer();
-		createUniformBuffer();
-		createDescriptorPool();
-		createDescriptorSet();
-		createCommandBuffers();
-		createSemaphores();
+		for (SurfaceContext& surface : app->m_surfaces) {
+			if (surface.window == window) {
+				surface.windowExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+				app->recreateSwapchain(surface);
+			}
+		}
 	}
 
-	void mainLoop() {
-		while (!glfwWindowShouldClose(m_window)) {
-			glfwPollEvents();
+	/*
+	Creation steps with their real dependencies. Once the device exists,
+	swapchain, descriptor and buffer chains run side by side and the pipeline
+	compile overlaps buffer uploads, only command recording waits for everything.
+	Every window has its own swapchain chain. Steps needing meshes or the scene wait for assets
+	*/
+	void initVulkan(TaskGraph& startup, TaskId mount, TaskId assets) {
+		TaskId instance = startup.add("instance", [this]() { createInstance(); });
+		startup.add("debug callback", [this]() { setupDebugCallback(); }, { instance });
+		TaskId surface = startup.add("surfaces", [this]() { createSurfaces(); }, { instance });
+		TaskId physicalDevice = startup.add("physical device", [this]() { selectPhysicalDevice(); }, { surface });
+		//Optional shader variants are used only when built, the archive is checked for them
+		TaskId device = startup.add("logical device", [this]() { createLogicalDevice(); }, { physicalDevice, mount });
+		//Shader variant depends on bindless support
+		TaskId shaders = startup.add("shader files", [this]() { prefetchShaders(); }, { assets, device });
+
+		TaskId surfaceFormat = startup.add("surface format", [this]() { selectSurfaceFormat(); }, { device });
+		TaskId renderPass = startup.add("render pass", [this]() { createRenderPass(); }, { surfaceFormat });
+		TaskId setLayout = startup.add("descriptor set layout", [this]() { createDescriptorSetLayout(); }, { device });
+		TaskId pipeline = startup.add("graphics pipeline", [this]() { createGraphicsPipeline(); }, { renderPass, setLayout, shaders });
+		TaskId toneMapper = startup.add("tone mapper", [this]() { createToneMapper(); }, { device, shaders, surfaceFormat });
+
+		std::vector<TaskId> recordDependencies = { pipeline };
+		for (SurfaceContext& context : m_surfaces) {
+			SurfaceContext* surface = &context;
+			TaskId swapchain = startup.add("swapchain", [this, surface]() { createSwapchain(*surface); }, { surfaceFormat });
+			TaskId imageViews = startup.add("image views", [this, surface]() { createImageViews(*surface); }, { swapchain });
+			recordDependencies.push_back(startup.add("framebuffers", [this, surface]() { createFramebuffers(*surface); }, { imageViews, toneMapper }));
+			recordDependencies.push_back(startup.add("render graph", [this, surface]() { createRenderGraph(*surface); }, { swapchain, renderPass, toneMapper }));
+			if (surface == &m_surfaces.front()) {
+				startup.add("frame readback", [this]() { createFrameReadback(); }, { swapchain });
+			}
+		}
+
+		TaskId commandPool = startup.add("command pool", [this]() { createCommandPool(); }, { device });
+		TaskId vertexBuffer = startup.add("vertex buffer", [this]() { createVertexBuffer(); }, { commandPool, assets });
+		TaskId indexBuffer = startup.add("index buffer", [this]() { createIndexBuffer(); }, { commandPool, assets });
+		TaskId indirectBuffer = startup.add("indirect buffer", [this]() { createIndirectBuffer(); }, { device, assets });
+		TaskId objectBuffer = startup.add("object buffer", [this]() { createObjectBuffer(); }, { device, assets });
+		TaskId uniformBuffer = startup.add("uniform buffer", [this]() { createUniformBuffer(); }, { device });
+		TaskId descriptorSet = startup.add("descriptor set", [this]() { createDescriptorSet(); }, { setLayout, objectBuffer, uniformBuffer });
+
+		recordDependencies.insert(recordDependencies.end(), { vertexBuffer, indexBuffer, indirectBuffer, descriptorSet });
+		startup.add("command buffers", [this]() {
+			for (SurfaceContext& surface : m_surfaces) {
+				createCommandBuffers(surface);
+			}
+		}, recordDependencies);
+		startup.add("semaphores", [this]() { createSemaphores(); }, { device });
+	}
+
+	/*
+	Maps shader code and touches its pages, so pipeline creation does not
+	wait on the disk. Mappings stay cached in the asset loader until then
+	*/
+	void prefetchShaders() {
+		std::vector<const char*> shaders = { vertexShader(), FRAGMENT_SHADER, FULLSCREEN_VERTEX_SHADER, TONEMAP_FRAGMENT_SHADER, HISTOGRAM_SHADER, exposureShader() };
+		if (CLASSIFY_FRAGMENT_SHADER) {
+			shaders.push_back(CLASSIFY_FRAGMENT_SHADER);
+		}
+		for (const char* shader : shaders) {
+			AssetView code = m_assets.load(shader);
+			volatile uint8_t sink = 0;
+			for (size_t offset = 0; offset < code.size; offset += 4096) {
+				sink ^= static_cast<uint8_t>(code.data[offset]);
+			}
+		}
+	}
+
+	const char* vertexShader() const {
+		return m_bindless ? VERTEX_SHADER_BINDLESS : VERTEX_SHADER;
+	}
+
+	const char* exposureShader() const {
+		return m_subgroupArithmetic ? EXPOSURE_SHADER_SUBGROUP : EXPOSURE_SHADER;
+	}
+
+	/*
+	Startup breakdown: when each step started relative to launch and how long it ran.
+	Sum of steps above the wall time is the work overlapped on worker threads
+	*/
+	void printStartupTimes(const TaskGraph& startup, std::chrono::high_resolution_clock::time_point startupStart) {
+		auto now = std::chrono::high_resolution_clock::now();
+		double wall = std::chrono::duration<double, std::milli>(now - startupStart).count();
+		double graphStart = std::chrono::duration<double, std::milli>(startup.startTime() - startupStart).count();
+
+		double sum = graphStart;
+		std::ostringstream stream;
+		stream << std::fixed << std::setprecision(2);
+		stream << "  " << std::setw(24) << std::left << "window" << std::right << " at " << std::setw(8) << 0.0 << " ms, took " << std::setw(8) << graphStart << " ms" << std::endl;
+		for (TaskId task = 0; task < startup.size(); task++) {
+			sum += startup.milliseconds(task);
+			stream << "  " << std::setw(24) << std::left << startup.name(task) << std::right
+				<< " at " << std::setw(8) << graphStart + startup.startMilliseconds(task) << " ms, took " << std::setw(8) << startup.milliseconds(task) << " ms" << std::endl;
+		}
+		std::cout << "Startup " << wall << " ms (" << sum << " ms of steps on " << m_threadPool.size() << " threads)" << std::endl << stream.str();
+	}
+
+	/*
+	Render scale follows GPU frame time measured with timestamps, without them it stays fixed
+	*/
+	void initDynamicResolution() {
+		m_resolution.init(m_options.resolution);
+		if (!m_resolution.enabled()) {
+			return;
+		}
+		if (!m_gpuTimer.supported()) {
+			std::cout << "Warning: graphics queue has no timestamps, rendering at fixed scale " << m_resolution.scale() << std::endl;
+			return;
+		}
+		if (m_readback.enabled() && m_options.capture.format == CaptureFormat::Compare) {
+			std::cout << "Warning: compared frames depend on GPU load with --gpu-budget" << std::endl;
+		}
+		std::cout << "Dynamic resolution holds " << m_options.resolution.targetMilliseconds << " ms of GPU time, scale "
+			<< m_options.resolution.minScale << " to " << m_options.resolution.maxScale << std::endl;
+	}
+
+	/*
+	CPU work of a frame. Runs after the previous frame finished on the GPU,
+	so object data, indirect commands and uniforms can be overwritten
+	*/
+	void initFrameGraph() {
+		TaskId update = m_frameGraph.add("scene update", [this]() { m_scene.update(m_threadPool, m_objectData); });
+		//Shaders output positions as they are, the view projection is identity
+		TaskId cull = m_frameGraph.add("visibility", [this]() { m_visibility.run(m_threadPool, m_scene, glm::mat4(1.0f)); }, { update });
+		m_frameGraph.add("draw commands", [this]() { updateDrawCommands(); }, { cull });
+	}
 
-			updateUniformData();
+	void mainLoop() {
+		while (!windowsShouldClose()) {
+			m_frameLimiter.wait();
+
+			//Input is sampled here, latency is measured from this point
+			m_frameStart = std::chrono::high_resolution_clock::now();
+			m_blockedMilliseconds = 0.0;
+			if (!headless()) {
+				glfwPollEvents();
+			}
 
 			drawFrame();
+
+			std::string report;
+			if (m_profiler.endFrame(report)) {
+				std::cout << report << std::endl;
+				m_maxLatency = 0.0;
+			}
 		}
 
 		vkDeviceWaitIdle(m_logicalDevice);
@@ -204,13 +545,35 @@ private:
 
 	void cleanup() {
 		//Vulkan cleanup
-		vkDestroySemaphore(m_logicalDevice, m_imageAvailableSemaphore, nullptr);
-		vkDestroySemaphore(m_logicalDevice, m_renderFinishedSemaphore, nullptr);
+		for (SurfaceContext& surface : m_surfaces) {
+			vkDestroySemaphore(m_logicalDevice, surface.imageAvailableSemaphore, nullptr);
+			vkDestroySemaphore(m_logicalDevice, surface.renderFinishedSemaphore, nullptr);
+		}
+
+		//Writes out frames still in flight
+		m_readback.cleanup();
+		for (SurfaceContext& surface : m_surfaces) {
+			cleanupSwapchain(surface);
+			//No frame follows, device is idle
+			releaseRetiredSwapchains(surface, m_timeline.submitted());
+		}
+		m_deletionQueue.flush();
 
-		cleanupSwapchain();
+		for (SurfaceContext& surface : m_surfaces) {
+			m_toneMapper.destroyExposure(surface.exposure);
+		}
+		m_toneMapper.cleanup();
+		for (VkPipeline pipeline : m_variantPipelines) {
+			vkDestroyPipeline(m_logicalDevice, pipeline, nullptr);
+		}
+		vkDestroyPipeline(m_logicalDevice, m_graphicsPipeline, nullptr);
+		vkDestroyPipelineLayout(m_logicalDevice, m_pipelineLayout, nullptr);
+		vkDestroyRenderPass(m_logicalDevice, m_renderPass, nullptr);
 
-		vkDestroyDescriptorSetLayout(m_logicalDevice, m_descriptorSetLayout, nullptr);
-		vkDestroyDescriptorPool(m_logicalDevice, m_descriptorPool, nullptr);
+		m_descriptorUpdater.cleanup();
+		m_descriptorAllocator.cleanup();
+		m_layoutCache.cleanup();
+		m_bindlessDescriptors.cleanup();
 
 		vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
 
@@ -218,16 +581,32 @@ private:
 		vkFreeMemory(m_logicalDevice, m_vertexBufferMemory, nullptr);
 		vkDestroyBuffer(m_logicalDevice, m_indexBuffer, nullptr);
 		vkFreeMemory(m_logicalDevice, m_indexBufferMemory, nullptr);
+		vkUnmapMemory(m_logicalDevice, m_indirectBufferMemory);
+		vkDestroyBuffer(m_logicalDevice, m_indirectBuffer, nullptr);
+		vkFreeMemory(m_logicalDevice, m_indirectBufferMemory, nullptr);
+		vkUnmapMemory(m_logicalDevice, m_objectBufferMemory);
+		vkDestroyBuffer(m_logicalDevice, m_objectBuffer, nullptr);
+		vkFreeMemory(m_logicalDevice, m_objectBufferMemory, nullptr);
 		vkDestroyBuffer(m_logicalDevice, m_uniformBuffer, nullptr);
 		vkFreeMemory(m_logicalDevice, m_uniformBufferMemory, nullptr);
 
+		m_gpuTimer.cleanup();
+		m_timeline.cleanup();
 		vkDestroyDevice(m_logicalDevice, nullptr);
-		DestroyDebugReportCallbackEXT(m_instance, m_debugCallback, nullptr);
-		vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+		m_debug.cleanup();
+		if (headless()) {
+			vkDestroyInstance(m_instance, nullptr);
+			return;
+		}
+		for (SurfaceContext& surface : m_surfaces) {
+			vkDestroySurfaceKHR(m_instance, surface.surface, nullptr);
+		}
 		vkDestroyInstance(m_instance, nullptr);
 
 		//GLFW cleanup
-		glfwDestroyWindow(m_window);
+		for (SurfaceContext& surface : m_surfaces) {
+			glfwDestroyWindow(surface.window);
+		}
 		glfwTerminate();
 	}
 
@@ -235,7 +614,7 @@ private:
 		/*
 		Checking for support of given validation layers before instance creation
 		*/
-		if (enableValidationLayers && !checkValidationLayerSupport()) {
+		if (enableValidationLayers && !selectValidationLayer()) {
 			throw std::runtime_error("ERROR:Validation layers requested, but not available!");
 		}
 
@@ -248,7 +627,8 @@ private:
 		programInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		programInfo.pEngineName = "No Engine";
 		programInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		programInfo.apiVersion = VK_API_VERSION_1_0;
+		m_apiVersion = instanceApiVersion();
+		programInfo.apiVersion = m_apiVersion;
 
 		/*
 		This struct is mandatory and tells Vulkan driver which extensions/validation layers to use
@@ -261,10 +641,6 @@ private:
 		/*
 		Here we get extensions from used window system (Vulkan is platform agnostic)
 		*/
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
 		auto extensions = getRequiredExtensions();
 		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 		createInfo.ppEnabledExtensionNames = extensions.data();
@@ -275,8 +651,8 @@ private:
 		Adding validation layers into the instance
 		*/
 		if (enableValidationLayers) {
-			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-			createInfo.ppEnabledLayerNames = validationLayers.data();
+			createInfo.enabledLayerCount = 1;
+			createInfo.ppEnabledLayerNames = &m_validationLayer;
 		}
 		else {
 			createInfo.enabledLayerCount = 0;
@@ -285,13 +661,12 @@ private:
 		/*
 		Vulkan instance creation
 		*/
-		VkResult result = vkCreateInstance(&createInfo, nullptr, &m_instance);
 		if (vkCreateInstance(&createInfo, nullptr, &m_instance) != VK_SUCCESS) {
 			throw std::runtime_error("ERROR:Failed to create instance!");
 		}
 	}
 
-	bool checkValidationLayerSupport() {
+	bool selectValidationLayer() {
 		/*
 		First we need to get all of validation layers
 		*/
@@ -302,111 +677,135 @@ private:
 		vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
 
 		/*
-		Now we check if all of given validation layers
-		are in supported validation layers
+		Now we pick the first of given validation layers
+		which is in supported validation layers
 		*/
 		for (const char* layerName : validationLayers) {
-			bool layerFound = false;
-
 			for (const auto& layerProperties : availableLayers) {
 				if (strcmp(layerName, layerProperties.layerName) == 0) {
 					std::cout << "Layer: " << layerName << " found." << std::endl;
-					layerFound = true;
-					break;
+					m_validationLayer = layerName;
+					return true;
 				}
 			}
-
-			if (!layerFound) {
-				return false;
-			}
 		}
 
-		return true;
+		return false;
 	}
 
+	/*
+	Messages from validation layers go through DebugMessenger, which is empty in release builds
+	*/
 	void setupDebugCallback() {
 		if (!enableValidationLayers) {
 			return;
 		}
-		/*
-		Again as with any other Vulkan object we fill info struct
-		Flags say which messages we want to receive
-		pUserData can be used to transfer use data into the callback function
-		(rg. send a whole program object)
-		*/
-		VkDebugReportCallbackCreateInfoEXT createInfo = {};
-		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
-		createInfo.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT;
-		createInfo.pfnCallback = debugCallback;
-
-		/*
-		Because debug callback is specific for the whole Vulkan instance and it's layers,
-		we need to set it first
-		*/
-		if (CreateDebugReportCallbackEXT(m_instance, &createInfo, nullptr, &m_debugCallback) != VK_SUCCESS) {
-			throw std::runtime_error("ERROR: Failed to set up debug callback!");
-		}
-	}
-
-	/*
-	Debug callback function that reports messages from validation layers
-	VKAPI_ATTR and VKAPI_CALL guarantee the right Vulkan signature for the func.
-	flags
-		VK_DEBUG_REPORT_INFORMATION_BIT_EXT
-		VK_DEBUG_REPORT_WARNING_BIT_EXT
-		VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT
-		VK_DEBUG_REPORT_ERROR_BIT_EXT
-		VK_DEBUG_REPORT_DEBUG_BIT_EXT
-
-	Returns boolean: true if we want to abort whole Vulkan call, which
-	set off the validation layer (good for testing) otherwise return VK_FALSE
-	*/
-	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
-		VkDebugReportFlagsEXT flags,
-		VkDebugReportObjectTypeEXT objType,
-		uint64_t obj,
-		size_t location,
-		int32_t code,
-		const char* layer_prefix,
-		const char* msg,
-		void* userData) {
-
-		std::cerr << "Validation layer: " << msg << std::endl;
-
-		return VK_FALSE;
+		m_debug.init(m_instance);
 	}
 
 	/*
 	Returns vector of extensions
-	GLFW extensions are needed but DEBUG REPORT is added
+	GLFW extensions are needed (except headless) but DEBUG UTILS (or DEBUG REPORT) is added
 	if validation layers are on
 	*/
 	std::vector<const char*> getRequiredExtensions() {
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		std::vector<const char*> extensions;
+		if (!headless()) {
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		uint32_t availableCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(availableCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, availableExtensions.data());
 
 		if (enableValidationLayers) {
-			extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+			extensions.push_back(m_debug.selectExtension(availableExtensions));
+		}
+
+		//Extended feature queries, needed to detect descriptor indexing on Vulkan 1.0
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+				extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+				m_physicalDeviceProperties2 = true;
+			}
 		}
 
 		return extensions;
 	}
 
 	/*
-	Creates window surface
+	Vulkan 1.1 is requested when the loader has it, devices which support
+	it then expose subgroup operations. 1.0 loaders lack the query
+	*/
+	uint32_t instanceApiVersion() {
+#ifdef VK_VERSION_1_1
+		auto enumerateVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+		uint32_t version = VK_API_VERSION_1_0;
+		if (enumerateVersion && enumerateVersion(&version) == VK_SUCCESS && version >= VK_API_VERSION_1_1) {
+			return VK_API_VERSION_1_1;
+		}
+#endif
+		return VK_API_VERSION_1_0;
+	}
+
+	/*
+	Creates window surfaces, the device is chosen for the first one
 	*/
-	void createSurface() {
-		if (glfwCreateWindowSurface(m_instance, m_window, nullptr, &m_surface) != VK_SUCCESS) {
-			throw std::runtime_error("ERROR: Failed to create window surface!");
+	void createSurfaces() {
+		if (headless()) {
+			return;
+		}
+		for (SurfaceContext& surface : m_surfaces) {
+			if (glfwCreateWindowSurface(m_instance, surface.window, nullptr, &surface.surface) != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to create window surface!");
+			}
 		}
 	}
 
 	/*
-	Selects physical device from all available
-	devices based on it's "suitability"
+	Render pass and pipeline are shared, so all windows need the format chosen
+	for the first one. Other windows may be on displays the present queue can not reach.
+	Offscreen image is plain RGBA8, tone mapping encodes sRGB as it does for UNORM swapchains
+	*/
+	void selectSurfaceFormat() {
+		if (headless()) {
+			m_surfaceFormat = { VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+			return;
+		}
+		m_surfaceFormat = chooseSwapSurfaceFormat(m_deviceCaps.swapchain.formats);
+
+		for (SurfaceContext& surface : m_surfaces) {
+			VkBool32 presentSupport = VK_FALSE;
+			vkGetPhysicalDeviceSurfaceSupportKHR(m_physicalDevice, m_deviceCaps.queueFamilies.presentFamily, surface.surface, &presentSupport);
+			if (!presentSupport) {
+				throw std::runtime_error("ERROR: Window can not be presented from the selected device!");
+			}
+
+			surface.support = querySwapchainSupport(m_physicalDevice, surface.surface);
+			const std::vector<VkSurfaceFormatKHR>& formats = surface.support.formats;
+			bool anyFormat = formats.size() == 1 && formats[0].format == VK_FORMAT_UNDEFINED;
+			bool supported = std::any_of(formats.begin(), formats.end(), [this](const VkSurfaceFormatKHR& format) {
+				return format.format == m_surfaceFormat.format && format.colorSpace == m_surfaceFormat.colorSpace;
+			});
+			if (!anyFormat && !supported) {
+				throw std::runtime_error("ERROR: Windows do not share a surface format!");
+			}
+		}
+	}
+
+	/*
+	Swapchain is the only required extension, offscreen rendering does without it
+	*/
+	std::vector<const char*> requiredDeviceExtensions() const {
+		return headless() ? std::vector<const char*>() : deviceExtensions;
+	}
+
+	/*
+	Selects the best scoring physical device (see scoreDevice), its
+	capabilities stay cached for the rest of the run
 	*/
 	void selectPhysicalDevice() {
 		uint32_t deviceCount = 0;
@@ -419,141 +818,106 @@ private:
 		std::vector<VkPhysicalDevice> devices(deviceCount);
 		vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
 
+		int64_t bestScore = -1;
 		for (const auto &device : devices) {
-			if (isDeviceSuitable(device)) {
-				m_physicalDevice = device;
-				break;
+			DeviceCapabilities caps = queryDeviceCapabilities(device, m_surfaces.front().surface);
+			int64_t score = scoreDevice(caps, requiredDeviceExtensions(), !headless());
+			if (score >= 0 && !m_options.device.empty() && std::string(caps.properties.deviceName).find(m_options.device) == std::string::npos) {
+				score = -1;
+			}
+			std::cout << "Device " << caps.properties.deviceName << ": " << (caps.deviceLocalBytes >> 20) << " MB local, score " << score << std::endl;
+			if (score > bestScore) {
+				bestScore = score;
+				m_deviceCaps = std::move(caps);
 			}
 		}
 
-		if (m_physicalDevice == VK_NULL_HANDLE) {
+		if (bestScore < 0) {
 			throw std::runtime_error("ERROR:Failed to find suitable physical device!");
 		}
+		m_physicalDevice = m_deviceCaps.device;
 	}
 
+#ifdef VK_EXT_descriptor_indexing
 	/*
-	Checks if selected device is suitable to our needs eg.
-		discrete gpu
-		support for given queue families
+	Bindless needs descriptor indexing with runtime sized, partially bound arrays
+	which can be written while bound. Shaders select buffers of the arrays by push
+	constants, which needs dynamic indexing of storage buffer arrays
 	*/
-	bool isDeviceSuitable(const VkPhysicalDevice& device) {
-		/*
-		//Name, version and Vulkan support
-		VkPhysicalDeviceProperties deviceProperties;
-		//Optional support: 64bit floats, texture compression, multi-viewport rendering
-		VkPhysicalDeviceFeatures deviceFeatures;
-
-		vkGetPhysicalDeviceProperties(device, &deviceProperties);
-		vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-		*/
-		QueueFamilyIndices indices = findQueueFamilies(device);
-
-		//Check the extension support
-		bool extensionsSupported = checkDeviceExtensionSupport(device);
-
-		//Check swapchain support: at least one supported image format and one present. mode for given window surface
-		bool swapchainSupported = false;
-		if (extensionsSupported) {
-			SwapchainSupportDetails swapchainSupport = querySwapchainSupport(device);
-			swapchainSupported = !swapchainSupport.formats.empty() && !swapchainSupport.presentModes.empty();
+	bool querySupportedBindlessFeatures(VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexingFeatures) {
+		if (!m_physicalDeviceProperties2 || !m_deviceCaps.features.shaderStorageBufferArrayDynamicIndexing ||
+			!m_deviceCaps.hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+			!m_deviceCaps.hasExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+			return false;
 		}
 
-		return (indices.isComplete() && extensionsSupported && swapchainSupported);
-	}
-
-	/*
-	Checks if selected device supports ALL extensions listed in
-	deviceExtensions global list
-	*/
-	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
-		uint32_t extensionsCount = 0;
-		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionsCount, nullptr);
-
-		std::vector<VkExtensionProperties> availableExtensions(extensionsCount);
-		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionsCount, availableExtensions.data());
-
-		//Copy all extensions into a set
-		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-		//For each required extensions present, erase it from the set
-		for (const auto &extension : availableExtensions) {
-			std::cout << "Avail. Extension: " << extension.extensionName << std::endl;
-			requiredExtensions.erase(extension.extensionName);
+		auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceFeatures2KHR");
+		if (!getFeatures2) {
+			return false;
 		}
-
-		return requiredExtensions.empty();
+		VkPhysicalDeviceFeatures2KHR features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features.pNext = &indexingFeatures;
+		getFeatures2(m_physicalDevice, &features);
+
+		return indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound &&
+			indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+			indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
 	}
+#endif
 
 	/*
-	Search for all queue families, which are supported by the device: compute, graphics, etc.
+	Exposure reduces the luminance histogram with subgroup additions when
+	compute shaders of a Vulkan 1.1 device support them
 	*/
-	QueueFamilyIndices findQueueFamilies(const VkPhysicalDevice& device) {
-		QueueFamilyIndices indices;
-		uint32_t queueFamilyCount = 0;
-		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-
-		/*
-		Indices hold indices of searched queues
-		*/
-		int i = 0;
-		for (const auto& queueFamily : queueFamilies) {
-			//Hledani podpory pro grafickou frontu
-			if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-				indices.graphicsFamily = i;
-			}
-
-			/*
-			Searching for support for presenting into the surface -> it's required to search separately
-			It is possible to prioritize device which supports presenting and rendering on the same queue
-			for better performance
-			*/
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
-			if (queueFamily.queueCount > 0 && presentSupport) {
-				indices.presentFamily = i;
-			}
-
-			if (indices.isComplete()) {
-				break;
-			}
-			i++;
+	bool querySubgroupArithmetic() {
+#ifdef VK_VERSION_1_1
+		if (m_apiVersion < VK_API_VERSION_1_1 || m_deviceCaps.properties.apiVersion < VK_API_VERSION_1_1) {
+			return false;
 		}
 
-		return indices;
+		auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceProperties2");
+		if (!getProperties2) {
+			return false;
+		}
+		VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+		subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &subgroupProperties;
+		getProperties2(m_physicalDevice, &properties);
+
+		const VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+		return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0 &&
+			(subgroupProperties.supportedOperations & required) == required;
+#else
+		return false;
+#endif
 	}
 
+#ifdef VK_KHR_timeline_semaphore
 	/*
-	Queries for swapchain support and populates the SwapchainSupportDetails struct
+	Timeline semaphores replace fences of the GPU timeline when supported
 	*/
-	SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice device) {
-		SwapchainSupportDetails swapchainDetails;
-
-		//Basic surface capabilities
-		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_surface, &swapchainDetails.capabilities);
-
-		//Supported surface formats
-		uint32_t formatCount = 0;
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_surface, &formatCount, nullptr);
-
-		if (formatCount != 0) {
-			swapchainDetails.formats.resize(formatCount);
-			vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_surface, &formatCount, swapchainDetails.formats.data());
+	bool querySupportedTimelineFeatures() {
+		if (!m_physicalDeviceProperties2 || !m_deviceCaps.hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			return false;
 		}
 
-		//Supported presentation modes
-		uint32_t presentModesCount = 0;
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_surface, &presentModesCount, nullptr);
-
-		if (presentModesCount != 0) {
-			swapchainDetails.presentModes.resize(presentModesCount);
-			vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_surface, &presentModesCount, swapchainDetails.presentModes.data());
+		auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceFeatures2KHR");
+		if (!getFeatures2) {
+			return false;
 		}
-
-		return swapchainDetails;
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2KHR features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features.pNext = &timelineFeatures;
+		getFeatures2(m_physicalDevice, &features);
+
+		return timelineFeatures.timelineSemaphore == VK_TRUE;
 	}
+#endif
 
 	/*
 	Selects optimal VkSurface from 
@@ -589,38 +953,22 @@ private:
 								are simply replaced with the newer ones. This mode can be used to implement triple buffering, which allows you to avoid tearing with significantly
 								less latency issues than standard vertical sync that uses double buffering.
 	*/
-	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes) {
-		/*
-		Here we are lookig for triple buffering option and if its not found, then look for immediate mode
-		FIFO mode is guaranteed to be available but there might be problems with it in some drivers
-		*/	
-		VkPresentModeKHR selectedMode = VK_PRESENT_MODE_FIFO_KHR;
-
-		for (const auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-				return availablePresentMode;
-			}
-			else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-				selectedMode = availablePresentMode;
-			}
-		}
-
-		return selectedMode;
+	PresentConfig chooseSwapPresentConfig(const SwapchainSupportDetails& details) {
+		//Mode and image count follow the present policy given on the command line
+		return choosePresentConfig(m_options.presentPolicy, details.presentModes, details.capabilities);
 	}
 	
 	/*
 	Selects swap extent.
 	Swap extent is the resolution of the swapchain images
 	*/
-	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
+	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, VkExtent2D windowExtent) {
 		if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
 			return capabilities.currentExtent;
 		}
 		else {
-			int width, height;
-			glfwGetWindowSize(m_window, &width, &height);
-
-			VkExtent2D actualExtent = { width, height };
+			//Window size is tracked on the main thread, GLFW can not be queried from startup tasks
+			VkExtent2D actualExtent = windowExtent;
 
 			actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
 			actualExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actualExtent.height));
@@ -630,7 +978,7 @@ private:
 	}
 
 	void createLogicalDevice() {
-		QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+		const QueueFamilyIndices& indices = m_deviceCaps.queueFamilies;
 
 		/*
 		Drivers so far support creation of a small number of queues
@@ -653,6 +1001,18 @@ private:
 		//Specification of used device features eg. geometry shader
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 
+		//Meshes with 32-bit indices may address more than the guaranteed 2^24 vertices
+		const VkPhysicalDeviceFeatures& supportedFeatures = m_deviceCaps.features;
+		deviceFeatures.fullDrawIndexUint32 = supportedFeatures.fullDrawIndexUint32;
+		//All meshlets are drawn with one indirect call when available
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		m_multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+		//Indirect commands select the object by their first instance when available
+		deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+		m_drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+		//Variant is built only by glslang of a Vulkan 1.1 SDK
+		m_subgroupArithmetic = querySubgroupArithmetic() && m_assets.exists(EXPOSURE_SHADER_SUBGROUP);
+
 		/*
 		Main create info
 		*/
@@ -661,12 +1021,56 @@ private:
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		//Optional extensions, features using them fall back when missing
+		std::vector<const char*> extensions = requiredDeviceExtensions();
+		m_descriptorUpdateTemplates = m_deviceCaps.hasExtension(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+		if (m_descriptorUpdateTemplates) {
+			extensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+		}
+#ifdef VK_EXT_descriptor_indexing
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		m_bindless = querySupportedBindlessFeatures(indexingFeatures);
+		if (m_bindless && !m_assets.exists(VERTEX_SHADER_BINDLESS)) {
+			std::cout << "Warning: " << VERTEX_SHADER_BINDLESS << " is missing, using classic descriptors" << std::endl;
+			m_bindless = false;
+		}
+		if (m_bindless) {
+			deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+			extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+			//Enable only what the bindless set uses
+			VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexing = {};
+			enabledIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+			enabledIndexing.runtimeDescriptorArray = VK_TRUE;
+			enabledIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+			enabledIndexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			enabledIndexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			enabledIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			indexingFeatures = enabledIndexing;
+			indexingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+			createInfo.pNext = &indexingFeatures;
+		}
+#endif
+		bool timelineSemaphore = false;
+#ifdef VK_KHR_timeline_semaphore
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineSemaphore = querySupportedTimelineFeatures();
+		if (timelineSemaphore) {
+			extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineFeatures.timelineSemaphore = VK_TRUE;
+			timelineFeatures.pNext = const_cast<void*>(createInfo.pNext);
+			createInfo.pNext = &timelineFeatures;
+		}
+#endif
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
 
 		if (enableValidationLayers) {
-			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-			createInfo.ppEnabledLayerNames = validationLayers.data();
+			createInfo.enabledLayerCount = 1;
+			createInfo.ppEnabledLayerNames = &m_validationLayer;
 		}
 		else {
 			createInfo.enabledLayerCount = 0;
@@ -679,33 +1083,50 @@ private:
 		//Handles for created queue
 		vkGetDeviceQueue(m_logicalDevice, indices.graphicsFamily, 0, &m_graphicsQueue);
 		vkGetDeviceQueue(m_logicalDevice, indices.presentFamily, 0, &m_presentQueue);
+
+		m_layoutCache.init(m_logicalDevice);
+		m_descriptorAllocator.init(m_logicalDevice);
+		m_timeline.init(m_logicalDevice, timelineSemaphore);
+		m_gpuTimer.init(m_logicalDevice, m_deviceCaps.properties.limits, m_deviceCaps.queueFamilyProperties[indices.graphicsFamily].timestampValidBits);
+		m_deletionQueue.init(m_logicalDevice);
+		m_debug.setDevice(m_logicalDevice);
 	}
 
 	/*
-	Creates swapchain based on the info from SwapChainSupportDetails
+	Creates swapchain of the window based on the info from SwapChainSupportDetails
 	*/
-	void createSwapchain() {
-		SwapchainSupportDetails swapchainDetails = querySwapchainSupport(m_physicalDevice);
+	void createSwapchain(SurfaceContext& surface) {
+		if (headless()) {
+			createOffscreenImage(surface);
+			return;
+		}
+		//Formats and present modes do not change, current extent follows the window
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, surface.surface, &surface.support.capabilities);
+		const SwapchainSupportDetails& swapchainDetails = surface.support;
 
-		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapchainDetails.formats);
-		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapchainDetails.presentModes);
-		VkExtent2D extent = chooseSwapExtent(swapchainDetails.capabilities);
+		VkSurfaceFormatKHR surfaceFormat = m_surfaceFormat;
+		PresentConfig presentConfig = chooseSwapPresentConfig(swapchainDetails);
+		VkExtent2D extent = chooseSwapExtent(swapchainDetails.capabilities, surface.windowExtent);
 
-		//Actual number of images in the queue, maxImageCount = 0 is no limit beside memory req.
-		uint32_t imageCount = swapchainDetails.capabilities.minImageCount + 1;
-		if (swapchainDetails.capabilities.maxImageCount > 0 && imageCount > swapchainDetails.capabilities.maxImageCount) {
-			imageCount = swapchainDetails.capabilities.maxImageCount;
-		}
+		//Minimal number of images in the queue, driver may create more
+		uint32_t imageCount = presentConfig.imageCount;
 
 		VkSwapchainCreateInfoKHR createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-		createInfo.surface = m_surface; //which surface swapchain is tied to
+		createInfo.surface = surface.surface; //which surface swapchain is tied to
 		createInfo.minImageCount = imageCount;
 		createInfo.imageFormat = surfaceFormat.format;
 		createInfo.imageColorSpace = surfaceFormat.colorSpace;
 		createInfo.imageExtent = extent;
 		createInfo.imageArrayLayers = 1; //No. of layers for each image. Always 1 if not stereoscopic 3D program
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; //Usage. In this case, directly draw to them
+		if (!m_options.capture.path.empty() && &surface == &m_surfaces.front()) {
+			//Frame capture copies images out of the first swapchain
+			if (!(swapchainDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+				throw std::runtime_error("ERROR: Swapchain images can not be copied, frame capture is not supported!");
+			}
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
 
 		/*
 		Next is required to specify, how to handle images shared across multiple
@@ -719,7 +1140,7 @@ private:
 									Images can be used across multiple queue families without explicit
 									ownership transfers.
 		*/
-		QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+		const QueueFamilyIndices& indices = m_deviceCaps.queueFamilies;
 		uint32_t queueFamilyIndices[] = { (uint32_t)indices.graphicsFamily, (uint32_t)indices.presentFamily };
 
 		if (indices.graphicsFamily != indices.presentFamily) {
@@ -734,57 +1155,146 @@ private:
 		}
 		createInfo.preTransform = swapchainDetails.capabilities.currentTransform; //Transf. of images like 90 rotation
 		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-		createInfo.presentMode = presentMode;
+		createInfo.presentMode = presentConfig.mode;
 		createInfo.clipped = VK_TRUE; //True means we dont care for colour of obstructed pixels by eg. another window
-		createInfo.oldSwapchain = VK_NULL_HANDLE; //If the swapchain is invalidated and recreated, give ref. to previous one
+		createInfo.oldSwapchain = surface.swapchain; //If the swapchain is invalidated and recreated, give ref. to previous one
 
-		if (vkCreateSwapchainKHR(m_logicalDevice, &createInfo, nullptr, &m_swapchain) != VK_SUCCESS) {
+		if (vkCreateSwapchainKHR(m_logicalDevice, &createInfo, nullptr, &surface.swapchain) != VK_SUCCESS) {
 			throw std::runtime_error("ERROR: Failed to create swap chain!");
 		}
 
 		/*
 		Retrieve handles to images in swapchain
 		*/
-		vkGetSwapchainImagesKHR(m_logicalDevice, m_swapchain, &imageCount, nullptr);
-		m_swapchainImages.resize(imageCount);
-		vkGetSwapchainImagesKHR(m_logicalDevice, m_swapchain, &imageCount, m_swapchainImages.data());
+		vkGetSwapchainImagesKHR(m_logicalDevice, surface.swapchain, &imageCount, nullptr);
+		surface.images.resize(imageCount);
+		vkGetSwapchainImagesKHR(m_logicalDevice, surface.swapchain, &imageCount, surface.images.data());
 
 		//Saved the format and extent
-		m_swapchainImageFormat = surfaceFormat.format;
-		m_swapchainExtent = extent;
+		surface.format = surfaceFormat.format;
+		surface.extent = extent;
+
+		std::cout << "Swapchain " << extent.width << "x" << extent.height << ", " << presentPolicyName(m_options.presentPolicy)
+			<< " present mode " << presentConfig.mode << ", " << imageCount << " images" << std::endl;
 	}
 
-	void cleanupSwapchain() {
-		for (size_t i = 0; i < m_swapchainFramebuffers.size(); i++) {
-			vkDestroyFramebuffer(m_logicalDevice, m_swapchainFramebuffers[i], nullptr);
+	/*
+	Headless context renders into one device local image of the requested size. Frames
+	start only after the previous one completed, so nothing else is needed to reuse it
+	*/
+	void createOffscreenImage(SurfaceContext& surface) {
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = m_surfaceFormat.format;
+		imageInfo.extent = { surface.windowExtent.width, surface.windowExtent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		//Tone mapped into, then copied out by the frame readback
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkImage image;
+		if (vkCreateImage(m_logicalDevice, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create offscreen image!");
 		}
 
-		vkFreeCommandBuffers(m_logicalDevice, m_commandPool, static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(m_logicalDevice, image, &memoryRequirements);
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memoryRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &surface.offscreenMemory) != VK_SUCCESS) {
+			vkDestroyImage(m_logicalDevice, image, nullptr);
+			throw std::runtime_error("ERROR: Failed to allocate offscreen image memory!");
+		}
+		vkBindImageMemory(m_logicalDevice, image, surface.offscreenMemory, 0);
 
-		vkDestroyPipeline(m_logicalDevice, m_graphicsPipeline, nullptr);
-		vkDestroyPipelineLayout(m_logicalDevice, m_pipelineLayout, nullptr);
-		vkDestroyRenderPass(m_logicalDevice, m_renderPass, nullptr);
+		surface.images = { image };
+		surface.format = m_surfaceFormat.format;
+		surface.extent = surface.windowExtent;
 
-		for (size_t i = 0; i < m_swapchainImageViews.size(); i++) {
-			vkDestroyImageView(m_logicalDevice, m_swapchainImageViews[i], nullptr);
+		std::cout << "Offscreen " << surface.extent.width << "x" << surface.extent.height << " RGBA8 image, no window" << std::endl;
+	}
+
+	/*
+	Queues swapchain dependent objects of the window for destruction after the
+	last submission, frames in flight keep using them meanwhile. The swapchain
+	itself waits for a frame of its successor, see releaseRetiredSwapchains
+	*/
+	void cleanupSwapchain(SurfaceContext& surface) {
+		uint64_t lastUse = m_timeline.submitted();
+
+		//Transient images are released with the graph, a new one is declared for the new swapchain
+		std::shared_ptr<RenderGraph> renderGraph = std::make_shared<RenderGraph>(std::move(surface.renderGraph));
+		surface.renderGraph = RenderGraph();
+		m_deletionQueue.push(lastUse, [renderGraph]() { renderGraph->cleanup(); });
+
+		for (size_t i = 0; i < surface.framebuffers.size(); i++) {
+			m_deletionQueue.destroyFramebuffer(surface.framebuffers[i], lastUse);
+		}
+		m_deletionQueue.destroyFramebuffer(surface.sceneFramebuffer, lastUse);
+		surface.sceneFramebuffer = VK_NULL_HANDLE;
+
+		ToneMapView toneMapView = surface.toneMapView;
+		surface.toneMapView = ToneMapView();
+		m_deletionQueue.push(lastUse, [this, toneMapView]() { m_toneMapper.destroyView(toneMapView); });
+
+		std::vector<VkCommandBuffer> commandBuffers = std::move(surface.commandBuffers);
+		surface.commandBuffers.clear();
+		m_deletionQueue.push(lastUse, [this, commandBuffers]() {
+			std::lock_guard<std::mutex> lock(m_uploadMutex);
+			vkFreeCommandBuffers(m_logicalDevice, m_commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+		});
+
+		for (size_t i = 0; i < surface.imageViews.size(); i++) {
+			m_deletionQueue.destroyImageView(surface.imageViews[i], lastUse);
+		}
+
+		//Offscreen image is not presented, frames using it are covered by the last submission
+		if (headless()) {
+			VkImage image = surface.images.front();
+			m_deletionQueue.push(lastUse, [this, image]() { vkDestroyImage(m_logicalDevice, image, nullptr); });
+			m_deletionQueue.freeMemory(surface.offscreenMemory, lastUse);
+			surface.images.clear();
+			surface.offscreenMemory = VK_NULL_HANDLE;
+			return;
 		}
 
-		vkDestroySwapchainKHR(m_logicalDevice, m_swapchain, nullptr);
+		//Handle stays valid until released, the next swapchain is created from it
+		surface.retiredSwapchains.push_back(surface.swapchain);
+	}
+
+	/*
+	Timeline values do not cover a present still waiting on renderFinishedSemaphore,
+	so retired swapchains are queued for destruction with the first frame submitted on
+	their successor. Its presents are queued after theirs, once the frame's value
+	completed the old ones were consumed
+	*/
+	void releaseRetiredSwapchains(SurfaceContext& surface, uint64_t value) {
+		for (VkSwapchainKHR swapchain : surface.retiredSwapchains) {
+			m_deletionQueue.destroySwapchain(swapchain, value);
+		}
+		surface.retiredSwapchains.clear();
 	}
 
 	/*
 	Creates image views to access images in swapchain to use them
 	as color targets
 	*/
-	void createImageViews() {
-		m_swapchainImageViews.resize(m_swapchainImages.size());
+	void createImageViews(SurfaceContext& surface) {
+		surface.imageViews.resize(surface.images.size());
 
-		for (size_t i = 0; i < m_swapchainImageViews.size(); i++) {
+		for (size_t i = 0; i < surface.imageViews.size(); i++) {
 			VkImageViewCreateInfo createInfo = {};
 			createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			createInfo.image = m_swapchainImages[i];
+			createInfo.image = surface.images[i];
 			createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			createInfo.format = m_swapchainImageFormat;
+			createInfo.format = surface.format;
 			createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 			createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 			createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -795,7 +1305,7 @@ private:
 			createInfo.subresourceRange.baseArrayLayer = 0;
 			createInfo.subresourceRange.layerCount = 1;
 
-			if (vkCreateImageView(m_logicalDevice, &createInfo, nullptr, &m_swapchainImageViews[i]) != VK_SUCCESS) {
+			if (vkCreateImageView(m_logicalDevice, &createInfo, nullptr, &surface.imageViews[i]) != VK_SUCCESS) {
 				throw std::runtime_error("ERROR: Failed to create imageview for swapchain!");
 			}
 		}
@@ -809,7 +1319,7 @@ private:
 	*/
 	void createRenderPass() {
 		VkAttachmentDescription colorAttachment = {};
-		colorAttachment.format = m_swapchainImageFormat;
+		colorAttachment.format = HDR_FORMAT; //tone mapped into the swapchain afterwards
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT; //multisampling
 		/*
 		loadOp and storeOp determine what to do with the data in the attachment
@@ -826,12 +1336,11 @@ private:
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		/*
-		Sets layout of pixels in memory. We first dont care for how pixels
-		are stored since we will clear them to black and after renderpass
-		finishes, we want to transition into finalLayout
+		Sets layout of pixels in memory. Render graph transitions the image
+		for the pass and into present layout after it, with barriers
 		*/
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		/*
 		Subpasses
@@ -842,48 +1351,64 @@ private:
 		colorAttachmentRef.attachment = 0; //We have just one attachment description
 		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+		/*
+		Depth holds pixel classes of the atmosphere, see AtmosphereVariant.
+		Cleared to the far plane where no geometry is, nothing is shaded there
+		*/
+		VkAttachmentDescription depthAttachment = {};
+		depthAttachment.format = SCENE_DEPTH_FORMAT;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depthAttachmentRef = {};
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 		VkSubpassDescription subpass = {};
 		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 		subpass.colorAttachmentCount = 1;
 		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
 		/*
-		Subpass dependencies
-		We could change the waitStages for the imageAvailableSemaphore to VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
-		to ensure that the render passes don't begin until the image is available
-		or this...
+		No subpass dependencies, the render graph barrier before the pass
+		waits for the color output stage the acquire semaphore blocks
 		*/
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
+		VkAttachmentDescription attachments[] = { colorAttachment, depthAttachment };
 		VkRenderPassCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		createInfo.attachmentCount = 1;
-		createInfo.pAttachments = &colorAttachment;
+		createInfo.attachmentCount = 2;
+		createInfo.pAttachments = attachments;
 		createInfo.subpassCount = 1;
 		createInfo.pSubpasses = &subpass;
-		createInfo.dependencyCount = 1;
-		createInfo.pDependencies = &dependency;
+		createInfo.dependencyCount = 0;
+		createInfo.pDependencies = nullptr;
 
 		if (vkCreateRenderPass(m_logicalDevice, &createInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
 			throw std::runtime_error("ERROR: Failed to create render pass!");
 		}
+		m_debug.setObjectName(VK_DEBUG_REPORT_OBJECT_TYPE_RENDER_PASS_EXT, debugObjectHandle(m_renderPass), "scene render pass");
 	}
 
 	/*
 	Creates a shader module which sort of works like a shader bytecode wrapper
+	Code is passed straight from the mapped file, which is page aligned
 	*/
-	VkShaderModule createShaderModule(const std::vector<char>& code) {
+	VkShaderModule createShaderModule(const AssetView& code) {
+		if (code.empty() || code.size % sizeof(uint32_t) != 0) {
+			throw std::runtime_error("ERROR: Invalid SPIR-V code size!");
+		}
+
 		VkShaderModuleCreateInfo createInfo = {};
 		
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+		createInfo.codeSize = code.size;
+		createInfo.pCode = code.words();
 
 		VkShaderModule shaderModule;
 		if (vkCreateShaderModule(m_logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -894,6 +1419,12 @@ private:
 	}
 
 	void createDescriptorSetLayout() {
+		if (m_bindless) {
+			m_bindlessDescriptors.init(m_logicalDevice, m_deviceCaps.properties.limits);
+			m_descriptorSetLayout = m_bindlessDescriptors.layout();
+			return;
+		}
+
 		VkDescriptorSetLayoutBinding uboLayoutBinding = {};
 		uboLayoutBinding.binding = 0;
 		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -901,31 +1432,30 @@ private:
 		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 		uboLayoutBinding.pImmutableSamplers = nullptr; //optional
 
-		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = 1;
-		layoutInfo.pBindings = &uboLayoutBinding;
+		VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+		objectLayoutBinding.binding = 1;
+		objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		objectLayoutBinding.descriptorCount = 1;
+		objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-		if (vkCreateDescriptorSetLayout(m_logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout)) {
-			throw std::runtime_error("ERROR: Failed to create descriptor set layout!");
-		}
+		m_descriptorSetLayout = m_layoutCache.getLayout({ uboLayoutBinding, objectLayoutBinding });
 	}
 
 	void createGraphicsPipeline() {
 		/*
 		Programmable part
 		*/
-		
-#ifdef _DEBUG
-		auto vertShaderCode = readFile("shaders/test.vert.spv");
-		auto fragShaderCode = readFile("shaders/test.frag.spv");
-#else
-		auto vertShaderCode = readFile("shaders/atmosphere.vert.spv");
-		auto fragShaderCode = readFile("shaders/atmosphere.frag.spv");
-#endif
+		VkShaderModule vertShaderModule = createShaderModule(m_assets.load(vertexShader()));
+		VkShaderModule fragShaderModule = createShaderModule(m_assets.load(FRAGMENT_SHADER));
+		VkShaderModule classifyShaderModule = VK_NULL_HANDLE;
+		if (CLASSIFY_FRAGMENT_SHADER) {
+			classifyShaderModule = createShaderModule(m_assets.load(CLASSIFY_FRAGMENT_SHADER));
+			m_assets.release(CLASSIFY_FRAGMENT_SHADER);
+		}
 
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+		//Driver keeps its own copy of the code, loose files can be unmapped
+		m_assets.release(vertexShader());
+		m_assets.release(FRAGMENT_SHADER);
 
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -952,8 +1482,8 @@ private:
 		Attribute descriptions:
 			type of attributes passed into the vertex shader, binding and offset
 		*/
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		auto bindingDescription = m_mesh.header().getBindingDescription();
+		auto attributeDescriptions = m_mesh.header().getAttributeDescriptions();
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexInputInfo.vertexBindingDescriptionCount = 1;
@@ -975,26 +1505,15 @@ private:
 		inputAssembly.primitiveRestartEnable = VK_FALSE;
 
 		/*
-		Viewport and scissors
+		Viewport and scissors are set while recording (see dynamic state),
+		so windows of any size and resized swapchains share the pipeline
 		*/
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)m_swapchainExtent.width;
-		viewport.height = (float)m_swapchainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0, 0 };
-		scissor.extent = m_swapchainExtent;
-
 		VkPipelineViewportStateCreateInfo viewportState = {};
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
+		viewportState.pViewports = nullptr;
 		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
+		viewportState.pScissors = nullptr;
 
 		/*
 		Rasterizer performs depth testing and backface culling.
@@ -1020,7 +1539,20 @@ private:
 
 		/*
 		Depth and stencil configuration
+		Depth holds pixel classes: classification writes them regardless of geometry depth,
+		variants only test for their own. Without classification depth is not used
 		*/
+		VkPipelineDepthStencilStateCreateInfo classifyDepth = {};
+		classifyDepth.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		classifyDepth.depthTestEnable = classifyShaderModule != VK_NULL_HANDLE ? VK_TRUE : VK_FALSE;
+		classifyDepth.depthWriteEnable = classifyDepth.depthTestEnable;
+		classifyDepth.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+
+		VkPipelineDepthStencilStateCreateInfo variantDepth = {};
+		variantDepth.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		variantDepth.depthTestEnable = VK_TRUE;
+		variantDepth.depthWriteEnable = VK_FALSE;
+		variantDepth.depthCompareOp = VK_COMPARE_OP_EQUAL;
 
 		/*
 		Color blending
@@ -1041,17 +1573,15 @@ private:
 		/*
 		It is also possible to change some parts of the dynamic state of the pipeline here
 		*/
-		/*
 		VkDynamicState dynamicStates[] = {
 			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_LINE_WIDTH
+			VK_DYNAMIC_STATE_SCISSOR
 		};
 
 		VkPipelineDynamicStateCreateInfo dynamicState = {};
 		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 		dynamicState.dynamicStateCount = 2;
 		dynamicState.pDynamicStates = dynamicStates;
-		*/
 
 		/*
 		Pipeline layout for passing uniforms into shaders: required even if there are none in shaders
@@ -1060,8 +1590,9 @@ private:
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = 1;
 		pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = 0;
+		VkPushConstantRange pushConstantRange = DrawPushConstants::range();
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		if (vkCreatePipelineLayout(m_logicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("ERROR: Failed to create pipeline layout!");
@@ -1077,42 +1608,118 @@ private:
 		pipelineCreateInfo.pViewportState = &viewportState;
 		pipelineCreateInfo.pRasterizationState = &rasterizer;
 		pipelineCreateInfo.pMultisampleState = &multisampling;
+		pipelineCreateInfo.pDepthStencilState = &classifyDepth;
 		pipelineCreateInfo.pColorBlendState = &colorBlending;
+		pipelineCreateInfo.pDynamicState = &dynamicState;
 		pipelineCreateInfo.layout = m_pipelineLayout;
 		pipelineCreateInfo.renderPass = m_renderPass;
 		pipelineCreateInfo.subpass = 0;
 		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE; //Handle for derived pipeline
 		pipelineCreateInfo.basePipelineIndex = -1;
 
-		if (vkCreateGraphicsPipelines(m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+		/*
+		With classification the first pipeline only classifies pixels, the scene shader
+		runs in the variants specialized for their class. All are created with one call
+		*/
+		const size_t variantCount = classifyShaderModule != VK_NULL_HANDLE ? sizeof(ATMOSPHERE_VARIANTS) / sizeof(ATMOSPHERE_VARIANTS[0]) : 0;
+		std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(1 + variantCount, pipelineCreateInfo);
+		std::vector<VkPipelineShaderStageCreateInfo> variantStages(variantCount * 2);
+		std::vector<VkSpecializationInfo> specializations(variantCount);
+		VkSpecializationMapEntry variantEntry = { 0, 0, sizeof(uint32_t) };
+
+		//Class depths are constants 1 (empty) and 1 + ATMOSPHERE_VARIANT of each class
+		std::vector<float> classDepths(1, ATMOSPHERE_EMPTY_DEPTH);
+		std::vector<VkSpecializationMapEntry> classDepthEntries(1, { 1, 0, sizeof(float) });
+		for (size_t i = 0; i < variantCount; i++) {
+			classDepthEntries.push_back({ 1 + ATMOSPHERE_VARIANTS[i].specialization, static_cast<uint32_t>(classDepths.size() * sizeof(float)), sizeof(float) });
+			classDepths.push_back(ATMOSPHERE_VARIANTS[i].depth);
+		}
+		VkSpecializationInfo classifySpecialization = {};
+		classifySpecialization.mapEntryCount = static_cast<uint32_t>(classDepthEntries.size());
+		classifySpecialization.pMapEntries = classDepthEntries.data();
+		classifySpecialization.dataSize = classDepths.size() * sizeof(float);
+		classifySpecialization.pData = classDepths.data();
+		if (variantCount > 0) {
+			shaderStages[1].module = classifyShaderModule;
+			shaderStages[1].pSpecializationInfo = &classifySpecialization;
+		}
+		for (size_t i = 0; i < variantCount; i++) {
+			specializations[i].mapEntryCount = 1;
+			specializations[i].pMapEntries = &variantEntry;
+			specializations[i].dataSize = sizeof(uint32_t);
+			specializations[i].pData = &ATMOSPHERE_VARIANTS[i].specialization;
+
+			variantStages[i * 2] = vertShaderStageInfo;
+			variantStages[i * 2 + 1] = fragShaderStageInfo;
+			variantStages[i * 2 + 1].pSpecializationInfo = &specializations[i];
+			pipelineInfos[1 + i].pStages = &variantStages[i * 2];
+			pipelineInfos[1 + i].pDepthStencilState = &variantDepth;
+		}
+
+		std::vector<VkPipeline> pipelines(pipelineInfos.size());
+		if (vkCreateGraphicsPipelines(m_logicalDevice, VK_NULL_HANDLE, static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(), nullptr, pipelines.data()) != VK_SUCCESS) {
 			throw std::runtime_error("ERROR: Failed to create graphics pipeline!");
 		}
+		m_graphicsPipeline = pipelines[0];
+		m_variantPipelines.assign(pipelines.begin() + 1, pipelines.end());
+		m_debug.setObjectName(VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT, debugObjectHandle(m_graphicsPipeline), variantCount > 0 ? "scene classify pipeline" : "scene pipeline");
 		/*
 		Cleanup of the "bytecode wrappers"
 		*/
 		vkDestroyShaderModule(m_logicalDevice, vertShaderModule, nullptr);
 		vkDestroyShaderModule(m_logicalDevice, fragShaderModule, nullptr);
+		if (classifyShaderModule != VK_NULL_HANDLE) {
+			vkDestroyShaderModule(m_logicalDevice, classifyShaderModule, nullptr);
+		}
 	}
 
 	/*
-	Create framebuffers for all imageviews compatible with renderpass
+	Tone mapping pipelines, shared by all windows like the scene pipeline
 	*/
-	void createFramebuffers() {
-		m_swapchainFramebuffers.resize(m_swapchainImageViews.size());
+	void createToneMapper() {
+		ToneMapper::Shaders shaders;
+		shaders.histogram = createShaderModule(m_assets.load(HISTOGRAM_SHADER));
+		shaders.exposure = createShaderModule(m_assets.load(exposureShader()));
+		shaders.vertex = createShaderModule(m_assets.load(FULLSCREEN_VERTEX_SHADER));
+		shaders.fragment = createShaderModule(m_assets.load(TONEMAP_FRAGMENT_SHADER));
+
+		m_toneMapper.init(m_logicalDevice, [this](uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+			return findMemoryType(typeFilter, properties);
+		}, m_layoutCache, m_descriptorAllocator, m_surfaceFormat.format, shaders);
+
+		vkDestroyShaderModule(m_logicalDevice, shaders.histogram, nullptr);
+		vkDestroyShaderModule(m_logicalDevice, shaders.exposure, nullptr);
+		vkDestroyShaderModule(m_logicalDevice, shaders.vertex, nullptr);
+		vkDestroyShaderModule(m_logicalDevice, shaders.fragment, nullptr);
+		m_assets.release(HISTOGRAM_SHADER);
+		m_assets.release(exposureShader());
+		m_assets.release(FULLSCREEN_VERTEX_SHADER);
+		m_assets.release(TONEMAP_FRAGMENT_SHADER);
+
+		if (m_subgroupArithmetic) {
+			std::cout << "Exposure reduced with subgroup arithmetic" << std::endl;
+		}
+	}
+
+	/*
+	Create framebuffers for all imageviews compatible with tone map render pass
+	*/
+	void createFramebuffers(SurfaceContext& surface) {
+		surface.framebuffers.resize(surface.imageViews.size());
 		
-		for (size_t i = 0; i < m_swapchainImageViews.size(); i++) {
-			VkImageView attachments[]{ m_swapchainImageViews[i] };
+		for (size_t i = 0; i < surface.imageViews.size(); i++) {
+			VkImageView attachments[]{ surface.imageViews[i] };
 
 			VkFramebufferCreateInfo createInfo = {};
 			createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			createInfo.renderPass = m_renderPass;
+			createInfo.renderPass = m_toneMapper.renderPass();
 			createInfo.attachmentCount = 1;
 			createInfo.pAttachments = attachments;
-			createInfo.width = m_swapchainExtent.width;
-			createInfo.height = m_swapchainExtent.height;
+			createInfo.width = surface.extent.width;
+			createInfo.height = surface.extent.height;
 			createInfo.layers = 1;
 
-			if (vkCreateFramebuffer(m_logicalDevice, &createInfo, nullptr, &m_swapchainFramebuffers[i]) != VK_SUCCESS) {
+			if (vkCreateFramebuffer(m_logicalDevice, &createInfo, nullptr, &surface.framebuffers[i]) != VK_SUCCESS) {
 				throw std::runtime_error("ERROR: Failed to create swapchain framebuffer!");
 			}
 		}
@@ -1122,11 +1729,13 @@ private:
 	Creates command pool attached to one queue family
 	*/
 	void createCommandPool() {
-		QueueFamilyIndices queueFamilies = findQueueFamilies(m_physicalDevice);
+		const QueueFamilyIndices& queueFamilies = m_deviceCaps.queueFamilies;
 
 		VkCommandPoolCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		createInfo.queueFamilyIndex = queueFamilies.graphicsFamily;
+		//Command buffers are re-recorded every frame with new push constants
+		createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		if (vkCreateCommandPool(m_logicalDevice, &createInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
 			throw std::runtime_error("ERROR: Failed to create command pool!");
@@ -1134,10 +1743,10 @@ private:
 	}
 
 	/*
-	Creates command buffers and records commands
+	Allocates command buffer for each swapchain image, recorded by recordCommandBuffer
 	*/
-	void createCommandBuffers() {
-		m_commandBuffers.resize(m_swapchainImageViews.size());
+	void createCommandBuffers(SurfaceContext& surface) {
+		surface.commandBuffers.resize(surface.imageViews.size());
 
 		VkCommandBufferAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1147,58 +1756,237 @@ private:
 		VK_COMMAND_BUFFER_LEVEL_SECONDARY: Cannot be submitted directly, but can be called from primary command buffers.
 		*/
 		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = (uint32_t)m_commandBuffers.size();
+		allocInfo.commandBufferCount = (uint32_t)surface.commandBuffers.size();
 
-		if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
+		if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, surface.commandBuffers.data()) != VK_SUCCESS) {
 			throw std::runtime_error("ERROR: Failed to allocate command buffers!");
 		}
+	}
 
-		for (size_t i = 0; i < m_commandBuffers.size(); i++) {
-			VkCommandBufferBeginInfo beginInfo = {};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			beginInfo.pInheritanceInfo = nullptr;
-
-			vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo);
-
-			VkRenderPassBeginInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = m_renderPass;
-			renderPassInfo.framebuffer = m_swapchainFramebuffers[i];
-			//render area defines where shader loads and stores will take place, should match size of attachments
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = m_swapchainExtent;
-			
-			VkClearValue clearColor = { 0.2f, 0.3f, 0.3f, 1.0f };
-			renderPassInfo.pClearValues = &clearColor;
-			renderPassInfo.clearValueCount = 1;
-
-			/*
-			Begin recording commands
-			*/
-			vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
-			/*
-			vertexCount: Even though we don't have a vertex buffer, we technically still have 3 vertices to draw.
-			instanceCount: Used for instanced rendering, use 1 if you're not doing that.
-			firstVertex: Used as an offset into the vertex buffer, defines the lowest value of gl_VertexIndex.
-			firstInstance: Used as an offset for instanced rendering, defines the lowest value of gl_InstanceIndex.
-			*/
-			VkBuffer vertexBuffers[] = { m_vertexBuffer };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(m_commandBuffers[i], 0, 1, vertexBuffers, offsets);
-			vkCmdBindIndexBuffer(m_commandBuffers[i], m_indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-			vkCmdBindDescriptorSets(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
-
-			//vkCmdDraw(m_commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-			vkCmdDrawIndexed(m_commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-
-			vkCmdEndRenderPass(m_commandBuffers[i]);
-
-			if (vkEndCommandBuffer(m_commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("ERROR: Failed to record command buffer!");
-			}
+	/*
+	Passes of the frame in one window. Scene is rendered into a transient HDR image of the
+	swapchain extent, or its corner at lower render scales. Luminance histogram of the rendered
+	part sets the exposure and tone mapping upscales it into the swapchain image.
+	Swapchain image is imported, it starts undefined (every pixel is overwritten) once
+	the acquire semaphore released color output and leaves the graph ready for presenting.
+	Offscreen image of a headless run leaves it ready for the next copy instead.
+	Frames are captured from the first window
+	*/
+	void createRenderGraph(SurfaceContext& surface) {
+		RenderGraph& renderGraph = surface.renderGraph;
+		renderGraph.init(m_logicalDevice, [this](uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+			return findMemoryType(typeFilter, properties);
+		});
+
+		RenderResource swapchain = renderGraph.importImage("swapchain", VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		surface.swapchainResource = swapchain;
+#if VULKAN_DEBUG
+		renderGraph.setPassLabels([this](VkCommandBuffer commandBuffer, const char* name) {
+			m_debug.beginLabel(commandBuffer, name);
+		}, [this](VkCommandBuffer commandBuffer) {
+			m_debug.endLabel(commandBuffer);
+		});
+#endif
+
+		RenderResource hdr = renderGraph.createImage("hdr color", RenderImageDesc{ HDR_FORMAT, surface.extent, VK_IMAGE_ASPECT_COLOR_BIT });
+		RenderResource depth = renderGraph.createImage("scene depth", RenderImageDesc{ SCENE_DEPTH_FORMAT, surface.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+		surface.hdrResource = hdr;
+
+		SurfaceContext* context = &surface;
+		renderGraph.addPass("scene", [hdr, depth](RenderGraph::PassBuilder& pass) {
+			pass.write(hdr, RenderUsage::ColorAttachment);
+			pass.write(depth, RenderUsage::DepthAttachment);
+		}, [this, context](VkCommandBuffer commandBuffer) {
+			recordScenePass(commandBuffer, *context);
+		});
+
+		//Exposure buffer is not tracked by the graph, the tone mapper records its barriers
+		renderGraph.addPass("luminance histogram", [hdr](RenderGraph::PassBuilder& pass) {
+			pass.read(hdr, RenderUsage::ComputeSampled);
+			pass.sideEffect();
+		}, [this, context](VkCommandBuffer commandBuffer) {
+			m_toneMapper.recordHistogram(commandBuffer, context->toneMapView, context->exposure, context->renderExtent);
+		});
+
+		renderGraph.addPass("exposure", [](RenderGraph::PassBuilder& pass) {
+			pass.sideEffect();
+		}, [this, context](VkCommandBuffer commandBuffer) {
+			m_toneMapper.recordExposure(commandBuffer, context->toneMapView, context->exposure, m_clock.renderTime());
+		});
+
+		renderGraph.addPass("tone map", [hdr, swapchain](RenderGraph::PassBuilder& pass) {
+			pass.read(hdr, RenderUsage::FragmentSampled);
+			pass.write(swapchain, RenderUsage::ColorAttachment);
+		}, [this, context](VkCommandBuffer commandBuffer) {
+			m_toneMapper.recordToneMap(commandBuffer, context->toneMapView, context->exposure,
+				context->framebuffers[context->imageIndex], context->extent, context->renderExtent);
+		});
+
+		if (!m_options.capture.path.empty() && context == &m_surfaces.front()) {
+			//Graph does not know the copy may be skipped, the transitions are cheap
+			renderGraph.addPass("capture", [swapchain](RenderGraph::PassBuilder& pass) {
+				pass.read(swapchain, RenderUsage::TransferSource);
+				pass.sideEffect();
+			}, [this, context](VkCommandBuffer commandBuffer) {
+				m_readback.record(commandBuffer, context->images[context->imageIndex]);
+			});
+		}
+
+		renderGraph.setOutput(swapchain, headless() ? RenderUsage::TransferSource : RenderUsage::Present);
+		renderGraph.compile();
+
+		VkImageView hdrView = renderGraph.view(hdr);
+		VkImageView sceneAttachments[] = { hdrView, renderGraph.view(depth) };
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = m_renderPass;
+		framebufferInfo.attachmentCount = 2;
+		framebufferInfo.pAttachments = sceneAttachments;
+		framebufferInfo.width = surface.extent.width;
+		framebufferInfo.height = surface.extent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(m_logicalDevice, &framebufferInfo, nullptr, &surface.sceneFramebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create HDR framebuffer!");
+		}
+
+		//Exposure carries over swapchain recreation, the window keeps its adaptation
+		if (surface.exposure.buffer == VK_NULL_HANDLE) {
+			m_toneMapper.createExposure(surface.exposure);
+		}
+		surface.toneMapView = m_toneMapper.createView(hdrView, surface.exposure);
+	}
+
+	/*
+	Frames of the first window are captured. Readback buffers have the size of its first
+	swapchain, windows are not resizable while capturing and frames of any other size are dropped
+	*/
+	void createFrameReadback() {
+		if (m_options.capture.path.empty()) {
+			return;
+		}
+		const SurfaceContext& surface = m_surfaces.front();
+		m_readback.init(m_logicalDevice, [this](uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+			return findMemoryType(typeFilter, properties);
+		}, m_options.capture, surface.format, surface.extent);
+
+		if (m_options.capture.format == CaptureFormat::Compare && m_options.offlineFps <= 0.0) {
+			std::cout << "Warning: compared frames depend on frame timing, use --offline-fps" << std::endl;
+		}
+		std::cout << "Capturing " << surface.extent.width << "x" << surface.extent.height << " frames as "
+			<< captureFormatName(m_options.capture.format) << " to " << m_options.capture.path << std::endl;
+	}
+
+	/*
+	Records the render graph of the window into command buffer of its acquired image. Push
+	constants and the render extent are part of the recording, so it is done each frame
+	right before submitting. First and last command buffer of the frame take its timestamps
+	*/
+	void recordCommandBuffer(SurfaceContext& surface, bool beginsFrame, bool endsFrame) {
+		uint32_t i = surface.imageIndex;
+		VkCommandBuffer commandBuffer = surface.commandBuffers[i];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = nullptr;
+
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		if (beginsFrame) {
+			m_gpuTimer.begin(commandBuffer);
+		}
+
+		surface.renderExtent = m_resolution.renderExtent(surface.extent);
+		surface.renderGraph.setImage(surface.swapchainResource, surface.images[i], surface.imageViews[i]);
+		surface.renderGraph.execute(commandBuffer);
+
+		if (endsFrame) {
+			m_gpuTimer.end(commandBuffer);
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to record command buffer!");
+		}
+	}
+
+	void recordScenePass(VkCommandBuffer commandBuffer, const SurfaceContext& surface) {
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = m_renderPass;
+		renderPassInfo.framebuffer = surface.sceneFramebuffer;
+		//render area defines where shader loads and stores will take place, should match size of attachments
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = surface.renderExtent;
+		
+		VkClearValue clearValues[2] = {};
+		clearValues[0].color = { 0.2f, 0.3f, 0.3f, 1.0f };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		renderPassInfo.pClearValues = clearValues;
+		renderPassInfo.clearValueCount = 2;
+
+		/*
+		Begin recording commands
+		*/
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)surface.renderExtent.width;
+		viewport.height = (float)surface.renderExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = surface.renderExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		/*
+		vertexCount: Even though we don't have a vertex buffer, we technically still have 3 vertices to draw.
+		instanceCount: Used for instanced rendering, use 1 if you're not doing that.
+		firstVertex: Used as an offset into the vertex buffer, defines the lowest value of gl_VertexIndex.
+		firstInstance: Used as an offset for instanced rendering, defines the lowest value of gl_InstanceIndex.
+		*/
+		VkBuffer vertexBuffers[] = { m_vertexBuffer };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, static_cast<VkIndexType>(m_mesh.header().indexType));
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+		DrawPushConstants::push(commandBuffer, m_pipelineLayout, m_drawConstants);
+
+		//vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+		recordMeshletDraws(commandBuffer);
+
+		//Same draws per class, bindings stay since all pipelines share the layout
+		for (size_t i = 0; i < m_variantPipelines.size(); i++) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_variantPipelines[i]);
+			viewport.minDepth = ATMOSPHERE_VARIANTS[i].depth;
+			viewport.maxDepth = ATMOSPHERE_VARIANTS[i].depth;
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			recordMeshletDraws(commandBuffer);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	/*
+	One indirect command per meshlet, culled ones have zero index count.
+	Without multiDrawIndirect every command is a separate draw call
+	*/
+	void recordMeshletDraws(VkCommandBuffer commandBuffer) {
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		const uint32_t meshletCount = static_cast<uint32_t>(m_meshlets.size());
+
+		uint32_t maxDrawCount = m_multiDrawIndirect ? m_deviceCaps.properties.limits.maxDrawIndirectCount : 1;
+
+		for (uint32_t first = 0; first < meshletCount; first += maxDrawCount) {
+			uint32_t drawCount = std::min(maxDrawCount, meshletCount - first);
+			vkCmdDrawIndexedIndirect(commandBuffer, m_indirectBuffer, VkDeviceSize(first) * stride, drawCount, stride);
 		}
 	}
 
@@ -1206,9 +1994,11 @@ private:
 		VkSemaphoreCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		if (vkCreateSemaphore(m_logicalDevice, &createInfo, nullptr, &m_imageAvailableSemaphore) != VK_SUCCESS ||
-			vkCreateSemaphore(m_logicalDevice, &createInfo, nullptr, &m_renderFinishedSemaphore) != VK_SUCCESS) {
-			throw std::runtime_error("ERROR: Failed to create semaphores!");
+		for (SurfaceContext& surface : m_surfaces) {
+			if (vkCreateSemaphore(m_logicalDevice, &createInfo, nullptr, &surface.imageAvailableSemaphore) != VK_SUCCESS ||
+				vkCreateSemaphore(m_logicalDevice, &createInfo, nullptr, &surface.renderFinishedSemaphore) != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to create semaphores!");
+			}
 		}
 	}
 
@@ -1217,81 +2007,211 @@ private:
 		Here should be update for program state
 		updateState()
 		*/
-		vkQueueWaitIdle(m_presentQueue); //wait for presentation to finish before drawing again
-
-		uint32_t imageIndex;
-		VkResult result = vkAcquireNextImageKHR(m_logicalDevice,
-			m_swapchain,
-			std::numeric_limits<uint64_t>::max(), //disables timeout
-			m_imageAvailableSemaphore,
-			VK_NULL_HANDLE,
-			&imageIndex);
-		
-		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-			recreateSwapchain();
+		{
+			BlockedScope blocked(m_blockedMilliseconds);
+			m_timeline.wait(m_frameValue); //previous frame must finish reading data the frame graph overwrites
+		}
+		uint64_t completedValue = m_timeline.completed();
+		m_deletionQueue.collect(completedValue);
+		double gpuMilliseconds = 0.0;
+		if (m_gpuTimer.collect(completedValue, gpuMilliseconds)) {
+			m_resolution.update(gpuMilliseconds);
+			m_profiler.setCounter("gpu ms", gpuMilliseconds);
+			m_profiler.setCounter("render scale %", m_resolution.scale() * 100.0);
+		}
+		if (m_readback.enabled()) {
+			m_readback.collect(completedValue);
+			m_profiler.setCounter("captured frames", static_cast<double>(m_readback.captured()));
+			m_profiler.setCounter("dropped captures", static_cast<double>(m_readback.dropped()));
+			if (m_options.capture.frames > 0 && m_readback.captured() >= m_options.capture.frames) {
+				requestClose();
+			}
+		}
+
+		//All previous frames are done, resources they released can be reused
+		m_frameIndex++;
+		m_bindlessDescriptors.collect(m_frameIndex - 1);
+
+		{
+			Profiler::Scope scope(m_profiler, "frame graph");
+			m_frameGraph.run(m_threadPool);
+		}
+		for (TaskId task = 0; task < m_frameGraph.size(); task++) {
+			m_profiler.addTime(m_frameGraph.name(task), m_frameGraph.milliseconds(task));
+		}
+		const VisibilityStats& visibilityStats = m_visibility.stats();
+		m_profiler.addTime("cull", visibilityStats.cullMilliseconds);
+		m_profiler.addTime("sort", visibilityStats.sortMilliseconds);
+		m_profiler.setCounter("visible objects", visibilityStats.visible);
+		m_profiler.setCounter("culled objects", visibilityStats.culled);
+		m_profiler.setCounter("visible meshlets", m_visibleMeshlets);
+		RenderGraphStats graphStats;
+		for (const SurfaceContext& surface : m_surfaces) {
+			const RenderGraphStats& stats = surface.renderGraph.stats();
+			graphStats.passes += stats.passes;
+			graphStats.barriers += stats.barriers;
+			graphStats.transientBytes += stats.transientBytes;
+		}
+		m_profiler.setCounter("render passes", graphStats.passes);
+		m_profiler.setCounter("barriers", graphStats.barriers);
+		m_profiler.setCounter("transient KB", graphStats.transientBytes / 1024.0);
+		m_profiler.setCounter("deferred deletes", static_cast<double>(m_deletionQueue.size()));
+		if (enableValidationLayers) {
+			m_profiler.setCounter("validation errors", static_cast<double>(m_debug.errors()));
+			m_profiler.setCounter("validation warnings", static_cast<double>(m_debug.warnings()));
+			m_profiler.setCounter("performance warnings", static_cast<double>(m_debug.performanceWarnings()));
+		}
+
+		//Windows whose swapchain is out of date are recreated and skip the frame
+		size_t acquiredCount = 0;
+		for (SurfaceContext& surface : m_surfaces) {
+			if (headless()) {
+				surface.imageIndex = 0;
+				surface.acquired = true;
+				acquiredCount++;
+				continue;
+			}
+			VkResult result;
+			{
+				BlockedScope blocked(m_blockedMilliseconds);
+				result = vkAcquireNextImageKHR(m_logicalDevice,
+					surface.swapchain,
+					std::numeric_limits<uint64_t>::max(), //disables timeout
+					surface.imageAvailableSemaphore,
+					VK_NULL_HANDLE,
+					&surface.imageIndex);
+			}
+
+			surface.acquired = result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR;
+			if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+				recreateSwapchain(surface);
+			}
+			else if (!surface.acquired) {
+				throw std::runtime_error("Failed to acquire swap chain image!");
+			}
+			acquiredCount += surface.acquired ? 1 : 0;
+		}
+
+		if (acquiredCount == 0) {
 			return;
 		}
-		else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-			throw std::runtime_error("Failed to acquire swap chain image!");
+
+		{
+			Profiler::Scope scope(m_profiler, "record");
+			bool captured = m_readback.enabled() && m_surfaces.front().acquired && m_readback.beginFrame(m_surfaces.front().extent);
+			//Offline captures hold time on a dropped frame, the video then has every frame
+			if (!m_clock.offline() || !m_readback.enabled() || captured) {
+				m_profiler.setCounter("simulation steps", m_clock.tick());
+			}
+			updateDrawConstants();
+			//Timestamps enclose command buffers of all windows
+			size_t recorded = 0;
+			for (SurfaceContext& surface : m_surfaces) {
+				if (surface.acquired) {
+					recorded++;
+					recordCommandBuffer(surface, recorded == 1, recorded == acquiredCount);
+				}
+			}
 		}
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
 		/*
+		All windows are rendered by one submission and presented by one call.
 		We want to wait with writing colors into framebuffer until it's ready
 		Theoretically we can start executing vertex stage and such before imag is available
 		*/
-		VkSemaphore waitSemaphore[] = { m_imageAvailableSemaphore };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphore;
-		submitInfo.pWaitDstStageMask = waitStages;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &m_commandBuffers[imageIndex];
-
-		VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphore };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<VkPipelineStageFlags> waitStages;
+		std::vector<VkCommandBuffer> commandBuffers;
+		std::vector<VkSemaphore> signalSemaphores;
+		std::vector<VkSwapchainKHR> swapchains;
+		std::vector<uint32_t> imageIndices;
+		std::vector<SurfaceContext*> presented;
+		for (SurfaceContext& surface : m_surfaces) {
+			if (surface.acquired && headless()) {
+				commandBuffers.push_back(surface.commandBuffers[surface.imageIndex]);
+			}
+			else if (surface.acquired) {
+				waitSemaphores.push_back(surface.imageAvailableSemaphore);
+				waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+				commandBuffers.push_back(surface.commandBuffers[surface.imageIndex]);
+				signalSemaphores.push_back(surface.renderFinishedSemaphore);
+				swapchains.push_back(surface.swapchain);
+				imageIndices.push_back(surface.imageIndex);
+				presented.push_back(&surface);
+			}
+		}
 
-		if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
-			throw std::runtime_error("ERROR: Failed to submit draw command buffer!");
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		submitInfo.pCommandBuffers = commandBuffers.data();
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+		m_frameValue = m_timeline.submit(m_graphicsQueue, submitInfo);
+		m_readback.submitted(m_frameValue);
+		m_gpuTimer.submitted(m_frameValue);
+		if (headless()) {
+			return;
+		}
+		for (SurfaceContext* surface : presented) {
+			releaseRetiredSwapchains(*surface, m_frameValue);
 		}
 
+		//Each swapchain reports its own result, one out of date window does not stop the others
+		std::vector<VkResult> results(presented.size(), VK_SUCCESS);
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores;
-
-		VkSwapchainKHR swapchains[] = { m_swapchain };
-		presentInfo.swapchainCount = 1;
-		presentInfo.pSwapchains = swapchains;
-		presentInfo.pImageIndices = &imageIndex;
-
-		result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
-
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-			recreateSwapchain();
+		presentInfo.waitSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		presentInfo.pWaitSemaphores = signalSemaphores.data();
+		presentInfo.swapchainCount = static_cast<uint32_t>(swapchains.size());
+		presentInfo.pSwapchains = swapchains.data();
+		presentInfo.pImageIndices = imageIndices.data();
+		presentInfo.pResults = results.data();
+
+		VkResult result;
+		{
+			BlockedScope blocked(m_blockedMilliseconds);
+			result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
 		}
-		else if (result != VK_SUCCESS) {
+		reportPresentLatency();
+
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
 			throw std::runtime_error("ERROR: Failed to present swap chain image!");
 		}
+		for (size_t i = 0; i < presented.size(); i++) {
+			if (results[i] == VK_ERROR_OUT_OF_DATE_KHR || results[i] == VK_SUBOPTIMAL_KHR) {
+				recreateSwapchain(*presented[i]);
+			}
+			else if (results[i] != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to present swap chain image!");
+			}
+		}
 	}
 
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
-
-		/*
-		If there is a memory type suitable for the buffer that also has
-		all of the properties we need, then we return its index
-		*/
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
+	/*
+	Input to present: from polling events to the frame being queued for presentation.
+	Display adds the images queued before it (at most image count - 1 refreshes with FIFO)
+	*/
+	void reportPresentLatency() {
+		auto presentEnd = std::chrono::high_resolution_clock::now();
+		double latency = std::chrono::duration<double, std::milli>(presentEnd - m_frameStart).count();
+		m_maxLatency = std::max(m_maxLatency, latency);
+		m_frameLimiter.presented(latency - m_blockedMilliseconds, presentEnd);
+
+		m_profiler.addTime("input to present", latency);
+		m_profiler.addTime("blocked", m_blockedMilliseconds);
+		m_profiler.setCounter("max input to present ms", m_maxLatency);
+		if (m_frameLimiter.enabled()) {
+			m_profiler.setCounter("vblank us", m_frameLimiter.vblankMilliseconds() * 1000.0);
 		}
+	}
 
-		throw std::runtime_error("failed to find suitable memory type!");
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		return m_deviceCaps.findMemoryType(typeFilter, properties);
 	}
 
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
@@ -1323,9 +2243,12 @@ private:
 		vkBindBufferMemory(m_logicalDevice, buffer, bufferMemory, 0); //0 - offset in memory
 	}
 
-	void createVertexBuffer() {
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
+	/*
+	Creates device local buffer and fills it through a staging buffer.
+	fillData writes directly into the mapped staging memory, so mesh
+	data are streamed from disk without any intermediate copy
+	*/
+	void createDeviceLocalBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const std::function<void(void*)>& fillData) {
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingBufferMemory;
 		createBuffer(
@@ -1335,18 +2258,17 @@ private:
 			stagingBuffer,
 			stagingBufferMemory);
 
-		//Copy vertex data into buffer
 		void* data;
 		vkMapMemory(m_logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), (size_t)bufferSize);
+		fillData(data);
 		vkUnmapMemory(m_logicalDevice, stagingBufferMemory);
 
 		createBuffer(
 			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			m_vertexBuffer,
-			m_vertexBufferMemory);
+			buffer,
+			bufferMemory);
 		/*
 		It may happen that memory might not be copied when unmapping memory region -> solutions:
 			Use a memory heap that is host coherent, indicated with VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
@@ -1354,77 +2276,146 @@ private:
 			and call vkInvalidateMappedMemoryRanges before reading from the mapped memory
 		*/
 
-		copyBufferData(stagingBuffer, m_vertexBuffer, bufferSize);
+		uint64_t copyValue = copyBufferData(stagingBuffer, buffer, bufferSize);
 
-		vkDestroyBuffer(m_logicalDevice, stagingBuffer, nullptr);
-		vkFreeMemory(m_logicalDevice, stagingBufferMemory, nullptr);
+		m_deletionQueue.destroyBuffer(stagingBuffer, copyValue);
+		m_deletionQueue.freeMemory(stagingBufferMemory, copyValue);
+	}
+
+	void createVertexBuffer() {
+		createDeviceLocalBuffer(
+			m_mesh.sectionSize(MESH_SECTION_VERTICES),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			m_vertexBuffer,
+			m_vertexBufferMemory,
+			[this](void* data) { m_mesh.readSection(MESH_SECTION_VERTICES, data); });
+		m_debug.setObjectName(VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, debugObjectHandle(m_vertexBuffer), "vertex buffer");
 	}
 
 	void createIndexBuffer() {
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+		createDeviceLocalBuffer(
+			m_mesh.sectionSize(MESH_SECTION_INDICES),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			m_indexBuffer,
+			m_indexBufferMemory,
+			[this](void* data) { m_mesh.readSection(MESH_SECTION_INDICES, data); });
+		m_debug.setObjectName(VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, debugObjectHandle(m_indexBuffer), "index buffer");
+	}
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
+	/*
+	Indirect commands are rewritten by the CPU every frame,
+	so the buffer stays host visible and persistently mapped
+	*/
+	void createIndirectBuffer() {
+		VkDeviceSize bufferSize = m_meshlets.size() * sizeof(VkDrawIndexedIndirectCommand);
 		createBuffer(
 			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer,
-			stagingBufferMemory
-		);
+			m_indirectBuffer,
+			m_indirectBufferMemory);
+		m_debug.setObjectName(VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, debugObjectHandle(m_indirectBuffer), "indirect buffer");
 
 		void* data;
-		vkMapMemory(m_logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), (size_t)bufferSize);
-		vkUnmapMemory(m_logicalDevice, stagingBufferMemory);
+		vkMapMemory(m_logicalDevice, m_indirectBufferMemory, 0, bufferSize, 0, &data);
+		m_drawCommands = static_cast<VkDrawIndexedIndirectCommand*>(data);
+		updateDrawCommands();
+	}
 
+	/*
+	Culls meshlets of the mesh node if it survived object culling. Vertex shaders output
+	world space positions as they are, so the view is clip space itself: orthographic
+	camera looking down +z and clockwise front faces. Culling happens in mesh space.
+	First instance of the commands selects the node's world matrix in the object buffer.
+	Non-zero first instance needs drawIndirectFirstInstance, without it commands start
+	at instance 0 and the object index is pushed as objectBase
+	*/
+	void updateDrawCommands() {
+		const uint32_t object = m_scene.index(m_meshNode);
+		const uint32_t firstInstance = m_drawIndirectFirstInstance ? object : 0;
+		m_drawConstants.objectBase = object - firstInstance;
+		const std::vector<DrawItem>& draws = m_visibility.draws();
+		bool visible = std::any_of(draws.begin(), draws.end(), [object](const DrawItem& draw) { return draw.object == object; });
+		if (!visible) {
+			memset(m_drawCommands, 0, m_meshlets.size() * sizeof(VkDrawIndexedIndirectCommand));
+			m_visibleMeshlets = 0;
+			return;
+		}
+
+		const glm::mat4& world = m_scene.worldMatrix(m_meshNode);
+		glm::vec4 viewDirection = glm::inverse(world) * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		MeshletCullView view = makeMeshletCullView(world, viewDirection, true);
+		m_visibleMeshlets = cullMeshlets(m_meshlets, view, firstInstance, m_drawCommands);
+	}
+
+	/*
+	World matrices of all scene nodes, written by Scene::update every frame
+	*/
+	void createObjectBuffer() {
+		VkDeviceSize bufferSize = m_scene.size() * sizeof(glm::mat4);
 		createBuffer(
 			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			m_indexBuffer,
-			m_indexBufferMemory
-		);
-
-		copyBufferData(stagingBuffer, m_indexBuffer, bufferSize);
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_objectBuffer,
+			m_objectBufferMemory);
 
-		vkDestroyBuffer(m_logicalDevice, stagingBuffer, nullptr);
-		vkFreeMemory(m_logicalDevice, stagingBufferMemory, nullptr);
+		void* data;
+		vkMapMemory(m_logicalDevice, m_objectBufferMemory, 0, bufferSize, 0, &data);
+		m_objectData = static_cast<glm::mat4*>(data);
+		m_scene.update(m_threadPool, m_objectData);
 	}
 
 	void createUniformBuffer() {
 		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 		createBuffer(
 			bufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, //bindless reads it as a storage buffer
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			m_uniformBuffer,
 			m_uniformBufferMemory);
+		//Matrices are constant, values changing every frame are push constants
+		updateUniformData();
 	}
 
-	void copyBufferData(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-		//You can create separate command pool for these buffers -> may apply memory optimization
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = m_commandPool;
-		allocInfo.commandBufferCount = 1;
-
+	/*
+	Submits the copy and returns its timeline value without waiting. Barrier after the copy
+	makes the data visible to all later submissions on the queue, frames included
+	*/
+	uint64_t copyBufferData(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
 		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, &commandBuffer);
+		{
+			//Command pool needs external synchronization, uploads may run on several threads
+			std::lock_guard<std::mutex> lock(m_uploadMutex);
 
-		//Start recording command buffer
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			//You can create separate command pool for these buffers -> may apply memory optimization
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = m_commandPool;
+			allocInfo.commandBufferCount = 1;
 
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
-			VkBufferCopy copyRegion = {};
-			copyRegion.srcOffset = 0; //optional
-			copyRegion.dstOffset = 0; //optional
-			copyRegion.size = size;
-			vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-		vkEndCommandBuffer(commandBuffer);
+			vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, &commandBuffer);
+
+			//Start recording command buffer
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+				VkBufferCopy copyRegion = {};
+				copyRegion.srcOffset = 0; //optional
+				copyRegion.dstOffset = 0; //optional
+				copyRegion.size = size;
+				vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+				VkMemoryBarrier barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			vkEndCommandBuffer(commandBuffer);
+		}
 
 		//Submit command
 		VkSubmitInfo submitInfo = {};
@@ -1432,26 +2423,20 @@ private:
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(m_graphicsQueue); 
-		/*
-		here we wait for queue to be idle, it is possible to wait for
-		fences, which could be used for multiple transfer simultaneously
-		*/
-		vkFreeCommandBuffers(m_logicalDevice, m_commandPool, 1, &commandBuffer);
+		uint64_t value = m_timeline.submit(m_graphicsQueue, submitInfo);
+
+		m_deletionQueue.push(value, [this, commandBuffer]() {
+			std::lock_guard<std::mutex> lock(m_uploadMutex);
+			vkFreeCommandBuffers(m_logicalDevice, m_commandPool, 1, &commandBuffer);
+		});
+		return value;
 	}
  
 	void updateUniformData() {
-		static auto timeStart = std::chrono::high_resolution_clock::now();
-
-		auto timeCurrent = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(timeCurrent - timeStart).count();
-
 		UniformBufferObject ubo = {};
 		//ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 		//ubo.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
 		//ubo.projection = glm::perspective(glm::radians(90.0f), m_swapchainExtent.width / (float) m_swapchainExtent.height, 0.1f, 1000.0f);
-		ubo.time = time;
 
 		void* data;
 		vkMapMemory(m_logicalDevice, m_uniformBufferMemory, 0, sizeof(ubo), 0, &data);
@@ -1460,58 +2445,41 @@ private:
 	}
 
 	/*
-	Descriptor sets must be created, like command buffers, from Descriptor pools
+	Shaders animate on render time, which is reproducible with an offline clock
 	*/
-	void createDescriptorPool() {
-		/*
-		First specify descriptor types which descriptor set will contain
-		*/
-		VkDescriptorPoolSize poolSize = {};
-		poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSize.descriptorCount = 1;
-
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = 1;
-		poolInfo.pPoolSizes = &poolSize;
-		poolInfo.maxSets = 1;
-
-		if (vkCreateDescriptorPool(m_logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
-			throw std::runtime_error("ERROR: Failed to create descriptor set pool!");
-		}
+	void updateDrawConstants() {
+		m_drawConstants.time = static_cast<float>(m_clock.renderTime());
 	}
 
+	/*
+	Descriptor sets come from the growable allocator and are written
+	in one call from ObjectDescriptors through the update template.
+	In bindless mode buffers just take slots in the global set
+	*/
 	void createDescriptorSet() {
-		VkDescriptorSetLayout layouts[] = {m_descriptorSetLayout};
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = m_descriptorPool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = layouts;
-
-		//No need for cleanup, freed with descriptor pool
-		if (vkAllocateDescriptorSets(m_logicalDevice, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
-			throw std::runtime_error("ERROR: Failed to allocate descriptor set!");
+		if (m_bindless) {
+			m_drawConstants.uniformSlot = m_bindlessDescriptors.addBuffer(m_uniformBuffer, 0, sizeof(UniformBufferObject));
+			m_drawConstants.objectSlot = m_bindlessDescriptors.addBuffer(m_objectBuffer);
+			m_descriptorSet = m_bindlessDescriptors.set();
+			return;
 		}
 
-		/*
-		Descriptor set is now allocated but descriptors within still need to be configured
-		*/
-		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = m_uniformBuffer;
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
-
-		VkWriteDescriptorSet descriptorWrite = {};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = m_descriptorSet;
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite.descriptorCount = 1; //How many and what types of array elements to update
-		descriptorWrite.pBufferInfo = &bufferInfo;
+		m_descriptorSet = m_descriptorAllocator.allocate(m_descriptorSetLayout);
 
-		vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+		std::vector<VkDescriptorUpdateTemplateEntryKHR> entries = {
+			makeDescriptorEntry(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, offsetof(ObjectDescriptors, uniforms)),
+			makeDescriptorEntry(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(ObjectDescriptors, objects))
+		};
+		m_descriptorUpdater.init(m_logicalDevice, m_descriptorSetLayout, entries, m_descriptorUpdateTemplates);
+
+		ObjectDescriptors descriptors = {};
+		descriptors.uniforms.buffer = m_uniformBuffer;
+		descriptors.uniforms.offset = 0;
+		descriptors.uniforms.range = sizeof(UniformBufferObject);
+		descriptors.objects.buffer = m_objectBuffer;
+		descriptors.objects.offset = 0;
+		descriptors.objects.range = VK_WHOLE_SIZE;
+		m_descriptorUpdater.update(m_descriptorSet, &descriptors);
 	}
 
 /*
@@ -1519,42 +2487,136 @@ Members
 */
 public:
 private:
-	GLFWwindow*						m_window;
+	/*
+	Adds time spent waiting on the GPU or swapchain, which is not frame work
+	*/
+	class BlockedScope {
+	public:
+		explicit BlockedScope(double& milliseconds)
+			: m_milliseconds(milliseconds), m_start(std::chrono::high_resolution_clock::now()) {
+		}
+
+		~BlockedScope() {
+			auto end = std::chrono::high_resolution_clock::now();
+			m_milliseconds += std::chrono::duration<double, std::milli>(end - m_start).count();
+		}
+
+	private:
+		double& m_milliseconds;
+		std::chrono::high_resolution_clock::time_point m_start;
+	};
+
+	AppOptions						m_options;
+	AssetLoader						m_assets;
+	MeshFile						m_mesh;
+	std::string						m_builtinMesh;
+	std::vector<SurfaceContext>		m_surfaces; //first window is the one frames are captured from
+	bool							m_closeRequested = false; //headless runs have no window to close
+	VkSurfaceFormatKHR				m_surfaceFormat = {};
 	VkInstance						m_instance;
-	VkSurfaceKHR					m_surface;
-	VkDebugReportCallbackEXT		m_debugCallback;
+	const char*						m_validationLayer = nullptr;
+	DebugMessenger					m_debug;
 	VkPhysicalDevice				m_physicalDevice = VK_NULL_HANDLE; //Destroyed when instance is destroyed
+	DeviceCapabilities				m_deviceCaps;
 	VkDevice						m_logicalDevice;
 	VkQueue							m_graphicsQueue;
 	VkQueue							m_presentQueue;
-	VkSwapchainKHR					m_swapchain;
-	std::vector<VkImage>			m_swapchainImages;
-	VkFormat						m_swapchainImageFormat;
-	VkExtent2D						m_swapchainExtent;
-	std::vector<VkImageView>		m_swapchainImageViews;
 	VkRenderPass					m_renderPass;
 	VkDescriptorSetLayout			m_descriptorSetLayout;
-	VkDescriptorPool				m_descriptorPool;
 	VkDescriptorSet					m_descriptorSet;
+	DescriptorLayoutCache			m_layoutCache;
+	DescriptorAllocator				m_descriptorAllocator;
+	DescriptorUpdater				m_descriptorUpdater;
+	bool							m_descriptorUpdateTemplates = false;
+	bool							m_physicalDeviceProperties2 = false;
+	bool							m_bindless = false;
+	BindlessDescriptors				m_bindlessDescriptors;
+	DrawConstants					m_drawConstants = { 0, 0, 0.0f, 1.0f, 0 };
+	uint64_t						m_frameIndex = 0;
 	VkPipelineLayout				m_pipelineLayout;
-	VkPipeline						m_graphicsPipeline;
-	std::vector<VkFramebuffer>		m_swapchainFramebuffers;
+	VkPipeline						m_graphicsPipeline; //classifies pixels when there are variants
+	std::vector<VkPipeline>			m_variantPipelines; //one per ATMOSPHERE_VARIANTS entry
 	VkCommandPool					m_commandPool;
 	VkBuffer						m_vertexBuffer;
 	VkDeviceMemory					m_vertexBufferMemory;
 	VkBuffer						m_indexBuffer;
 	VkDeviceMemory					m_indexBufferMemory;
+	std::mutex						m_uploadMutex;
+	GpuTimeline						m_timeline;
+	DeletionQueue					m_deletionQueue;
+	uint64_t						m_frameValue = 0; //timeline value of the last frame submission
+	FrameReadback					m_readback;
+	VkBuffer						m_indirectBuffer;
+	VkDeviceMemory					m_indirectBufferMemory;
+	VkDrawIndexedIndirectCommand*	m_drawCommands = nullptr;
+	MeshletSet						m_meshlets;
+	uint32_t						m_visibleMeshlets = 0;
+	bool							m_multiDrawIndirect = false;
+	bool							m_drawIndirectFirstInstance = false;
+	uint32_t						m_apiVersion = VK_API_VERSION_1_0;
+	bool							m_subgroupArithmetic = false;
+	ToneMapper						m_toneMapper;
+	GpuFrameTimer					m_gpuTimer;
+	ResolutionController			m_resolution;
+	ThreadPool						m_threadPool;
+	Scene							m_scene;
+	SceneNode						m_meshNode = 0;
+	VisibilityStage					m_visibility;
+	TaskGraph						m_frameGraph;
+	Profiler						m_profiler;
+	FrameLimiter					m_frameLimiter;
+	SimulationClock					m_clock;
+	std::chrono::high_resolution_clock::time_point	m_frameStart;
+	double							m_blockedMilliseconds = 0.0;
+	double							m_maxLatency = 0.0;
+	VkBuffer						m_objectBuffer;
+	VkDeviceMemory					m_objectBufferMemory;
+	glm::mat4*						m_objectData = nullptr;
 	VkBuffer						m_uniformBuffer;
 	VkDeviceMemory					m_uniformBufferMemory;
-	std::vector<VkCommandBuffer>	m_commandBuffers;
-	VkSemaphore						m_imageAvailableSemaphore;
-	VkSemaphore						m_renderFinishedSemaphore;
 };
 
 
+/*
+Usage:
+	"Vulkan Triangle" [--present <low-latency|power-saving|bounded-latency>] [--fps-limit <fps>] [--sim-rate <steps>] [--offline-fps <fps>]
+		[--capture <path> [--capture-format <png|yuv|ffmpeg|compare>] [--capture-fps <fps>] [--capture-frames <count>] [--capture-buffers <count>]]
+		[--compare-threshold <distance>] [--compare-fraction <fraction>] [--device <name>] [--windows <count> | --headless <width>x<height>]
+		[--gpu-budget <ms> [--min-render-scale <scale>] [--max-render-scale <scale>]] : runs the application
+	"Vulkan Triangle" --pack <archive> <files...> : packs files into an asset archive
+	"Vulkan Triangle" --convert-mesh [--standard] [--no-optimize] <input.obj> <output.vmesh> [...] : converts meshes into binary format
+	"Vulkan Triangle" --bench-mesh <mesh.vmesh> [iterations] : measures mesh load times
+	"Vulkan Triangle" --bench-scene [nodes] [iterations] : measures scene transform update
+	"Vulkan Triangle" --golden-suite <suite file> [jobs] : runs golden image cases in parallel
+*/
 int main(int argc, char* argv[]) {
-	HelloTriangleApplication app;
+	if (argc > 1 && argv[1][0] == '-') {
+		const std::string tool = argv[1];
+		try {
+			if (tool == "--pack") {
+				return packAssetsTool(argc, argv);
+			}
+			else if (tool == "--convert-mesh") {
+				return convertMeshTool(argc, argv);
+			}
+			else if (tool == "--bench-mesh") {
+				return benchmarkMeshTool(argc, argv);
+			}
+			else if (tool == "--bench-scene") {
+				return benchmarkSceneTool(argc, argv);
+			}
+			else if (tool == "--golden-suite") {
+				return goldenSuiteTool(argc, argv);
+			}
+		}
+		catch (const std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
 	try {
+		HelloTriangleApplication app(parseAppOptions(argc, argv));
 		app.run();
 	}
 	catch (const std::runtime_error& e) {
@@ -9,49 +9,13 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <chrono>
+
+/*
+Authoring vertex, packed into GPU layout from vertex_layout.hpp on import
+*/
 struct Vertex {
 	glm::vec2 position;
 	glm::vec3 color;
-
-	/*
-	Returns description of at which rate to load data from memory throughout the vertices
-	*/
-	static VkVertexInputBindingDescription getBindingDescription() {
-		VkVertexInputBindingDescription bindingDescription = {};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX; //Move to next data after each VERTEX, can be INSTANCE
-
-		return bindingDescription;
-	}
-
-	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = {};
-		/*
-		Format types:	
-			float: VK_FORMAT_R32_SFLOAT
-			vec2: VK_FORMAT_R32G32_SFLOAT
-			vec3: VK_FORMAT_R32G32B32_SFLOAT
-			vec4: VK_FORMAT_R32G32B32A32_SFLOAT
-
-			ivec2: VK_FORMAT_R32G32_SINT, a 2-component vector of 32-bit signed integers
-			uvec4: VK_FORMAT_R32G32B32A32_UINT, a 4-component vector of 32-bit unsigned integers
-			double: VK_FORMAT_R64_SFLOAT, a double-precision (64-bit) float
-		*/
-		//Position attribute description
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, position);
-
-		//Color attribute description
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		return attributeDescriptions;
-	}
 };
 
 const std::vector<Vertex> vertices = {
@@ -75,5 +39,26 @@ struct UniformBufferObject {
 	glm::mat4 model;
 	glm::mat4 view;
 	glm::mat4 projection;
-	float time;
-};
\ No newline at end of file
+};
+
+/*
+Extracts frustum planes from view projection matrix (Gribb & Hartmann).
+Planes are normalized and point inside, depth range is Vulkan's [0, 1].
+Order: left, right, top, bottom, near, far
+*/
+inline void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (int i = 0; i < 6; i++) {
+		planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+	}
+}
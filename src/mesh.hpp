@@ -0,0 +1,277 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+
+#include "assets.hpp"
+
+/*
+Binary mesh file layout (.vmesh):
+	MeshFileHeader : counts, vertex layout descriptor and section table
+	sections       : raw vertex, index and optional meshlet blocks, each aligned to MESH_SECTION_ALIGNMENT
+Blocks are stored exactly as the GPU consumes them, so loading is just
+streaming the bytes into the staging buffer
+*/
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_MAX_ATTRIBUTES = 8;
+const uint32_t MESH_MAX_SECTIONS = 8;
+const uint32_t MESH_SECTION_ALIGNMENT = 64;
+const size_t MESH_STREAM_CHUNK_SIZE = 1 << 20;
+
+enum MeshSectionType : uint32_t {
+	MESH_SECTION_NONE = 0,
+	MESH_SECTION_VERTICES = 1,
+	MESH_SECTION_INDICES = 2,
+	MESH_SECTION_MESHLETS = 3 //MeshletSet streams, see meshlet.hpp
+};
+
+struct MeshAttribute {
+	uint32_t location;
+	uint32_t format; //VkFormat
+	uint32_t offset;
+	uint32_t reserved;
+};
+
+struct MeshSection {
+	uint32_t type; //MeshSectionType
+	uint32_t reserved;
+	uint64_t offset; //from the start of the file
+	uint64_t size;
+};
+
+struct MeshFileHeader {
+	char magic[4]; //"VTMS"
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t vertexStride;
+	uint32_t indexType; //VkIndexType
+	uint32_t attributeCount;
+	uint32_t sectionCount;
+	MeshAttribute attributes[MESH_MAX_ATTRIBUTES];
+	MeshSection sections[MESH_MAX_SECTIONS];
+
+	uint32_t indexSize() const {
+		return indexType == VK_INDEX_TYPE_UINT32 ? 4 : 2;
+	}
+
+	const MeshSection* findSection(MeshSectionType type) const {
+		for (uint32_t i = 0; i < sectionCount; i++) {
+			if (sections[i].type == type) {
+				return &sections[i];
+			}
+		}
+		return nullptr;
+	}
+
+	/*
+	Vertex input state is described by the file itself,
+	so pipeline always matches the data it is fed with
+	*/
+	VkVertexInputBindingDescription getBindingDescription() const {
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = vertexStride;
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const {
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(attributeCount);
+		for (uint32_t i = 0; i < attributeCount; i++) {
+			attributeDescriptions[i].binding = 0;
+			attributeDescriptions[i].location = attributes[i].location;
+			attributeDescriptions[i].format = static_cast<VkFormat>(attributes[i].format);
+			attributeDescriptions[i].offset = attributes[i].offset;
+		}
+
+		return attributeDescriptions;
+	}
+};
+
+static_assert(sizeof(MeshFileHeader) == 32 + MESH_MAX_ATTRIBUTES * sizeof(MeshAttribute) + MESH_MAX_SECTIONS * sizeof(MeshSection),
+	"MeshFileHeader must stay tightly packed");
+
+/*
+Reads mesh header up front and streams sections on request.
+Source is either a file on disk, read in chunks without intermediate
+buffers, or a mapped asset from which sections are copied directly
+*/
+class MeshFile {
+public:
+	void open(const std::string& filename) {
+		m_memory = AssetView();
+		m_file.close();
+		m_file.clear();
+		//Data goes straight into caller memory, stream buffering would be just another copy
+		m_file.rdbuf()->pubsetbuf(nullptr, 0);
+		m_file.open(filename, std::ios::binary);
+		if (!m_file.is_open()) {
+			throw std::runtime_error("ERROR: Failed to open mesh " + filename + "!");
+		}
+		m_file.seekg(0, std::ios::end);
+		m_fileSize = static_cast<uint64_t>(m_file.tellg());
+		m_file.seekg(0);
+
+		if (!m_file.read(reinterpret_cast<char*>(&m_header), sizeof(m_header))) {
+			throw std::runtime_error("ERROR: Mesh " + filename + " is truncated!");
+		}
+		validate(filename);
+	}
+
+	void open(const AssetView& memory, const std::string& name) {
+		m_file.close();
+		m_memory = memory;
+		m_fileSize = memory.size;
+
+		if (memory.size < sizeof(m_header)) {
+			throw std::runtime_error("ERROR: Mesh " + name + " is truncated!");
+		}
+		memcpy(&m_header, memory.data, sizeof(m_header));
+		validate(name);
+	}
+
+	const MeshFileHeader& header() const {
+		return m_header;
+	}
+
+	VkDeviceSize sectionSize(MeshSectionType type) const {
+		const MeshSection* section = m_header.findSection(type);
+		return section ? section->size : 0;
+	}
+
+	/*
+	Copies whole section into dst, which is expected to be
+	at least sectionSize(type) big (eg. mapped staging memory)
+	*/
+	void readSection(MeshSectionType type, void* dst) {
+		const MeshSection* section = m_header.findSection(type);
+		if (!section) {
+			throw std::runtime_error("ERROR: Mesh is missing requested section!");
+		}
+
+		if (!m_memory.empty()) {
+			memcpy(dst, m_memory.data + section->offset, static_cast<size_t>(section->size));
+			return;
+		}
+
+		//Sections may be streamed by concurrent upload tasks, the stream has one position
+		std::lock_guard<std::mutex> lock(m_fileMutex);
+		char* out = static_cast<char*>(dst);
+		uint64_t remaining = section->size;
+		m_file.seekg(static_cast<std::streamoff>(section->offset));
+		while (remaining > 0) {
+			size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, MESH_STREAM_CHUNK_SIZE));
+			if (!m_file.read(out, static_cast<std::streamsize>(chunk))) {
+				throw std::runtime_error("ERROR: Failed to read mesh section!");
+			}
+			out += chunk;
+			remaining -= chunk;
+		}
+	}
+
+private:
+	void validate(const std::string& name) const {
+		if (memcmp(m_header.magic, "VTMS", 4) != 0) {
+			throw std::runtime_error("ERROR: " + name + " is not a mesh file!");
+		}
+		if (m_header.version != MESH_FILE_VERSION) {
+			throw std::runtime_error("ERROR: Mesh " + name + " has unsupported version!");
+		}
+		if (m_header.attributeCount > MESH_MAX_ATTRIBUTES || m_header.sectionCount > MESH_MAX_SECTIONS) {
+			throw std::runtime_error("ERROR: Mesh " + name + " has corrupted header!");
+		}
+		for (uint32_t i = 0; i < m_header.sectionCount; i++) {
+			if (m_header.sections[i].offset + m_header.sections[i].size > m_fileSize) {
+				throw std::runtime_error("ERROR: Mesh " + name + " is truncated!");
+			}
+		}
+
+		const MeshSection* vertexSection = m_header.findSection(MESH_SECTION_VERTICES);
+		const MeshSection* indexSection = m_header.findSection(MESH_SECTION_INDICES);
+		if (!vertexSection || vertexSection->size != uint64_t(m_header.vertexCount) * m_header.vertexStride ||
+			!indexSection || indexSection->size != uint64_t(m_header.indexCount) * m_header.indexSize()) {
+			throw std::runtime_error("ERROR: Mesh " + name + " has inconsistent sections!");
+		}
+	}
+
+	MeshFileHeader	m_header = {};
+	std::ifstream	m_file;
+	std::mutex		m_fileMutex;
+	AssetView		m_memory;
+	uint64_t		m_fileSize = 0;
+};
+
+/*
+CPU side description of mesh data in its final GPU layout, input for the writer
+*/
+struct MeshData {
+	std::vector<MeshAttribute> attributes;
+	uint32_t vertexStride = 0;
+	uint32_t vertexCount = 0;
+	std::vector<char> vertexData;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+	uint32_t indexCount = 0;
+	std::vector<char> indexData;
+	std::vector<char> meshletData; //Optional, serialized MeshletSet
+};
+
+inline uint64_t alignMeshOffset(uint64_t offset) {
+	return (offset + MESH_SECTION_ALIGNMENT - 1) & ~static_cast<uint64_t>(MESH_SECTION_ALIGNMENT - 1);
+}
+
+inline void writeMeshFile(std::ostream& out, const MeshData& mesh) {
+	if (mesh.attributes.size() > MESH_MAX_ATTRIBUTES) {
+		throw std::runtime_error("ERROR: Too many vertex attributes for mesh file!");
+	}
+
+	MeshFileHeader header = {};
+	memcpy(header.magic, "VTMS", 4);
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = mesh.vertexCount;
+	header.indexCount = mesh.indexCount;
+	header.vertexStride = mesh.vertexStride;
+	header.indexType = mesh.indexType;
+	header.attributeCount = static_cast<uint32_t>(mesh.attributes.size());
+	std::copy(mesh.attributes.begin(), mesh.attributes.end(), header.attributes);
+
+	std::vector<const std::vector<char>*> blocks = { &mesh.vertexData, &mesh.indexData };
+	std::vector<MeshSectionType> types = { MESH_SECTION_VERTICES, MESH_SECTION_INDICES };
+	if (!mesh.meshletData.empty()) {
+		blocks.push_back(&mesh.meshletData);
+		types.push_back(MESH_SECTION_MESHLETS);
+	}
+
+	uint64_t offset = sizeof(MeshFileHeader);
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		offset = alignMeshOffset(offset);
+		header.sections[i].type = types[i];
+		header.sections[i].offset = offset;
+		header.sections[i].size = blocks[i]->size();
+		offset += blocks[i]->size();
+	}
+	header.sectionCount = static_cast<uint32_t>(blocks.size());
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	const char padding[MESH_SECTION_ALIGNMENT] = {};
+	uint64_t position = sizeof(MeshFileHeader);
+	for (uint32_t i = 0; i < header.sectionCount; i++) {
+		out.write(padding, static_cast<std::streamsize>(header.sections[i].offset - position));
+		out.write(blocks[i]->data(), static_cast<std::streamsize>(blocks[i]->size()));
+		position = header.sections[i].offset + header.sections[i].size;
+	}
+
+	if (!out.good()) {
+		throw std::runtime_error("ERROR: Failed to write mesh file!");
+	}
+}
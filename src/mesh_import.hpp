@@ -0,0 +1,148 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+#include "math.hpp"
+#include "vertex_layout.hpp"
+#include "meshlet.hpp"
+
+/*
+Mesh as it comes from the source file, before it is packed
+into the GPU vertex layout
+*/
+struct ImportedMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> colors;
+	std::vector<uint32_t> indices;
+};
+
+/*
+Resolves OBJ index (1-based, negative means relative to the end)
+*/
+inline uint32_t resolveObjIndex(long index, size_t count) {
+	long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+	if (resolved < 0 || resolved >= static_cast<long>(count)) {
+		throw std::runtime_error("ERROR: OBJ face references missing vertex!");
+	}
+	return static_cast<uint32_t>(resolved);
+}
+
+/*
+Minimal Wavefront OBJ reader.
+Supports "v x y z [r g b]" and polygonal faces, which are triangulated as fans.
+Texture coordinates and normals are ignored, so vertices are keyed by position index
+*/
+inline ImportedMesh importObj(const std::string& filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("ERROR: Failed to open " + filename + "!");
+	}
+
+	ImportedMesh mesh;
+	std::string line;
+	std::vector<uint32_t> polygon;
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+
+		if (type == "v") {
+			glm::vec3 position(0.0f);
+			glm::vec3 color(1.0f);
+			float r, g, b;
+			stream >> position.x >> position.y >> position.z;
+			if (stream >> r >> g >> b) { //Optional vertex colors
+				color = glm::vec3(r, g, b);
+			}
+			mesh.positions.push_back(position);
+			mesh.colors.push_back(color);
+		}
+		else if (type == "f") {
+			polygon.clear();
+			std::string corner;
+			while (stream >> corner) {
+				polygon.push_back(resolveObjIndex(std::stol(corner), mesh.positions.size()));
+			}
+			for (size_t i = 2; i < polygon.size(); i++) {
+				mesh.indices.push_back(polygon[0]);
+				mesh.indices.push_back(polygon[i - 1]);
+				mesh.indices.push_back(polygon[i]);
+			}
+		}
+	}
+
+	if (mesh.indices.empty()) {
+		throw std::runtime_error("ERROR: " + filename + " contains no faces!");
+	}
+
+	return mesh;
+}
+
+/*
+Geometry compiled into the application, used when no mesh file is available
+*/
+inline ImportedMesh builtinMesh() {
+	ImportedMesh mesh;
+	for (const auto& vertex : vertices) {
+		mesh.positions.push_back(glm::vec3(vertex.position.x, vertex.position.y, 0.0f));
+		mesh.colors.push_back(vertex.color);
+	}
+	mesh.indices.assign(indices.begin(), indices.end());
+
+	return mesh;
+}
+
+/*
+Packs imported mesh into given vertex layout.
+Index type is the smallest one which can address all vertices.
+Meshlets are built over the final triangle order
+*/
+template<typename Layout>
+MeshData buildMeshData(const ImportedMesh& mesh) {
+	MeshData data;
+	for (const auto& description : Layout::getAttributeDescriptions()) {
+		MeshAttribute attribute = {};
+		attribute.location = description.location;
+		attribute.format = description.format;
+		attribute.offset = description.offset;
+		data.attributes.push_back(attribute);
+	}
+	data.vertexStride = Layout::stride;
+	data.vertexCount = static_cast<uint32_t>(mesh.positions.size());
+	data.vertexData.resize(size_t(data.vertexCount) * Layout::stride);
+
+	char* packed = data.vertexData.data();
+	for (size_t i = 0; i < mesh.positions.size(); i++) {
+		Layout::pack(packed + i * Layout::stride, glm::vec2(mesh.positions[i].x, mesh.positions[i].y), mesh.colors[i]);
+	}
+
+	data.indexType = chooseIndexType(mesh.positions.size());
+	data.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	if (data.indexType == VK_INDEX_TYPE_UINT16) {
+		data.indexData.resize(mesh.indices.size() * sizeof(uint16_t));
+		uint16_t* packedIndices = reinterpret_cast<uint16_t*>(data.indexData.data());
+		for (size_t i = 0; i < mesh.indices.size(); i++) {
+			packedIndices[i] = static_cast<uint16_t>(mesh.indices[i]);
+		}
+	}
+	else {
+		data.indexData.resize(mesh.indices.size() * sizeof(uint32_t));
+		memcpy(data.indexData.data(), mesh.indices.data(), data.indexData.size());
+	}
+
+	data.meshletData = buildMeshlets(mesh.positions, mesh.indices).serialize();
+
+	return data;
+}
+
+/*
+Layout used for meshes produced by the converter and for the built-in quad
+*/
+typedef CompactVertexLayout MeshVertexLayout;
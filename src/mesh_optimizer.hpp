@@ -0,0 +1,385 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "mesh_import.hpp"
+
+/*
+Import time mesh optimizations, run in this order by optimizeMesh():
+	deduplicateVertices: merges bitwise identical vertices
+	optimizeVertexCache: reorders triangles for post-transform cache hits (Forsyth)
+	optimizeOverdraw: reorders cache friendly clusters so outer facing ones draw first
+	optimizeVertexFetch: reorders vertices by first use, drops unused ones
+*/
+
+/*
+Post-transform cache model used for statistics and overdraw cluster splitting.
+Most hardware behaves roughly like a small FIFO
+*/
+const uint32_t VERTEX_CACHE_FIFO_SIZE = 16;
+
+/*
+Cache size the Forsyth scoring function is tuned for
+*/
+const uint32_t FORSYTH_CACHE_SIZE = 32;
+
+/*
+ACMR: average cache miss ratio, transformed vertices per triangle (0.5 is ideal for grids, 3 is worst)
+ATVR: average transform to vertex ratio, transformed vertices per unique vertex (1 is ideal)
+*/
+struct VertexCacheStats {
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+inline VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_FIFO_SIZE) {
+	std::vector<uint32_t> cacheTimestamp(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	size_t misses = 0;
+
+	for (uint32_t index : indices) {
+		//Vertex is in FIFO if it was inserted less than cacheSize misses ago
+		if (timestamp - cacheTimestamp[index] > cacheSize) {
+			cacheTimestamp[index] = timestamp++;
+			misses++;
+		}
+	}
+
+	size_t usedVertices = 0;
+	for (uint32_t time : cacheTimestamp) {
+		usedVertices += time != 0;
+	}
+
+	VertexCacheStats stats;
+	stats.acmr = indices.empty() ? 0.0f : float(misses) / float(indices.size() / 3);
+	stats.atvr = usedVertices == 0 ? 0.0f : float(misses) / float(usedVertices);
+	return stats;
+}
+
+/*
+Merges vertices with identical attributes and remaps indices
+*/
+inline void deduplicateVertices(ImportedMesh& mesh) {
+	struct VertexKey {
+		float values[6];
+
+		bool operator==(const VertexKey& other) const {
+			return memcmp(values, other.values, sizeof(values)) == 0;
+		}
+	};
+	struct VertexKeyHash {
+		size_t operator()(const VertexKey& key) const {
+			//FNV-1a over the raw bits
+			uint32_t hash = 2166136261u;
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(key.values);
+			for (size_t i = 0; i < sizeof(key.values); i++) {
+				hash = (hash ^ bytes[i]) * 16777619u;
+			}
+			return hash;
+		}
+	};
+
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique;
+	unique.reserve(mesh.positions.size());
+	std::vector<uint32_t> remap(mesh.positions.size());
+	ImportedMesh result;
+
+	for (size_t i = 0; i < mesh.positions.size(); i++) {
+		VertexKey key = { { mesh.positions[i].x, mesh.positions[i].y, mesh.positions[i].z, mesh.colors[i].x, mesh.colors[i].y, mesh.colors[i].z } };
+		auto inserted = unique.emplace(key, static_cast<uint32_t>(result.positions.size()));
+		if (inserted.second) {
+			result.positions.push_back(mesh.positions[i]);
+			result.colors.push_back(mesh.colors[i]);
+		}
+		remap[i] = inserted.first->second;
+	}
+
+	result.indices.resize(mesh.indices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++) {
+		result.indices[i] = remap[mesh.indices[i]];
+	}
+
+	mesh = std::move(result);
+}
+
+inline float forsythVertexScore(int cachePosition, uint32_t remainingTriangles) {
+	if (remainingTriangles == 0) {
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			//Vertices of the last triangle are penalized to avoid strip-like orders
+			score = 0.75f;
+		}
+		else {
+			score = std::pow(1.0f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+		}
+	}
+	//Boost vertices with few triangles left, so they do not stay around forever
+	score += 2.0f / std::sqrt(float(remainingTriangles));
+
+	return score;
+}
+
+/*
+Linear-speed vertex cache optimization (Tom Forsyth).
+Greedily emits the triangle with the best score, scores favour vertices
+which are recently used and vertices with few remaining triangles
+*/
+inline void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	//Vertex -> triangle adjacency, first remaining[v] entries of each range are live
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices) {
+		remaining[index]++;
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	uint32_t bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[bestTriangle]) {
+			bestTriangle = static_cast<uint32_t>(t);
+		}
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	size_t scanPosition = 0;
+	bool hasBest = true;
+
+	while (result.size() < indices.size()) {
+		if (!hasBest) {
+			//Cache ran dry, continue with the next triangle in the input order
+			while (emitted[scanPosition]) {
+				scanPosition++;
+			}
+			bestTriangle = static_cast<uint32_t>(scanPosition);
+		}
+
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		emitted[bestTriangle] = 1;
+		result.insert(result.end(), triangle, triangle + 3);
+
+		newCache.clear();
+		for (uint32_t c = 0; c < 3; c++) {
+			uint32_t v = triangle[c];
+
+			//Remove emitted triangle from live adjacency
+			uint32_t* begin = &adjacency[offsets[v]];
+			uint32_t* end = begin + remaining[v];
+			uint32_t* found = std::find(begin, end, bestTriangle);
+			std::swap(*found, *(end - 1));
+			remaining[v]--;
+
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+				newCache.push_back(v);
+			}
+		}
+		for (uint32_t v : cache) {
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+				newCache.push_back(v);
+			}
+		}
+
+		//Update scores of everything that moved in the cache, including evicted vertices
+		float bestScore = -1.0f;
+		hasBest = false;
+		for (size_t i = 0; i < newCache.size(); i++) {
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+			float score = forsythVertexScore(cachePosition[v], remaining[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+				triangleScore[adjacency[a]] += delta;
+			}
+		}
+		for (size_t i = 0; i < newCache.size() && i < FORSYTH_CACHE_SIZE; i++) {
+			uint32_t v = newCache[i];
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+				uint32_t t = adjacency[a];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+					hasBest = true;
+				}
+			}
+		}
+
+		if (newCache.size() > FORSYTH_CACHE_SIZE) {
+			newCache.resize(FORSYTH_CACHE_SIZE);
+		}
+		cache.swap(newCache);
+	}
+
+	indices.swap(result);
+}
+
+/*
+Overdraw aware cluster reordering (Sander et al. "Fast triangle reordering for vertex locality and reduced overdraw").
+Cache optimized sequence is split into clusters where the FIFO cache starts cold,
+so moving whole clusters keeps most of the cache efficiency. Clusters facing away
+from the mesh center are drawn first as they are most likely to occlude the rest.
+Result is dropped if ACMR gets worse than threshold times the input one
+*/
+inline void optimizeOverdraw(ImportedMesh& mesh, float threshold = 1.05f) {
+	const std::vector<uint32_t>& indices = mesh.indices;
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	//Hard cluster boundaries: all three vertices of a triangle miss the cache
+	std::vector<size_t> clusterStarts;
+	std::vector<uint32_t> cacheTimestamp(mesh.positions.size(), 0);
+	uint32_t timestamp = VERTEX_CACHE_FIFO_SIZE + 1;
+	for (size_t t = 0; t < triangleCount; t++) {
+		uint32_t misses = 0;
+		for (uint32_t c = 0; c < 3; c++) {
+			uint32_t v = indices[t * 3 + c];
+			if (timestamp - cacheTimestamp[v] > VERTEX_CACHE_FIFO_SIZE) {
+				cacheTimestamp[v] = timestamp++;
+				misses++;
+			}
+		}
+		if (t == 0 || misses == 3) {
+			clusterStarts.push_back(t);
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	//Area weighted mesh centroid
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	std::vector<glm::vec3> clusterCentroids(clusterStarts.size() - 1, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterStarts.size() - 1, glm::vec3(0.0f));
+	for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+		float clusterArea = 0.0f;
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+			const glm::vec3& p0 = mesh.positions[indices[t * 3]];
+			const glm::vec3& p1 = mesh.positions[indices[t * 3 + 1]];
+			const glm::vec3& p2 = mesh.positions[indices[t * 3 + 2]];
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+			clusterNormals[c] += normal;
+			clusterCentroids[c] += centroid * area;
+			clusterArea += area;
+		}
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterArea;
+		if (clusterArea > 0.0f) {
+			clusterCentroids[c] = clusterCentroids[c] / clusterArea;
+		}
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid = meshCentroid / meshArea;
+	}
+
+	std::vector<float> sortKeys(clusterCentroids.size());
+	for (size_t c = 0; c < sortKeys.size(); c++) {
+		float normalLength = glm::length(clusterNormals[c]);
+		sortKeys[c] = normalLength > 0.0f ? glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength) : 0.0f;
+	}
+
+	std::vector<uint32_t> order(sortKeys.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) {
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t c : order) {
+		result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+	}
+
+	float acmrBefore = analyzeVertexCache(indices, mesh.positions.size()).acmr;
+	float acmrAfter = analyzeVertexCache(result, mesh.positions.size()).acmr;
+	if (acmrAfter <= acmrBefore * threshold) {
+		mesh.indices.swap(result);
+	}
+}
+
+/*
+Reorders vertices in the order they are first referenced, so vertex
+fetch walks memory linearly. Unreferenced vertices are dropped
+*/
+inline void optimizeVertexFetch(ImportedMesh& mesh) {
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(mesh.positions.size(), unused);
+	ImportedMesh result;
+	result.positions.reserve(mesh.positions.size());
+	result.colors.reserve(mesh.colors.size());
+	result.indices.resize(mesh.indices.size());
+
+	for (size_t i = 0; i < mesh.indices.size(); i++) {
+		uint32_t index = mesh.indices[i];
+		if (remap[index] == unused) {
+			remap[index] = static_cast<uint32_t>(result.positions.size());
+			result.positions.push_back(mesh.positions[index]);
+			result.colors.push_back(mesh.colors[index]);
+		}
+		result.indices[i] = remap[index];
+	}
+
+	mesh = std::move(result);
+}
+
+struct MeshOptimizationStats {
+	size_t vertexCountBefore = 0;
+	size_t vertexCountAfter = 0;
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+
+inline MeshOptimizationStats optimizeMesh(ImportedMesh& mesh) {
+	MeshOptimizationStats stats;
+	stats.vertexCountBefore = mesh.positions.size();
+	stats.before = analyzeVertexCache(mesh.indices, mesh.positions.size());
+
+	deduplicateVertices(mesh);
+	optimizeVertexCache(mesh.indices, mesh.positions.size());
+	optimizeOverdraw(mesh);
+	optimizeVertexFetch(mesh);
+
+	stats.vertexCountAfter = mesh.positions.size();
+	stats.after = analyzeVertexCache(mesh.indices, mesh.positions.size());
+	return stats;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "math.hpp"
+
+/*
+Meshlets are small clusters of consecutive triangles of the optimized index
+buffer. Each one is drawn as a range of the index buffer, so no extra index
+data is needed and every meshlet maps to one indexed indirect draw.
+Bounds are kept per meshlet for culling:
+	bounding sphere: frustum culling
+	normal cone: whole cluster is culled if all its triangles face away
+*/
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+/*
+Number of 4B streams in the serialized meshlet section
+*/
+const uint32_t MESHLET_STREAM_COUNT = 10;
+const uint32_t MESHLET_SIZE = MESHLET_STREAM_COUNT * 4;
+
+/*
+Structure of arrays, so culling walks each attribute linearly and
+the compiler is free to vectorize the loop. Serialized the same way,
+stream after stream, each meshletCount elements long
+*/
+struct MeshletSet {
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	std::vector<float> coneAxisX;
+	std::vector<float> coneAxisY;
+	std::vector<float> coneAxisZ;
+	std::vector<float> coneCutoff; //sine of the cone spread, above 1 disables the cone test
+	std::vector<uint32_t> firstIndex;
+	std::vector<uint32_t> indexCount;
+
+	size_t size() const {
+		return firstIndex.size();
+	}
+
+	void resize(size_t count) {
+		for (auto stream : floatStreams()) {
+			stream->resize(count);
+		}
+		firstIndex.resize(count);
+		indexCount.resize(count);
+	}
+
+	std::vector<char> serialize() const {
+		const size_t count = size();
+		std::vector<char> data(count * MESHLET_SIZE);
+		char* out = data.data();
+		for (auto stream : floatStreams()) {
+			memcpy(out, stream->data(), count * sizeof(float));
+			out += count * sizeof(float);
+		}
+		memcpy(out, firstIndex.data(), count * sizeof(uint32_t));
+		memcpy(out + count * sizeof(uint32_t), indexCount.data(), count * sizeof(uint32_t));
+
+		return data;
+	}
+
+	void deserialize(const char* data, size_t size) {
+		if (size % MESHLET_SIZE != 0) {
+			throw std::runtime_error("ERROR: Meshlet section has invalid size!");
+		}
+		const size_t count = size / MESHLET_SIZE;
+		resize(count);
+		for (auto stream : floatStreams()) {
+			memcpy(stream->data(), data, count * sizeof(float));
+			data += count * sizeof(float);
+		}
+		memcpy(firstIndex.data(), data, count * sizeof(uint32_t));
+		memcpy(indexCount.data(), data + count * sizeof(uint32_t), count * sizeof(uint32_t));
+	}
+
+private:
+	std::array<std::vector<float>*, 8> floatStreams() {
+		return { { &centerX, &centerY, &centerZ, &radius, &coneAxisX, &coneAxisY, &coneAxisZ, &coneCutoff } };
+	}
+
+	std::array<const std::vector<float>*, 8> floatStreams() const {
+		return { { &centerX, &centerY, &centerZ, &radius, &coneAxisX, &coneAxisY, &coneAxisZ, &coneCutoff } };
+	}
+};
+
+/*
+Computes sphere and normal cone of triangles [firstTriangle, lastTriangle)
+and appends them as a new meshlet
+*/
+inline void appendMeshlet(MeshletSet& meshlets, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, size_t firstTriangle, size_t lastTriangle) {
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(-std::numeric_limits<float>::max());
+	glm::vec3 normalSum(0.0f);
+	for (size_t i = firstTriangle * 3; i < lastTriangle * 3; i++) {
+		minimum = glm::min(minimum, positions[indices[i]]);
+		maximum = glm::max(maximum, positions[indices[i]]);
+	}
+
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+	std::vector<glm::vec3> normals;
+	for (size_t t = firstTriangle; t < lastTriangle; t++) {
+		const glm::vec3& p0 = positions[indices[t * 3]];
+		const glm::vec3& p1 = positions[indices[t * 3 + 1]];
+		const glm::vec3& p2 = positions[indices[t * 3 + 2]];
+		radius = std::max(radius, std::max(glm::length(p0 - center), std::max(glm::length(p1 - center), glm::length(p2 - center))));
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length > 0.0f) { //Degenerate triangles do not affect facing
+			normals.push_back(normal / length);
+			normalSum += normal / length;
+		}
+	}
+
+	glm::vec3 axis(0.0f, 0.0f, 1.0f);
+	float cutoff = 2.0f;
+	float axisLength = glm::length(normalSum);
+	if (axisLength > 0.0f) {
+		axis = normalSum / axisLength;
+		float minimumDot = 1.0f;
+		for (const auto& normal : normals) {
+			minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+		}
+		//Spread of 90 degrees or more can always see some front face
+		if (minimumDot > 0.0f) {
+			cutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+		}
+	}
+
+	meshlets.centerX.push_back(center.x);
+	meshlets.centerY.push_back(center.y);
+	meshlets.centerZ.push_back(center.z);
+	meshlets.radius.push_back(radius);
+	meshlets.coneAxisX.push_back(axis.x);
+	meshlets.coneAxisY.push_back(axis.y);
+	meshlets.coneAxisZ.push_back(axis.z);
+	meshlets.coneCutoff.push_back(cutoff);
+	meshlets.firstIndex.push_back(static_cast<uint32_t>(firstTriangle * 3));
+	meshlets.indexCount.push_back(static_cast<uint32_t>((lastTriangle - firstTriangle) * 3));
+}
+
+/*
+Splits the index buffer into meshlets in its current triangle order.
+Expects cache optimized order (see mesh_optimizer.hpp), where neighbouring
+triangles share vertices, so clusters come out spatially compact
+*/
+inline MeshletSet buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+	uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES) {
+	MeshletSet meshlets;
+	const size_t triangleCount = indices.size() / 3;
+
+	//Vertex is part of the current meshlet if its mark equals meshlet number
+	std::vector<uint32_t> marks(positions.size(), 0);
+	uint32_t meshletMark = 1;
+	uint32_t vertexCount = 0;
+	size_t firstTriangle = 0;
+
+	auto countNewVertices = [&](size_t t) {
+		uint32_t a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+		return uint32_t(marks[a] != meshletMark) + uint32_t(marks[b] != meshletMark && b != a) + uint32_t(marks[c] != meshletMark && c != a && c != b);
+	};
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		uint32_t newVertices = countNewVertices(t);
+		if (vertexCount + newVertices > maxVertices || t - firstTriangle >= maxTriangles) {
+			appendMeshlet(meshlets, positions, indices, firstTriangle, t);
+			firstTriangle = t;
+			vertexCount = 0;
+			meshletMark++;
+			newVertices = countNewVertices(t);
+		}
+
+		for (uint32_t c = 0; c < 3; c++) {
+			marks[indices[t * 3 + c]] = meshletMark;
+		}
+		vertexCount += newVertices;
+	}
+	if (firstTriangle < triangleCount) {
+		appendMeshlet(meshlets, positions, indices, firstTriangle, triangleCount);
+	}
+
+	return meshlets;
+}
+
+/*
+Culling input
+	planes: frustum planes, normalized and pointing inside
+	camera: w = 1 camera position, w = 0 view direction for orthographic views
+	invertedWinding: front faces have normals pointing away from the camera
+	                 (eg. geometry in Vulkan clip space drawn with VK_FRONT_FACE_CLOCKWISE)
+*/
+struct MeshletCullView {
+	glm::vec4 planes[6];
+	glm::vec4 camera;
+	bool invertedWinding = false;
+};
+
+inline MeshletCullView makeMeshletCullView(const glm::mat4& viewProjection, const glm::vec4& camera, bool invertedWinding) {
+	MeshletCullView view;
+	extractFrustumPlanes(viewProjection, view.planes);
+	view.camera = camera;
+	view.invertedWinding = invertedWinding;
+
+	return view;
+}
+
+/*
+Writes one indirect command per meshlet, culled meshlets get zero index count.
+Command count stays constant, so recorded command buffers never change and
+only the indirect buffer is rewritten each frame. Instance is the first instance of
+the commands, shaders index world matrices with it through gl_InstanceIndex.
+Non-zero values need drawIndirectFirstInstance. Returns number of visible meshlets
+*/
+inline uint32_t cullMeshlets(const MeshletSet& meshlets, const MeshletCullView& view, uint32_t instance, VkDrawIndexedIndirectCommand* commands) {
+	const size_t count = meshlets.size();
+	const float facing = view.invertedWinding ? -1.0f : 1.0f;
+	const bool orthographic = view.camera.w == 0.0f;
+	uint32_t visibleCount = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		const float x = meshlets.centerX[i];
+		const float y = meshlets.centerY[i];
+		const float z = meshlets.centerZ[i];
+		const float r = meshlets.radius[i];
+
+		bool visible = true;
+		for (const auto& plane : view.planes) {
+			visible &= plane.x * x + plane.y * y + plane.z * z + plane.w >= -r;
+		}
+
+		//Cluster is backfacing if the view vector is inside the cone opposite to all normals
+		float dx = orthographic ? view.camera.x : x - view.camera.x;
+		float dy = orthographic ? view.camera.y : y - view.camera.y;
+		float dz = orthographic ? view.camera.z : z - view.camera.z;
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		float coneDot = facing * (dx * meshlets.coneAxisX[i] + dy * meshlets.coneAxisY[i] + dz * meshlets.coneAxisZ[i]);
+		visible &= coneDot < meshlets.coneCutoff[i] * distance + (orthographic ? 0.0f : r);
+
+		commands[i].indexCount = visible ? meshlets.indexCount[i] : 0;
+		commands[i].instanceCount = 1;
+		commands[i].firstIndex = meshlets.firstIndex[i];
+		commands[i].vertexOffset = 0;
+		commands[i].firstInstance = instance;
+		visibleCount += visible;
+	}
+
+	return visibleCount;
+}
+
+/*
+Box enclosing all meshlet spheres, used as bounds of the whole mesh
+*/
+inline void computeMeshletBounds(const MeshletSet& meshlets, glm::vec3& center, glm::vec3& extent) {
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < meshlets.size(); i++) {
+		glm::vec3 sphereCenter(meshlets.centerX[i], meshlets.centerY[i], meshlets.centerZ[i]);
+		minimum = glm::min(minimum, sphereCenter - glm::vec3(meshlets.radius[i]));
+		maximum = glm::max(maximum, sphereCenter + glm::vec3(meshlets.radius[i]));
+	}
+	//Halves first, so unbounded meshlets do not overflow
+	center = maximum * 0.5f + minimum * 0.5f;
+	extent = maximum * 0.5f - minimum * 0.5f;
+}
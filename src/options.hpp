@@ -0,0 +1,132 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cstdlib>
+
+#include "present.hpp"
+#include "readback.hpp"
+#include "dynamic_resolution.hpp"
+
+/*
+Options of the interactive application, tools have their own (see main())
+*/
+struct AppOptions {
+	PresentPolicy presentPolicy = PresentPolicy::LowLatency;
+	double frameRateLimit = 0.0; //0 is unlimited
+	double simulationRate = 60.0; //fixed simulation steps per second
+	double offlineFps = 0.0; //0 runs on wall time, see SimulationClock
+	CaptureOptions capture;
+	std::string device; //part of the name of the device to use, empty picks the best one
+	uint32_t windows = 1; //windows rendered from one device, see SurfaceContext
+	VkExtent2D headless = {}; //size of the offscreen image rendered instead of a window, 0 opens windows
+	DynamicResolutionOptions resolution;
+};
+
+/*
+	--present <low-latency|power-saving|bounded-latency>
+	--fps-limit <frames per second>
+	--sim-rate <steps per second>
+	--offline-fps <frames per second> : every frame advances time by exactly 1 / fps
+	--capture <path> : frames are written out, see CaptureFormat
+	--capture-format <png|yuv|ffmpeg>
+	--capture-fps <frames per second of the video>
+	--capture-frames <count> : closes the window after count frames were captured
+	--capture-buffers <count> : frames which may be in flight between GPU and writer
+	--compare-threshold <distance> : per pixel tolerance of the compare format
+	--compare-fraction <fraction> : pixels which may exceed it
+	--device <name> : uses the device whose name contains name, ie. llvmpipe for Mesa lavapipe
+	--windows <count> : renders the scene into count windows sharing one device
+	--headless <width>x<height> : renders into an offscreen RGBA8 image, needs no window system or present support
+	--gpu-budget <milliseconds> : scales render resolution to hold GPU frame time under the budget
+	--min-render-scale <scale> : lowest scale of the swapchain extent the scene is rendered at
+	--max-render-scale <scale> : highest one, at most 1
+*/
+inline AppOptions parseAppOptions(int argc, char* argv[]) {
+	AppOptions options;
+	for (int i = 1; i < argc; i++) {
+		const std::string option = argv[i];
+		if (i + 1 >= argc) {
+			throw std::runtime_error("ERROR: Missing value of option " + option + "!");
+		}
+		const std::string value = argv[++i];
+
+		if (option == "--present") {
+			options.presentPolicy = parsePresentPolicy(value);
+		}
+		else if (option == "--fps-limit") {
+			options.frameRateLimit = std::atof(value.c_str());
+		}
+		else if (option == "--sim-rate") {
+			options.simulationRate = std::atof(value.c_str());
+		}
+		else if (option == "--offline-fps") {
+			options.offlineFps = std::atof(value.c_str());
+		}
+		else if (option == "--capture") {
+			options.capture.path = value;
+		}
+		else if (option == "--capture-format") {
+			options.capture.format = parseCaptureFormat(value);
+		}
+		else if (option == "--capture-fps") {
+			options.capture.fps = std::atof(value.c_str());
+		}
+		else if (option == "--capture-frames") {
+			options.capture.frames = static_cast<uint32_t>(std::atoi(value.c_str()));
+		}
+		else if (option == "--capture-buffers") {
+			options.capture.buffers = static_cast<uint32_t>(std::atoi(value.c_str()));
+		}
+		else if (option == "--compare-threshold") {
+			options.capture.compareThreshold = std::atof(value.c_str());
+		}
+		else if (option == "--compare-fraction") {
+			options.capture.compareFraction = std::atof(value.c_str());
+		}
+		else if (option == "--device") {
+			options.device = value;
+		}
+		else if (option == "--windows") {
+			int windows = std::atoi(value.c_str());
+			if (windows < 1) {
+				throw std::runtime_error("ERROR: At least one window is needed!");
+			}
+			options.windows = static_cast<uint32_t>(windows);
+		}
+		else if (option == "--headless") {
+			unsigned int width = 0, height = 0;
+			char separator = 0;
+			std::istringstream stream(value);
+			if (!(stream >> width >> separator >> height) || separator != 'x' || width == 0 || height == 0) {
+				throw std::runtime_error("ERROR: Headless size " + value + " is not <width>x<height>!");
+			}
+			options.headless = { width, height };
+		}
+		else if (option == "--gpu-budget") {
+			options.resolution.targetMilliseconds = std::atof(value.c_str());
+		}
+		else if (option == "--min-render-scale") {
+			options.resolution.minScale = std::atof(value.c_str());
+		}
+		else if (option == "--max-render-scale") {
+			options.resolution.maxScale = std::atof(value.c_str());
+		}
+		else {
+			throw std::runtime_error("ERROR: Unknown option " + option + "!");
+		}
+	}
+
+	//Nothing closes an offscreen run but the captured frame count
+	if (options.headless.width > 0 && (options.capture.path.empty() || options.capture.frames == 0 || options.windows > 1)) {
+		throw std::runtime_error("ERROR: --headless renders one image and needs --capture with --capture-frames!");
+	}
+
+	//HDR target has the swapchain extent, scenes are not rendered above it
+	const DynamicResolutionOptions& resolution = options.resolution;
+	if (resolution.minScale <= 0.0 || resolution.maxScale > 1.0 || resolution.minScale > resolution.maxScale) {
+		throw std::runtime_error("ERROR: Render scales must satisfy 0 < min <= max <= 1!");
+	}
+	return options;
+}
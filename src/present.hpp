@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+/*
+How frames are presented:
+	LowLatency: newest frame wins (mailbox, else immediate), may tear or render frames never shown
+	PowerSaving: vsync (FIFO) with a frame queued ahead, GPU and CPU idle between vblanks
+	BoundedLatency: vsync with the fewest images, frames are paced to start just before
+					the next vblank, so input is sampled as late as possible
+*/
+enum class PresentPolicy {
+	LowLatency,
+	PowerSaving,
+	BoundedLatency
+};
+
+inline PresentPolicy parsePresentPolicy(const std::string& name) {
+	if (name == "low-latency") {
+		return PresentPolicy::LowLatency;
+	}
+	else if (name == "power-saving") {
+		return PresentPolicy::PowerSaving;
+	}
+	else if (name == "bounded-latency") {
+		return PresentPolicy::BoundedLatency;
+	}
+	throw std::runtime_error("ERROR: Unknown present policy " + name + " (low-latency, power-saving, bounded-latency)!");
+}
+
+inline const char* presentPolicyName(PresentPolicy policy) {
+	switch (policy) {
+	case PresentPolicy::LowLatency: return "low-latency";
+	case PresentPolicy::PowerSaving: return "power-saving";
+	case PresentPolicy::BoundedLatency: return "bounded-latency";
+	}
+	return "unknown";
+}
+
+struct PresentConfig {
+	VkPresentModeKHR mode;
+	uint32_t imageCount;
+};
+
+/*
+Picks present mode and explicit swapchain image count for the policy.
+FIFO is always available, the count is clamped to surface limits
+*/
+inline PresentConfig choosePresentConfig(PresentPolicy policy, const std::vector<VkPresentModeKHR>& modes, const VkSurfaceCapabilitiesKHR& capabilities) {
+	auto available = [&](VkPresentModeKHR mode) {
+		return std::find(modes.begin(), modes.end(), mode) != modes.end();
+	};
+
+	PresentConfig config = { VK_PRESENT_MODE_FIFO_KHR, 2 };
+	switch (policy) {
+	case PresentPolicy::LowLatency:
+		//Mailbox needs a spare image to render into while one is queued and one shown
+		if (available(VK_PRESENT_MODE_MAILBOX_KHR)) {
+			config = { VK_PRESENT_MODE_MAILBOX_KHR, 3 };
+		}
+		else if (available(VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+			config = { VK_PRESENT_MODE_IMMEDIATE_KHR, 2 };
+		}
+		break;
+	case PresentPolicy::PowerSaving:
+		config = { VK_PRESENT_MODE_FIFO_KHR, 3 };
+		break;
+	case PresentPolicy::BoundedLatency:
+		config = { VK_PRESENT_MODE_FIFO_KHR, 2 };
+		break;
+	}
+
+	config.imageCount = std::max(config.imageCount, capabilities.minImageCount);
+	//maxImageCount = 0 is no limit beside memory req.
+	if (capabilities.maxImageCount > 0) {
+		config.imageCount = std::min(config.imageCount, capabilities.maxImageCount);
+	}
+	return config;
+}
+
+/*
+Frame limiter tuning: safety margin before the deadline, how long before the
+frame start sleeping switches to yielding and smoothing of the estimates
+*/
+const double FRAME_LIMITER_MARGIN_MS = 1.0;
+const double FRAME_LIMITER_SPIN_MS = 2.0;
+const double FRAME_LIMITER_SMOOTHING = 0.05;
+
+/*
+CPU side frame pacing. The frame starts (and samples input) at the predicted
+deadline minus the expected frame work, so it is presented just in time instead
+of waiting in the queue. Deadline is the next vblank estimated from present
+intervals, or the frame rate cap if it is longer
+*/
+class FrameLimiter {
+public:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	/*
+	frameRateLimit of 0 disables the cap, pacing to vblank then decides
+	*/
+	void init(double frameRateLimit, bool paceToVblank) {
+		m_limitMilliseconds = frameRateLimit > 0.0 ? 1000.0 / frameRateLimit : 0.0;
+		m_paceToVblank = paceToVblank;
+		m_vblankMilliseconds = 0.0;
+		m_workMilliseconds = 0.0;
+		m_lastPresent = Clock::time_point();
+	}
+
+	bool enabled() const {
+		return m_limitMilliseconds > 0.0 || m_paceToVblank;
+	}
+
+	/*
+	Sleeps until the frame should start. Sleep is coarse (especially on Windows),
+	the last stretch is spent yielding
+	*/
+	void wait() const {
+		double interval = std::max(m_limitMilliseconds, m_paceToVblank ? m_vblankMilliseconds : 0.0);
+		if (interval <= 0.0 || m_lastPresent == Clock::time_point()) {
+			return;
+		}
+
+		double lead = std::min(m_workMilliseconds + FRAME_LIMITER_MARGIN_MS, interval);
+		Clock::time_point start = m_lastPresent + toDuration(interval - lead);
+		Clock::time_point sleepEnd = start - toDuration(FRAME_LIMITER_SPIN_MS);
+		if (Clock::now() < sleepEnd) {
+			std::this_thread::sleep_until(sleepEnd);
+		}
+		while (Clock::now() < start) {
+			std::this_thread::yield();
+		}
+	}
+
+	/*
+	Reports CPU work of the frame without time blocked on the GPU or swapchain.
+	With vsync, successive presents return one refresh interval apart
+	*/
+	void presented(double work, Clock::time_point presentEnd) {
+		m_workMilliseconds = m_workMilliseconds == 0.0 ? work : m_workMilliseconds + (work - m_workMilliseconds) * FRAME_LIMITER_SMOOTHING;
+
+		if (m_lastPresent != Clock::time_point()) {
+			double interval = std::chrono::duration<double, std::milli>(presentEnd - m_lastPresent).count();
+			//Ignore hitches (window moves, swapchain recreation) instead of learning them
+			if (interval > 1.0 && interval < 100.0) {
+				m_vblankMilliseconds = m_vblankMilliseconds == 0.0 ? interval : m_vblankMilliseconds + (interval - m_vblankMilliseconds) * FRAME_LIMITER_SMOOTHING;
+			}
+		}
+		m_lastPresent = presentEnd;
+	}
+
+	double vblankMilliseconds() const {
+		return m_vblankMilliseconds;
+	}
+
+private:
+	static Clock::duration toDuration(double milliseconds) {
+		return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(milliseconds));
+	}
+
+	double				m_limitMilliseconds = 0.0;
+	bool				m_paceToVblank = false;
+	double				m_vblankMilliseconds = 0.0;
+	double				m_workMilliseconds = 0.0;
+	Clock::time_point	m_lastPresent;
+};
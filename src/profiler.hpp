@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+
+/*
+Lightweight frame instrumentation.
+Stages accumulate CPU time, counters keep the last reported value.
+Averages over the report interval are formatted by endFrame,
+which is cheap enough to stay enabled in release builds.
+Not thread safe, stages are reported from the main thread
+*/
+class Profiler {
+public:
+	/*
+	Measures its own lifetime into given stage
+	*/
+	class Scope {
+	public:
+		Scope(Profiler& profiler, const char* stage)
+			: m_profiler(profiler), m_stage(stage), m_start(std::chrono::high_resolution_clock::now()) {
+		}
+
+		~Scope() {
+			auto end = std::chrono::high_resolution_clock::now();
+			m_profiler.addTime(m_stage, std::chrono::duration<double, std::milli>(end - m_start).count());
+		}
+
+	private:
+		Profiler& m_profiler;
+		const char* m_stage;
+		std::chrono::high_resolution_clock::time_point m_start;
+	};
+
+	explicit Profiler(double reportInterval = 1.0)
+		: m_reportInterval(reportInterval), m_intervalStart(std::chrono::high_resolution_clock::now()) {
+	}
+
+	void addTime(const char* stage, double milliseconds) {
+		find(m_stages, stage).value += milliseconds;
+	}
+
+	void setCounter(const char* counter, double value) {
+		find(m_counters, counter).value = value;
+	}
+
+	/*
+	Closes the frame. Once per report interval returns true and fills
+	report with frame rate, average stage times and current counters
+	*/
+	bool endFrame(std::string& report) {
+		m_frames++;
+		auto now = std::chrono::high_resolution_clock::now();
+		double elapsed = std::chrono::duration<double>(now - m_intervalStart).count();
+		if (elapsed < m_reportInterval) {
+			return false;
+		}
+
+		std::ostringstream stream;
+		stream << std::fixed << std::setprecision(3) << m_frames / elapsed << " fps, " << 1000.0 * elapsed / m_frames << " ms/frame";
+		for (auto& stage : m_stages) {
+			stream << ", " << stage.name << " " << stage.value / m_frames << " ms";
+			stage.value = 0.0;
+		}
+		stream << std::setprecision(0);
+		for (const auto& counter : m_counters) {
+			stream << ", " << counter.name << " " << counter.value;
+		}
+		report = stream.str();
+
+		m_frames = 0;
+		m_intervalStart = now;
+		return true;
+	}
+
+private:
+	struct Entry {
+		const char* name;
+		double value;
+	};
+
+	//Few entries, linear search by name pointer beats hashing
+	static Entry& find(std::vector<Entry>& entries, const char* name) {
+		for (auto& entry : entries) {
+			if (entry.name == name || strcmp(entry.name, name) == 0) {
+				return entry;
+			}
+		}
+		entries.push_back({ name, 0.0 });
+		return entries.back();
+	}
+
+	double												m_reportInterval;
+	std::chrono::high_resolution_clock::time_point		m_intervalStart;
+	uint32_t											m_frames = 0;
+	std::vector<Entry>									m_stages;
+	std::vector<Entry>									m_counters;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <type_traits>
+#include <cstdint>
+
+/*
+Minimum of VkPhysicalDeviceLimits::maxPushConstantsSize guaranteed by the spec.
+Blocks which fit into it work on every device without a runtime limit check
+*/
+const uint32_t PUSH_CONSTANTS_GUARANTEED_SIZE = 128;
+
+/*
+Typed push constant block: struct T visible to given shader stages at Offset.
+Size and alignment are validated at compile time, the same type then describes
+the pipeline layout range and every vkCmdPushConstants call, so they can not diverge
+*/
+template <typename T, VkShaderStageFlags Stages, uint32_t Offset = 0>
+class PushConstantBlock {
+	static_assert(std::is_trivially_copyable<T>::value, "Push constants are copied as raw bytes!");
+	static_assert(Offset % 4 == 0 && sizeof(T) % 4 == 0, "Push constant offset and size must be multiples of 4!");
+	static_assert(Offset + sizeof(T) <= PUSH_CONSTANTS_GUARANTEED_SIZE, "Push constants exceed guaranteed maxPushConstantsSize!");
+
+public:
+	static VkPushConstantRange range() {
+		VkPushConstantRange range = {};
+		range.stageFlags = Stages;
+		range.offset = Offset;
+		range.size = static_cast<uint32_t>(sizeof(T));
+		return range;
+	}
+
+	static void push(VkCommandBuffer commandBuffer, VkPipelineLayout layout, const T& data) {
+		vkCmdPushConstants(commandBuffer, layout, Stages, Offset, static_cast<uint32_t>(sizeof(T)), &data);
+	}
+};
@@ -0,0 +1,708 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "image_compare.hpp"
+
+/*
+Output of captured frames:
+	Png: one file per frame, <path>000000.png, <path>000001.png, ...
+	Yuv: raw I420 (yuv420p, BT.601 limited range) frames appended to one file
+	Ffmpeg: raw frames piped into a local ffmpeg process which encodes <path>
+	Compare: frames are compared with reference images <path>000000.png, ... (made with Png),
+			mismatching ones are written next to them as <path>000000.actual.png
+*/
+enum class CaptureFormat {
+	Png,
+	Yuv,
+	Ffmpeg,
+	Compare
+};
+
+inline CaptureFormat parseCaptureFormat(const std::string& name) {
+	if (name == "png") {
+		return CaptureFormat::Png;
+	}
+	else if (name == "yuv") {
+		return CaptureFormat::Yuv;
+	}
+	else if (name == "ffmpeg") {
+		return CaptureFormat::Ffmpeg;
+	}
+	else if (name == "compare") {
+		return CaptureFormat::Compare;
+	}
+	throw std::runtime_error("ERROR: Unknown capture format " + name + " (png, yuv, ffmpeg, compare)!");
+}
+
+inline const char* captureFormatName(CaptureFormat format) {
+	switch (format) {
+	case CaptureFormat::Png: return "png";
+	case CaptureFormat::Yuv: return "yuv";
+	case CaptureFormat::Ffmpeg: return "ffmpeg";
+	case CaptureFormat::Compare: return "compare";
+	}
+	return "unknown";
+}
+
+/*
+Capture is enabled by a non empty path. frames of 0 captures until the window closes,
+buffers is the number of frames which may be in flight between GPU and writer.
+Compared frame fails when more than compareFraction of its pixels are further than
+compareThreshold from the reference, see compareImages
+*/
+struct CaptureOptions {
+	std::string path;
+	CaptureFormat format = CaptureFormat::Png;
+	double fps = 60.0;
+	uint32_t frames = 0;
+	uint32_t buffers = 3;
+	double compareThreshold = 8.0;
+	double compareFraction = 0.001;
+};
+
+/*
+PNG chunks are protected by CRC-32 (polynomial 0xEDB88320)
+*/
+inline uint32_t pngCrc(const uint8_t* data, size_t size, uint32_t crc = 0) {
+	static const std::vector<uint32_t> table = []() {
+		std::vector<uint32_t> values(256);
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; bit++) {
+				value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+			}
+			values[i] = value;
+		}
+		return values;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+inline void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+inline void appendPngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+	appendBigEndian(out, static_cast<uint32_t>(data.size()));
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	appendBigEndian(out, pngCrc(out.data() + start, out.size() - start));
+}
+
+/*
+Encodes 8 bit RGBA/BGRA pixels as RGB PNG. Image data are stored in uncompressed
+deflate blocks, encoding then costs about a memcpy and the writer keeps up
+with the GPU, compact output is what the ffmpeg format is for
+*/
+inline void encodePng(std::vector<uint8_t>& out, const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra) {
+	const size_t rowSize = 1 + static_cast<size_t>(width) * 3; //filter type + RGB
+	std::vector<uint8_t> raw(rowSize * height);
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t* src = pixels + static_cast<size_t>(y) * width * 4;
+		uint8_t* dst = raw.data() + y * rowSize;
+		*dst++ = 0; //no filter
+		for (uint32_t x = 0; x < width; x++, src += 4, dst += 3) {
+			dst[0] = src[bgra ? 2 : 0];
+			dst[1] = src[1];
+			dst[2] = src[bgra ? 0 : 2];
+		}
+	}
+
+	const size_t MAX_STORED_BLOCK = 65535;
+	std::vector<uint8_t> zlib;
+	zlib.reserve(raw.size() + raw.size() / MAX_STORED_BLOCK * 5 + 16);
+	zlib.push_back(0x78); //deflate, 32K window
+	zlib.push_back(0x01);
+	uint32_t adlerA = 1, adlerB = 0;
+	size_t offset = 0;
+	do {
+		size_t blockSize = std::min(MAX_STORED_BLOCK, raw.size() - offset);
+		bool last = offset + blockSize == raw.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(blockSize));
+		zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+		zlib.push_back(static_cast<uint8_t>(~blockSize));
+		zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+		//Sums are reduced every 5552 bytes, the most which can not overflow them
+		for (size_t chunk = offset; chunk < offset + blockSize; chunk += 5552) {
+			size_t chunkEnd = std::min(chunk + 5552, offset + blockSize);
+			for (size_t i = chunk; i < chunkEnd; i++) {
+				adlerA += raw[i];
+				adlerB += adlerA;
+			}
+			adlerA %= 65521;
+			adlerB %= 65521;
+		}
+		offset += blockSize;
+	} while (offset < raw.size());
+	appendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+	std::vector<uint8_t> header;
+	appendBigEndian(header, width);
+	appendBigEndian(header, height);
+	header.push_back(8); //bit depth
+	header.push_back(2); //color type RGB
+	header.push_back(0); //compression
+	header.push_back(0); //filter
+	header.push_back(0); //no interlace
+
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.assign(signature, signature + sizeof(signature));
+	appendPngChunk(out, "IHDR", header);
+	appendPngChunk(out, "IDAT", zlib);
+	appendPngChunk(out, "IEND", std::vector<uint8_t>());
+}
+
+/*
+Converts 8 bit RGBA/BGRA pixels to I420 (BT.601, limited range).
+Chroma is averaged over 2x2 blocks, odd edges repeat the last pixel
+*/
+inline void convertToI420(std::vector<uint8_t>& out, const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra) {
+	const uint32_t chromaWidth = (width + 1) / 2;
+	const uint32_t chromaHeight = (height + 1) / 2;
+	const size_t lumaSize = static_cast<size_t>(width) * height;
+	const size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+	out.resize(lumaSize + 2 * chromaSize);
+	uint8_t* lumaPlane = out.data();
+	uint8_t* uPlane = lumaPlane + lumaSize;
+	uint8_t* vPlane = uPlane + chromaSize;
+	const int r = bgra ? 2 : 0;
+	const int b = bgra ? 0 : 2;
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t* src = pixels + static_cast<size_t>(y) * width * 4;
+		uint8_t* dst = lumaPlane + static_cast<size_t>(y) * width;
+		for (uint32_t x = 0; x < width; x++, src += 4) {
+			dst[x] = static_cast<uint8_t>(((66 * src[r] + 129 * src[1] + 25 * src[b] + 128) >> 8) + 16);
+		}
+	}
+
+	for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+		uint32_t y0 = cy * 2;
+		uint32_t y1 = std::min(y0 + 1, height - 1);
+		for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+			uint32_t x0 = cx * 2;
+			uint32_t x1 = std::min(x0 + 1, width - 1);
+			const uint8_t* samples[] = {
+				pixels + (static_cast<size_t>(y0) * width + x0) * 4,
+				pixels + (static_cast<size_t>(y0) * width + x1) * 4,
+				pixels + (static_cast<size_t>(y1) * width + x0) * 4,
+				pixels + (static_cast<size_t>(y1) * width + x1) * 4
+			};
+			int red = 0, green = 0, blue = 0;
+			for (const uint8_t* sample : samples) {
+				red += sample[r];
+				green += sample[1];
+				blue += sample[b];
+			}
+			red = (red + 2) / 4;
+			green = (green + 2) / 4;
+			blue = (blue + 2) / 4;
+			size_t index = static_cast<size_t>(cy) * chromaWidth + cx;
+			uPlane[index] = static_cast<uint8_t>(((-38 * red - 74 * green + 112 * blue + 128) >> 8) + 128);
+			vPlane[index] = static_cast<uint8_t>(((112 * red - 94 * green - 18 * blue + 128) >> 8) + 128);
+		}
+	}
+}
+
+/*
+Encodes captured frames on its own thread, in the order they were queued.
+Pixels are read in place from the readback buffer, release is called with
+the buffer slot once the frame is written and the slot may be reused.
+Errors stop writing, the render thread picks them up through error()
+*/
+class FrameWriter {
+public:
+	~FrameWriter() {
+		close();
+	}
+
+	void open(const CaptureOptions& options, uint32_t width, uint32_t height, bool bgra, std::function<void(uint32_t)> release) {
+		m_options = options;
+		m_width = width;
+		m_height = height;
+		m_bgra = bgra;
+		m_release = std::move(release);
+		m_written = 0;
+		m_mismatches = 0;
+		m_stop = false;
+		m_error.clear();
+
+		if (m_options.format == CaptureFormat::Yuv) {
+			m_file.open(m_options.path, std::ios::binary | std::ios::trunc);
+			if (!m_file) {
+				throw std::runtime_error("ERROR: Failed to open capture file " + m_options.path + "!");
+			}
+		}
+		else if (m_options.format == CaptureFormat::Ffmpeg) {
+			std::ostringstream command;
+			command << "ffmpeg -loglevel error -y -f rawvideo -pixel_format " << (m_bgra ? "bgra" : "rgba")
+				<< " -video_size " << m_width << "x" << m_height << " -framerate " << m_options.fps
+				<< " -i - -pix_fmt yuv420p \"" << m_options.path << "\"";
+#ifdef _WIN32
+			m_pipe = _popen(command.str().c_str(), "wb");
+#else
+			m_pipe = popen(command.str().c_str(), "w");
+#endif
+			if (!m_pipe) {
+				throw std::runtime_error("ERROR: Failed to start " + command.str() + "!");
+			}
+		}
+
+		m_thread = std::thread([this]() { writerLoop(); });
+	}
+
+	/*
+	Queues frame, never blocks on encoding
+	*/
+	void write(const uint8_t* pixels, uint32_t slot) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back({ pixels, slot });
+		}
+		m_wake.notify_one();
+	}
+
+	/*
+	Writes the remaining frames and closes the output
+	*/
+	void close() {
+		if (!m_thread.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+
+		if (m_file.is_open()) {
+			m_file.close();
+		}
+		if (m_pipe) {
+#ifdef _WIN32
+			_pclose(m_pipe);
+#else
+			pclose(m_pipe);
+#endif
+			m_pipe = nullptr;
+		}
+	}
+
+	uint64_t written() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_written;
+	}
+
+	/*
+	Compared frames which did not match their reference
+	*/
+	uint64_t mismatches() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_mismatches;
+	}
+
+	std::string error() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_error;
+	}
+
+private:
+	struct Job {
+		const uint8_t* pixels;
+		uint32_t slot;
+	};
+
+	void writerLoop() {
+		std::vector<uint8_t> encoded;
+		for (;;) {
+			Job job;
+			bool failed;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+				if (m_jobs.empty()) {
+					return;
+				}
+				job = m_jobs.front();
+				m_jobs.pop_front();
+				failed = !m_error.empty();
+			}
+
+			std::string error;
+			if (!failed) {
+				try {
+					encode(job.pixels, encoded);
+				}
+				catch (const std::runtime_error& e) {
+					error = e.what();
+				}
+			}
+			m_release(job.slot);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!error.empty()) {
+				m_error = error;
+			}
+			else if (!failed) {
+				m_written++;
+			}
+		}
+	}
+
+	void encode(const uint8_t* pixels, std::vector<uint8_t>& encoded) {
+		const size_t frameSize = static_cast<size_t>(m_width) * m_height * 4;
+		switch (m_options.format) {
+		case CaptureFormat::Png: {
+			encodePng(encoded, pixels, m_width, m_height, m_bgra);
+			std::ostringstream filename;
+			filename << m_options.path << std::setw(6) << std::setfill('0') << m_written << ".png";
+			std::ofstream file(filename.str(), std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+			if (!file) {
+				throw std::runtime_error("ERROR: Failed to write " + filename.str() + "!");
+			}
+			break;
+		}
+		case CaptureFormat::Yuv:
+			convertToI420(encoded, pixels, m_width, m_height, m_bgra);
+			m_file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+			if (!m_file) {
+				throw std::runtime_error("ERROR: Failed to write " + m_options.path + "!");
+			}
+			break;
+		case CaptureFormat::Ffmpeg:
+			if (fwrite(pixels, 1, frameSize, m_pipe) != frameSize) {
+				throw std::runtime_error("ERROR: ffmpeg stopped accepting frames!");
+			}
+			break;
+		case CaptureFormat::Compare:
+			if (!compare(pixels, encoded)) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_mismatches++;
+			}
+			break;
+		}
+	}
+
+	/*
+	Missing or differently sized reference is a mismatch too, so new
+	frames can not pass unnoticed
+	*/
+	bool compare(const uint8_t* pixels, std::vector<uint8_t>& encoded) {
+		std::ostringstream name;
+		name << m_options.path << std::setw(6) << std::setfill('0') << m_written;
+		std::ostringstream result;
+		result << "Frame " << m_written << ": ";
+
+		bool match = false;
+		try {
+			Image reference = loadPng(name.str() + ".png");
+			if (reference.width != m_width || reference.height != m_height) {
+				result << "reference is " << reference.width << "x" << reference.height << ", frame " << m_width << "x" << m_height;
+			}
+			else {
+				std::vector<uint8_t> rgba(pixels, pixels + static_cast<size_t>(m_width) * m_height * 4);
+				if (m_bgra) {
+					for (size_t i = 0; i < rgba.size(); i += 4) {
+						std::swap(rgba[i], rgba[i + 2]);
+					}
+				}
+				ImageDifference difference = compareImages(rgba.data(), reference.pixels.data(), static_cast<uint64_t>(m_width) * m_height, m_options.compareThreshold);
+				match = difference.differingFraction() <= m_options.compareFraction;
+				result << std::fixed << std::setprecision(2) << difference.differing << " pixels differ (" << difference.differingFraction() * 100.0
+					<< "%), max distance " << difference.maxDistance << ", PSNR " << difference.psnr << " dB";
+			}
+		}
+		catch (const std::runtime_error& e) {
+			result << e.what();
+		}
+		result << (match ? " - match" : " - MISMATCH");
+		std::cout << result.str() << std::endl;
+
+		if (!match) {
+			encodePng(encoded, pixels, m_width, m_height, m_bgra);
+			std::ofstream file(name.str() + ".actual.png", std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+		}
+		return match;
+	}
+
+	CaptureOptions				m_options;
+	uint32_t					m_width = 0;
+	uint32_t					m_height = 0;
+	bool						m_bgra = true;
+	std::function<void(uint32_t)>	m_release;
+	std::ofstream				m_file;
+	FILE*						m_pipe = nullptr;
+	std::thread					m_thread;
+	std::mutex					m_mutex;
+	std::condition_variable		m_wake;
+	std::deque<Job>				m_jobs;
+	bool						m_stop = false;
+	uint64_t					m_written = 0;
+	uint64_t					m_mismatches = 0;
+	std::string					m_error;
+};
+
+/*
+Asynchronous readback of rendered frames. A ring of persistently mapped host
+buffers receives copies of the frame image, once the GPU completed the copy the
+slot is handed to the FrameWriter and returns to the ring after encoding.
+Render loop never waits: when all slots are busy the frame is not captured
+and counted as dropped, more buffers absorb longer writer stalls.
+Frames keep their order, as submissions complete in order
+*/
+class FrameReadback {
+public:
+	typedef std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)> FindMemoryType;
+
+	bool enabled() const {
+		return !m_options.path.empty();
+	}
+
+	/*
+	Image is copied as is, so only 8 bit RGBA/BGRA formats are accepted
+	*/
+	void init(VkDevice device, const FindMemoryType& findMemoryType, const CaptureOptions& options, VkFormat format, VkExtent2D extent) {
+		m_device = device;
+		m_options = options;
+		m_extent = extent;
+		m_captured = 0;
+		m_dropped = 0;
+		m_current = -1;
+
+		switch (format) {
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			m_bgra = true;
+			break;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			m_bgra = false;
+			break;
+		default:
+			throw std::runtime_error("ERROR: Frame capture needs 8 bit RGBA or BGRA swapchain format!");
+		}
+
+		VkDeviceSize frameSize = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+		m_slots.resize(std::max(options.buffers, 1u));
+		for (uint32_t i = 0; i < m_slots.size(); i++) {
+			Slot& slot = m_slots[i];
+			VkBufferCreateInfo bufferInfo = {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = frameSize;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to create readback buffer!");
+			}
+
+			VkMemoryRequirements requirements;
+			vkGetBufferMemoryRequirements(m_device, slot.buffer, &requirements);
+
+			//CPU reads every byte, uncached memory would make the writer crawl
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = requirements.size;
+			try {
+				allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+				m_coherent = false;
+			}
+			catch (const std::runtime_error&) {
+				allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				m_coherent = true;
+			}
+			if (vkAllocateMemory(m_device, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to allocate readback buffer memory!");
+			}
+			vkBindBufferMemory(m_device, slot.buffer, slot.memory, 0);
+
+			void* data;
+			vkMapMemory(m_device, slot.memory, 0, VK_WHOLE_SIZE, 0, &data);
+			slot.pixels = static_cast<const uint8_t*>(data);
+			m_free.push_back(i);
+		}
+
+		m_writer.open(options, extent.width, extent.height, m_bgra, [this](uint32_t slot) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(slot);
+		});
+	}
+
+	/*
+	Picks the slot for the frame about to be recorded, returns false
+	(frame is dropped) if none is free or the image size changed
+	*/
+	bool beginFrame(VkExtent2D extent) {
+		m_current = -1;
+		if (extent.width != m_extent.width || extent.height != m_extent.height) {
+			m_dropped++;
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_free.empty()) {
+			m_dropped++;
+			return false;
+		}
+		m_current = static_cast<int>(m_free.front());
+		m_free.pop_front();
+		return true;
+	}
+
+	/*
+	Copies the image (in TRANSFER_SRC_OPTIMAL layout) into the slot of the frame
+	*/
+	void record(VkCommandBuffer commandBuffer, VkImage image) const {
+		if (m_current < 0) {
+			return;
+		}
+		VkBufferImageCopy region = {};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0; //tightly packed
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { m_extent.width, m_extent.height, 1 };
+		vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_slots[m_current].buffer, 1, &region);
+
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = m_slots[m_current].buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	/*
+	Ties the frame copy to the timeline value of its submission
+	*/
+	void submitted(uint64_t value) {
+		if (m_current < 0) {
+			return;
+		}
+		m_inFlight.push_back({ static_cast<uint32_t>(m_current), value });
+		m_current = -1;
+	}
+
+	/*
+	Hands completed copies to the writer, throws if writing failed
+	*/
+	void collect(uint64_t completedValue) {
+		while (!m_inFlight.empty() && m_inFlight.front().value <= completedValue) {
+			uint32_t slot = m_inFlight.front().slot;
+			m_inFlight.pop_front();
+			if (!m_coherent) {
+				VkMappedMemoryRange range = {};
+				range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+				range.memory = m_slots[slot].memory;
+				range.offset = 0;
+				range.size = VK_WHOLE_SIZE;
+				vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+			}
+			m_writer.write(m_slots[slot].pixels, slot);
+			m_captured++;
+		}
+
+		std::string error = m_writer.error();
+		if (!error.empty()) {
+			throw std::runtime_error(error);
+		}
+	}
+
+	/*
+	Number of frames handed to the writer so far
+	*/
+	uint64_t captured() const {
+		return m_captured;
+	}
+
+	uint64_t dropped() const {
+		return m_dropped;
+	}
+
+	uint64_t mismatches() {
+		return m_writer.mismatches();
+	}
+
+	/*
+	Writes the frames still in flight and releases buffers, the GPU must be idle
+	*/
+	void cleanup() {
+		if (m_slots.empty()) {
+			return;
+		}
+		collect(UINT64_MAX);
+		m_writer.close();
+		for (Slot& slot : m_slots) {
+			vkUnmapMemory(m_device, slot.memory);
+			vkDestroyBuffer(m_device, slot.buffer, nullptr);
+			vkFreeMemory(m_device, slot.memory, nullptr);
+		}
+		m_slots.clear();
+		m_free.clear();
+	}
+
+private:
+	struct Slot {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		const uint8_t* pixels = nullptr;
+	};
+
+	struct InFlight {
+		uint32_t slot;
+		uint64_t value;
+	};
+
+	VkDevice				m_device = VK_NULL_HANDLE;
+	CaptureOptions			m_options;
+	VkExtent2D				m_extent = {};
+	bool					m_bgra = true;
+	bool					m_coherent = true;
+	std::vector<Slot>		m_slots;
+	std::mutex				m_mutex; //free slots are returned by the writer thread
+	std::deque<uint32_t>	m_free;
+	std::deque<InFlight>	m_inFlight;
+	int						m_current = -1;
+	uint64_t				m_captured = 0;
+	uint64_t				m_dropped = 0;
+	FrameWriter				m_writer;
+};
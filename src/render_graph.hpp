@@ -0,0 +1,601 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+typedef uint32_t RenderResource;
+
+/*
+How a pass touches an image. Each usage implies image layout,
+pipeline stages and accesses, barriers are derived from these
+*/
+enum class RenderUsage {
+	ColorAttachment,
+	DepthAttachment,
+	FragmentSampled,
+	ComputeSampled,
+	ComputeStorage,
+	TransferSource,
+	TransferDestination,
+	Present
+};
+
+struct RenderUsageState {
+	VkImageLayout layout;
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkImageUsageFlags imageUsage;
+	bool write;
+};
+
+inline RenderUsageState renderUsageState(RenderUsage usage, bool write) {
+	switch (usage) {
+	case RenderUsage::ColorAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | (write ? static_cast<VkAccessFlags>(VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT) : 0u), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, write };
+	case RenderUsage::DepthAttachment:
+		return { write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (write ? static_cast<VkAccessFlags>(VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT) : 0u), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, write };
+	case RenderUsage::FragmentSampled:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+	case RenderUsage::ComputeSampled:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+	case RenderUsage::ComputeStorage:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT | (write ? static_cast<VkAccessFlags>(VK_ACCESS_SHADER_WRITE_BIT) : 0u), VK_IMAGE_USAGE_STORAGE_BIT, write };
+	case RenderUsage::TransferSource:
+		return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false };
+	case RenderUsage::TransferDestination:
+		return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true };
+	case RenderUsage::Present:
+	default:
+		return { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, false };
+	}
+}
+
+/*
+Transient image owned by the graph, usage flags are collected from the passes
+*/
+struct RenderImageDesc {
+	VkFormat format;
+	VkExtent2D extent;
+	VkImageAspectFlags aspect;
+};
+
+struct RenderGraphStats {
+	uint32_t passes = 0;
+	uint32_t culledPasses = 0;
+	uint32_t barriers = 0; //image barriers recorded per frame
+	uint32_t barrierBatches = 0; //vkCmdPipelineBarrier calls per frame
+	uint32_t transientImages = 0;
+	uint32_t memoryBlocks = 0;
+	VkDeviceSize transientBytes = 0; //memory allocated for transient images
+	VkDeviceSize unaliasedBytes = 0; //what they would take without aliasing
+};
+
+/*
+Frame described as passes declaring which images they read and write.
+compile culls passes whose results are never used, places transient images
+with disjoint lifetimes into shared memory and derives the barriers and layout
+transitions between passes. execute then only records them with the passes.
+Graph is compiled once per swapchain, imported images (swapchain) are set per frame
+*/
+class RenderGraph {
+public:
+	class PassBuilder {
+	public:
+		void read(RenderResource resource, RenderUsage usage) {
+			access(resource, usage, false);
+		}
+
+		void write(RenderResource resource, RenderUsage usage) {
+			access(resource, usage, true);
+		}
+
+		/*
+		Pass is kept even when nothing reads its results
+		*/
+		void sideEffect() {
+			m_graph.m_passes[m_pass].sideEffect = true;
+		}
+
+	private:
+		friend class RenderGraph;
+
+		PassBuilder(RenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {
+		}
+
+		void access(RenderResource resource, RenderUsage usage, bool write) {
+			if (resource >= m_graph.m_resources.size()) {
+				throw std::runtime_error("ERROR: Render pass " + m_graph.m_passes[m_pass].name + " uses unknown resource!");
+			}
+			for (const auto& existing : m_graph.m_passes[m_pass].accesses) {
+				if (existing.resource == resource) {
+					throw std::runtime_error("ERROR: Render pass " + m_graph.m_passes[m_pass].name + " uses " + m_graph.m_resources[resource].name + " twice!");
+				}
+			}
+			m_graph.m_passes[m_pass].accesses.push_back({ resource, renderUsageState(usage, write) });
+		}
+
+		RenderGraph& m_graph;
+		uint32_t m_pass;
+	};
+
+	void init(VkDevice device, std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)> findMemoryType) {
+		m_device = device;
+		m_findMemoryType = std::move(findMemoryType);
+	}
+
+	RenderResource createImage(const char* name, const RenderImageDesc& desc) {
+		Resource resource;
+		resource.name = name;
+		resource.desc = desc;
+		m_resources.push_back(resource);
+		return static_cast<RenderResource>(m_resources.size() - 1);
+	}
+
+	/*
+	Image living outside of the graph. Its contents at the start of the frame
+	are in initialLayout, written by initialStages (eg. swapchain image waited for
+	at color output stage by the acquire semaphore)
+	*/
+	RenderResource importImage(const char* name, VkImageAspectFlags aspect, VkImageLayout initialLayout, VkPipelineStageFlags initialStages) {
+		Resource resource;
+		resource.name = name;
+		resource.imported = true;
+		resource.desc.aspect = aspect;
+		resource.initialState = { initialLayout, initialStages, 0, 0, false };
+		m_resources.push_back(resource);
+		return static_cast<RenderResource>(m_resources.size() - 1);
+	}
+
+	/*
+	Resource is used after the graph, passes producing it are kept
+	and it ends the frame transitioned for given usage
+	*/
+	void setOutput(RenderResource resource, RenderUsage usage) {
+		m_resources[resource].output = true;
+		m_resources[resource].finalState = renderUsageState(usage, false);
+	}
+
+	void addPass(const char* name, const std::function<void(PassBuilder&)>& setup, std::function<void(VkCommandBuffer)> execute) {
+		Pass pass;
+		pass.name = name;
+		pass.execute = std::move(execute);
+		m_passes.push_back(std::move(pass));
+
+		PassBuilder builder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+		setup(builder);
+	}
+
+	void compile() {
+		cullPasses();
+		createTransientImages();
+		buildBarriers();
+	}
+
+	/*
+	Sets image of imported resource for the frame being recorded
+	*/
+	void setImage(RenderResource resource, VkImage image, VkImageView view) {
+		m_resources[resource].image = image;
+		m_resources[resource].view = view;
+	}
+
+	/*
+	Called around commands of each pass, ie. to label them for debugging tools
+	*/
+	void setPassLabels(std::function<void(VkCommandBuffer, const char*)> begin, std::function<void(VkCommandBuffer)> end) {
+		m_beginPassLabel = std::move(begin);
+		m_endPassLabel = std::move(end);
+	}
+
+	void execute(VkCommandBuffer commandBuffer) const {
+		for (const auto& pass : m_passes) {
+			if (pass.live) {
+				if (m_beginPassLabel) {
+					m_beginPassLabel(commandBuffer, pass.name.c_str());
+				}
+				recordBarriers(commandBuffer, pass.barriers);
+				pass.execute(commandBuffer);
+				if (m_endPassLabel) {
+					m_endPassLabel(commandBuffer);
+				}
+			}
+		}
+		recordBarriers(commandBuffer, m_finalBarriers);
+	}
+
+	VkImage image(RenderResource resource) const {
+		return m_resources[resource].image;
+	}
+
+	VkImageView view(RenderResource resource) const {
+		return m_resources[resource].view;
+	}
+
+	const RenderGraphStats& stats() const {
+		return m_stats;
+	}
+
+	/*
+	Destroys transient images and forgets all passes and resources,
+	graph is declared again (eg. after swapchain recreation)
+	*/
+	void cleanup() {
+		for (auto& resource : m_resources) {
+			if (!resource.imported) {
+				if (resource.view != VK_NULL_HANDLE) {
+					vkDestroyImageView(m_device, resource.view, nullptr);
+				}
+				if (resource.image != VK_NULL_HANDLE) {
+					vkDestroyImage(m_device, resource.image, nullptr);
+				}
+			}
+		}
+		for (auto& block : m_blocks) {
+			vkFreeMemory(m_device, block.memory, nullptr);
+		}
+		m_resources.clear();
+		m_passes.clear();
+		m_blocks.clear();
+		m_finalBarriers = BarrierBatch();
+		m_stats = RenderGraphStats();
+	}
+
+private:
+	struct Access {
+		RenderResource resource;
+		RenderUsageState state;
+	};
+
+	struct ImageBarrier {
+		RenderResource resource;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+	};
+
+	struct BarrierBatch {
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<ImageBarrier> images;
+	};
+
+	struct Pass {
+		std::string name;
+		std::function<void(VkCommandBuffer)> execute;
+		std::vector<Access> accesses;
+		bool sideEffect = false;
+		bool live = false;
+		BarrierBatch barriers;
+	};
+
+	struct Resource {
+		std::string name;
+		RenderImageDesc desc = {};
+		bool imported = false;
+		bool output = false;
+		RenderUsageState initialState = { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, false };
+		RenderUsageState finalState = { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, false };
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		//Live pass range using the resource, transient ones only exist during it
+		uint32_t firstPass = UINT32_MAX;
+		uint32_t lastPass = 0;
+		VkImageUsageFlags usage = 0;
+		VkMemoryRequirements requirements = {};
+		uint32_t block = UINT32_MAX;
+	};
+
+	/*
+	Transient images with disjoint lifetimes placed at the start of one allocation
+	*/
+	struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeBits = 0;
+		std::vector<RenderResource> tenants;
+	};
+
+	/*
+	Synchronization state of a resource while walking the passes
+	*/
+	struct TrackedState {
+		VkImageLayout layout;
+		VkPipelineStageFlags writeStages; //last write, or layout transition
+		VkAccessFlags writeAccess;
+		VkPipelineStageFlags readStages; //reads since the last write
+		VkPipelineStageFlags visibleStages; //stages the last write was made visible to
+	};
+
+	/*
+	Walks passes backwards: a pass is live if it has side effects or writes
+	something a live pass or the frame output reads
+	*/
+	void cullPasses() {
+		std::vector<bool> needed(m_resources.size(), false);
+		for (size_t i = 0; i < m_resources.size(); i++) {
+			needed[i] = m_resources[i].output;
+		}
+
+		m_stats.passes = 0;
+		m_stats.culledPasses = 0;
+		for (size_t p = m_passes.size(); p-- > 0;) {
+			Pass& pass = m_passes[p];
+			pass.live = pass.sideEffect;
+			for (const auto& access : pass.accesses) {
+				pass.live |= access.state.write && needed[access.resource];
+			}
+			if (pass.live) {
+				for (const auto& access : pass.accesses) {
+					//Written attachments are usually loaded as well, their producers stay
+					needed[access.resource] = true;
+				}
+				m_stats.passes++;
+			}
+			else {
+				m_stats.culledPasses++;
+			}
+		}
+
+		uint32_t order = 0;
+		for (auto& pass : m_passes) {
+			if (!pass.live) {
+				continue;
+			}
+			for (const auto& access : pass.accesses) {
+				Resource& resource = m_resources[access.resource];
+				resource.firstPass = std::min(resource.firstPass, order);
+				resource.lastPass = std::max(resource.lastPass, order);
+				resource.usage |= access.state.imageUsage;
+			}
+			order++;
+		}
+	}
+
+	/*
+	Creates images used by live passes and aliases them: largest first, each goes
+	into the first block with compatible memory type whose tenants are not alive
+	at the same time, otherwise it opens a new block
+	*/
+	void createTransientImages() {
+		std::vector<RenderResource> transient;
+		for (RenderResource id = 0; id < m_resources.size(); id++) {
+			Resource& resource = m_resources[id];
+			if (resource.imported || resource.firstPass == UINT32_MAX) {
+				continue;
+			}
+
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = resource.desc.format;
+			imageInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = resource.usage;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(m_device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to create render graph image " + resource.name + "!");
+			}
+			vkGetImageMemoryRequirements(m_device, resource.image, &resource.requirements);
+			m_stats.unaliasedBytes += resource.requirements.size;
+			transient.push_back(id);
+		}
+
+		std::stable_sort(transient.begin(), transient.end(), [this](RenderResource a, RenderResource b) {
+			return m_resources[a].requirements.size > m_resources[b].requirements.size;
+		});
+
+		for (RenderResource id : transient) {
+			Resource& resource = m_resources[id];
+			for (uint32_t b = 0; b < m_blocks.size() && resource.block == UINT32_MAX; b++) {
+				MemoryBlock& block = m_blocks[b];
+				bool overlaps = false;
+				for (RenderResource tenant : block.tenants) {
+					overlaps |= resource.firstPass <= m_resources[tenant].lastPass && m_resources[tenant].firstPass <= resource.lastPass;
+				}
+				if (!overlaps && (block.memoryTypeBits & resource.requirements.memoryTypeBits) != 0) {
+					resource.block = b;
+				}
+			}
+			if (resource.block == UINT32_MAX) {
+				resource.block = static_cast<uint32_t>(m_blocks.size());
+				m_blocks.push_back(MemoryBlock());
+				m_blocks.back().memoryTypeBits = resource.requirements.memoryTypeBits;
+			}
+
+			MemoryBlock& block = m_blocks[resource.block];
+			block.size = std::max(block.size, resource.requirements.size);
+			block.memoryTypeBits &= resource.requirements.memoryTypeBits;
+			block.tenants.push_back(id);
+		}
+
+		for (auto& block : m_blocks) {
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = block.size;
+			allocInfo.memoryTypeIndex = m_findMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			if (vkAllocateMemory(m_device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to allocate render graph memory!");
+			}
+			m_stats.transientBytes += block.size;
+
+			//Tenants in order of use, barriers chain each one after the previous
+			std::sort(block.tenants.begin(), block.tenants.end(), [this](RenderResource a, RenderResource b) {
+				return m_resources[a].firstPass < m_resources[b].firstPass;
+			});
+			for (RenderResource id : block.tenants) {
+				Resource& resource = m_resources[id];
+				vkBindImageMemory(m_device, resource.image, block.memory, 0);
+
+				VkImageViewCreateInfo viewInfo = {};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = resource.image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.desc.format;
+				viewInfo.subresourceRange.aspectMask = resource.desc.aspect;
+				viewInfo.subresourceRange.baseMipLevel = 0;
+				viewInfo.subresourceRange.levelCount = 1;
+				viewInfo.subresourceRange.baseArrayLayer = 0;
+				viewInfo.subresourceRange.layerCount = 1;
+
+				if (vkCreateImageView(m_device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+					throw std::runtime_error("ERROR: Failed to create render graph image view " + resource.name + "!");
+				}
+			}
+		}
+		m_stats.transientImages = static_cast<uint32_t>(transient.size());
+		m_stats.memoryBlocks = static_cast<uint32_t>(m_blocks.size());
+	}
+
+	/*
+	Barrier is needed for a layout change, for a write after any access and for
+	a read from stages the last write was not yet made visible to. Reads of the
+	same layout otherwise share one barrier. Transient images start undefined,
+	after whatever last used their memory (previous tenant, or the previous frame)
+	*/
+	void buildBarriers() {
+		std::vector<TrackedState> states(m_resources.size());
+		for (RenderResource id = 0; id < m_resources.size(); id++) {
+			const Resource& resource = m_resources[id];
+			VkPipelineStageFlags previousStages = resource.initialState.stages;
+			if (resource.block != UINT32_MAX) {
+				const MemoryBlock& block = m_blocks[resource.block];
+				auto tenant = std::find(block.tenants.begin(), block.tenants.end(), id);
+				RenderResource previous = tenant == block.tenants.begin() ? block.tenants.back() : *(tenant - 1);
+				previousStages = lastStages(previous);
+			}
+			states[id] = { resource.initialState.layout, previousStages, 0, 0, 0 };
+		}
+
+		m_stats.barriers = 0;
+		m_stats.barrierBatches = 0;
+		for (auto& pass : m_passes) {
+			pass.barriers = BarrierBatch();
+			if (!pass.live) {
+				continue;
+			}
+			for (const auto& access : pass.accesses) {
+				transition(states[access.resource], access.resource, access.state, pass.barriers);
+			}
+			countBatch(pass.barriers);
+		}
+
+		m_finalBarriers = BarrierBatch();
+		for (RenderResource id = 0; id < m_resources.size(); id++) {
+			if (m_resources[id].output) {
+				transition(states[id], id, m_resources[id].finalState, m_finalBarriers);
+			}
+		}
+		countBatch(m_finalBarriers);
+	}
+
+	void transition(TrackedState& state, RenderResource resource, const RenderUsageState& usage, BarrierBatch& batch) {
+		bool layoutChange = state.layout != usage.layout;
+		bool hazard = usage.write || (usage.stages & ~state.visibleStages) != 0;
+		if (!layoutChange && !hazard) {
+			state.readStages |= usage.stages;
+			return;
+		}
+
+		batch.srcStages |= state.writeStages | state.readStages;
+		batch.dstStages |= usage.stages;
+		batch.images.push_back({ resource, state.layout, usage.layout, state.writeAccess, usage.access });
+
+		if (usage.write || layoutChange) {
+			state.writeStages = usage.stages;
+			state.writeAccess = usage.write ? usage.access : 0;
+			state.visibleStages = usage.stages;
+			state.readStages = usage.write ? 0 : usage.stages;
+		}
+		else {
+			state.visibleStages |= usage.stages;
+			state.readStages |= usage.stages;
+		}
+		state.layout = usage.layout;
+	}
+
+	void countBatch(const BarrierBatch& batch) {
+		if (!batch.images.empty()) {
+			m_stats.barriers += static_cast<uint32_t>(batch.images.size());
+			m_stats.barrierBatches++;
+		}
+	}
+
+	/*
+	Stages of the last live pass using a transient resource
+	*/
+	VkPipelineStageFlags lastStages(RenderResource resource) const {
+		VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		for (const auto& pass : m_passes) {
+			if (!pass.live) {
+				continue;
+			}
+			for (const auto& access : pass.accesses) {
+				if (access.resource == resource) {
+					stages = access.state.stages;
+				}
+			}
+		}
+		return stages;
+	}
+
+	void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const {
+		if (batch.images.empty()) {
+			return;
+		}
+
+		VkImageMemoryBarrier barriers[16];
+		uint32_t count = 0;
+		for (const auto& image : batch.images) {
+			VkImageMemoryBarrier& barrier = barriers[count++];
+			barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = image.srcAccess;
+			barrier.dstAccessMask = image.dstAccess;
+			barrier.oldLayout = image.oldLayout;
+			barrier.newLayout = image.newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = m_resources[image.resource].image;
+			barrier.subresourceRange.aspectMask = m_resources[image.resource].desc.aspect;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+			if (count == 16) {
+				vkCmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0, 0, nullptr, 0, nullptr, count, barriers);
+				count = 0;
+			}
+		}
+		if (count > 0) {
+			vkCmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0, 0, nullptr, 0, nullptr, count, barriers);
+		}
+	}
+
+	VkDevice							m_device = VK_NULL_HANDLE;
+	std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)>	m_findMemoryType;
+	std::vector<Resource>				m_resources;
+	std::vector<Pass>					m_passes;
+	std::vector<MemoryBlock>			m_blocks;
+	BarrierBatch						m_finalBarriers;
+	RenderGraphStats					m_stats;
+	std::function<void(VkCommandBuffer, const char*)>	m_beginPassLabel;
+	std::function<void(VkCommandBuffer)>	m_endPassLabel;
+};
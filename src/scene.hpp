@@ -0,0 +1,416 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define SCENE_USE_SSE 1
+#endif
+
+#include "thread_pool.hpp"
+
+/*
+Nodes per parallel task, kept a multiple of 4 for the SSE path
+*/
+const size_t SCENE_UPDATE_CHUNK_SIZE = 4096;
+
+/*
+Stable node handle, returned by Scene::addNode.
+Nodes are reordered internally, so handles and array indices differ
+*/
+typedef uint32_t SceneNode;
+const SceneNode SCENE_NO_PARENT = ~0u;
+
+/*
+Draw state of nodes which are only transforms
+*/
+const uint64_t DRAW_STATE_NONE = ~0ull;
+
+/*
+Axis aligned boxes as structure of arrays
+*/
+struct SceneBounds {
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+
+	void push(const glm::vec3& center, const glm::vec3& extent) {
+		centerX.push_back(center.x);
+		centerY.push_back(center.y);
+		centerZ.push_back(center.z);
+		extentX.push_back(extent.x);
+		extentY.push_back(extent.y);
+		extentZ.push_back(extent.z);
+	}
+};
+
+/*
+Transform hierarchy stored as structure of arrays.
+Nodes are kept sorted by depth, so every parent precedes its children
+and each depth level is one contiguous range. Update walks levels in order
+and splits each level into chunks processed in parallel, writing world
+matrices both into the scene and straight into mapped GPU memory
+*/
+class Scene {
+public:
+	SceneNode addNode(SceneNode parent = SCENE_NO_PARENT) {
+		uint32_t parentIndex = SCENE_NO_PARENT;
+		uint32_t depth = 0;
+		if (parent != SCENE_NO_PARENT) {
+			if (parent >= m_handleToIndex.size()) {
+				throw std::runtime_error("ERROR: Scene node has invalid parent!");
+			}
+			parentIndex = m_handleToIndex[parent];
+			depth = m_depth[parentIndex] + 1;
+		}
+
+		//Appending keeps depth order unless the new node is shallower than the last one
+		if (!m_depth.empty() && depth < m_depth.back()) {
+			m_sorted = false;
+		}
+		m_levelsValid = false;
+
+		SceneNode handle = static_cast<SceneNode>(m_handleToIndex.size());
+		m_handleToIndex.push_back(static_cast<uint32_t>(m_indexToHandle.size()));
+		m_indexToHandle.push_back(handle);
+		m_parent.push_back(parentIndex);
+		m_depth.push_back(depth);
+
+		m_translationX.push_back(0.0f);
+		m_translationY.push_back(0.0f);
+		m_translationZ.push_back(0.0f);
+		m_rotationX.push_back(0.0f);
+		m_rotationY.push_back(0.0f);
+		m_rotationZ.push_back(0.0f);
+		m_rotationW.push_back(1.0f);
+		m_scaleX.push_back(1.0f);
+		m_scaleY.push_back(1.0f);
+		m_scaleZ.push_back(1.0f);
+		m_localBounds.push(glm::vec3(0.0f), glm::vec3(0.0f));
+		m_drawState.push_back(DRAW_STATE_NONE);
+		m_worldBounds.push(glm::vec3(0.0f), glm::vec3(0.0f));
+		m_world.push_back(glm::mat4(1.0f));
+
+		return handle;
+	}
+
+	size_t size() const {
+		return m_parent.size();
+	}
+
+	void setTranslation(SceneNode node, const glm::vec3& translation) {
+		uint32_t i = m_handleToIndex[node];
+		m_translationX[i] = translation.x;
+		m_translationY[i] = translation.y;
+		m_translationZ[i] = translation.z;
+	}
+
+	void setRotation(SceneNode node, const glm::quat& rotation) {
+		uint32_t i = m_handleToIndex[node];
+		m_rotationX[i] = rotation.x;
+		m_rotationY[i] = rotation.y;
+		m_rotationZ[i] = rotation.z;
+		m_rotationW[i] = rotation.w;
+	}
+
+	void setScale(SceneNode node, const glm::vec3& scale) {
+		uint32_t i = m_handleToIndex[node];
+		m_scaleX[i] = scale.x;
+		m_scaleY[i] = scale.y;
+		m_scaleZ[i] = scale.z;
+	}
+
+	void setLocalBounds(SceneNode node, const glm::vec3& center, const glm::vec3& extent) {
+		uint32_t i = m_handleToIndex[node];
+		m_localBounds.centerX[i] = center.x;
+		m_localBounds.centerY[i] = center.y;
+		m_localBounds.centerZ[i] = center.z;
+		m_localBounds.extentX[i] = extent.x;
+		m_localBounds.extentY[i] = extent.y;
+		m_localBounds.extentZ[i] = extent.z;
+	}
+
+	/*
+	Sort key of the node's draw, see makeDrawStateKey in visibility.hpp
+	*/
+	void setDrawState(SceneNode node, uint64_t drawState) {
+		m_drawState[m_handleToIndex[node]] = drawState;
+	}
+
+	/*
+	Index of the node in world arrays and in the GPU object buffer
+	*/
+	uint32_t index(SceneNode node) const {
+		return m_handleToIndex[node];
+	}
+
+	SceneNode handle(uint32_t index) const {
+		return m_indexToHandle[index];
+	}
+
+	const glm::mat4& worldMatrix(SceneNode node) const {
+		return m_world[m_handleToIndex[node]];
+	}
+
+	const std::vector<glm::mat4>& worldMatrices() const {
+		return m_world;
+	}
+
+	const SceneBounds& worldBounds() const {
+		return m_worldBounds;
+	}
+
+	const std::vector<uint64_t>& drawStates() const {
+		return m_drawState;
+	}
+
+	/*
+	Recomputes world matrices and bounds of all nodes.
+	If gpuObjects is given, world matrices are also copied there
+	in node index order, eg. into a mapped storage buffer
+	*/
+	void update(ThreadPool& pool, glm::mat4* gpuObjects = nullptr) {
+		if (!m_sorted) {
+			sortByDepth();
+		}
+		if (!m_levelsValid) {
+			buildLevels();
+		}
+
+		for (size_t level = 0; level + 1 < m_levels.size(); level++) {
+			const size_t levelBegin = m_levels[level];
+			pool.parallelFor(m_levels[level + 1] - levelBegin, SCENE_UPDATE_CHUNK_SIZE, [this, levelBegin, gpuObjects](size_t begin, size_t end) {
+				updateRange(levelBegin + begin, levelBegin + end, gpuObjects);
+			});
+		}
+	}
+
+private:
+	template<typename T>
+	static void permute(std::vector<T>& values, const std::vector<uint32_t>& order) {
+		std::vector<T> result(values.size());
+		for (size_t i = 0; i < order.size(); i++) {
+			result[i] = values[order[i]];
+		}
+		values.swap(result);
+	}
+
+	/*
+	Stable counting sort of all arrays by depth
+	*/
+	void sortByDepth() {
+		uint32_t maxDepth = *std::max_element(m_depth.begin(), m_depth.end());
+		std::vector<uint32_t> offsets(maxDepth + 2, 0);
+		for (uint32_t depth : m_depth) {
+			offsets[depth + 1]++;
+		}
+		for (size_t d = 1; d < offsets.size(); d++) {
+			offsets[d] += offsets[d - 1];
+		}
+
+		std::vector<uint32_t> order(size()); //new index -> old index
+		std::vector<uint32_t> remap(size()); //old index -> new index
+		for (uint32_t i = 0; i < size(); i++) {
+			uint32_t newIndex = offsets[m_depth[i]]++;
+			order[newIndex] = i;
+			remap[i] = newIndex;
+		}
+
+		for (auto& parent : m_parent) {
+			if (parent != SCENE_NO_PARENT) {
+				parent = remap[parent];
+			}
+		}
+		permute(m_parent, order);
+		permute(m_depth, order);
+		permute(m_indexToHandle, order);
+		permute(m_drawState, order);
+		for (auto stream : { &m_translationX, &m_translationY, &m_translationZ, &m_rotationX, &m_rotationY, &m_rotationZ, &m_rotationW,
+			&m_scaleX, &m_scaleY, &m_scaleZ, &m_localBounds.centerX, &m_localBounds.centerY, &m_localBounds.centerZ,
+			&m_localBounds.extentX, &m_localBounds.extentY, &m_localBounds.extentZ }) {
+			permute(*stream, order);
+		}
+		for (uint32_t i = 0; i < size(); i++) {
+			m_handleToIndex[m_indexToHandle[i]] = i;
+		}
+
+		m_sorted = true;
+	}
+
+	/*
+	m_levels[d] is the first node of depth d, last entry is node count
+	*/
+	void buildLevels() {
+		m_levels.clear();
+		for (size_t i = 0; i < size(); i++) {
+			while (m_levels.size() <= m_depth[i]) {
+				m_levels.push_back(i);
+			}
+		}
+		m_levels.push_back(size());
+
+		m_levelsValid = true;
+	}
+
+	void updateRange(size_t begin, size_t end, glm::mat4* gpuObjects) {
+		size_t i = begin;
+#ifdef SCENE_USE_SSE
+		for (; i + 4 <= end; i += 4) {
+			composeLocal4(i);
+		}
+#endif
+		for (; i < end; i++) {
+			composeLocal(i);
+		}
+
+		for (i = begin; i < end; i++) {
+			if (m_parent[i] != SCENE_NO_PARENT) {
+				multiplyParent(i);
+			}
+		}
+
+		for (i = begin; i < end; i++) {
+			transformBounds(i);
+		}
+
+		if (gpuObjects) {
+			memcpy(gpuObjects + begin, &m_world[begin], (end - begin) * sizeof(glm::mat4));
+		}
+	}
+
+	/*
+	Local matrix = translation * rotation * scale
+	*/
+	void composeLocal(size_t i) {
+		float x = m_rotationX[i], y = m_rotationY[i], z = m_rotationZ[i], w = m_rotationW[i];
+		float sx = m_scaleX[i], sy = m_scaleY[i], sz = m_scaleZ[i];
+
+		glm::mat4& m = m_world[i];
+		m[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y + w * z) * sx, 2.0f * (x * z - w * y) * sx, 0.0f);
+		m[1] = glm::vec4(2.0f * (x * y - w * z) * sy, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z + w * x) * sy, 0.0f);
+		m[2] = glm::vec4(2.0f * (x * z + w * y) * sz, 2.0f * (y * z - w * x) * sz, (1.0f - 2.0f * (x * x + y * y)) * sz, 0.0f);
+		m[3] = glm::vec4(m_translationX[i], m_translationY[i], m_translationZ[i], 1.0f);
+	}
+
+	void multiplyParent(size_t i) {
+#ifdef SCENE_USE_SSE
+		const float* parent = &m_world[m_parent[i]][0][0];
+		float* local = &m_world[i][0][0];
+		__m128 p0 = _mm_loadu_ps(parent);
+		__m128 p1 = _mm_loadu_ps(parent + 4);
+		__m128 p2 = _mm_loadu_ps(parent + 8);
+		__m128 p3 = _mm_loadu_ps(parent + 12);
+		for (int column = 0; column < 4; column++) {
+			const float* l = local + column * 4;
+			__m128 result = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(l[0])), _mm_mul_ps(p1, _mm_set1_ps(l[1]))),
+				_mm_add_ps(_mm_mul_ps(p2, _mm_set1_ps(l[2])), _mm_mul_ps(p3, _mm_set1_ps(l[3]))));
+			_mm_storeu_ps(local + column * 4, result);
+		}
+#else
+		m_world[i] = m_world[m_parent[i]] * m_world[i];
+#endif
+	}
+
+#ifdef SCENE_USE_SSE
+	/*
+	composeLocal for 4 consecutive nodes, SoA inputs map directly onto SSE lanes
+	*/
+	void composeLocal4(size_t i) {
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		__m128 x = _mm_loadu_ps(&m_rotationX[i]);
+		__m128 y = _mm_loadu_ps(&m_rotationY[i]);
+		__m128 z = _mm_loadu_ps(&m_rotationZ[i]);
+		__m128 w = _mm_loadu_ps(&m_rotationW[i]);
+		__m128 sx = _mm_loadu_ps(&m_scaleX[i]);
+		__m128 sy = _mm_loadu_ps(&m_scaleY[i]);
+		__m128 sz = _mm_loadu_ps(&m_scaleZ[i]);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 columns[4][4];
+		columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		columns[0][3] = _mm_setzero_ps();
+		columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		columns[1][3] = _mm_setzero_ps();
+		columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		columns[2][3] = _mm_setzero_ps();
+		columns[3][0] = _mm_loadu_ps(&m_translationX[i]);
+		columns[3][1] = _mm_loadu_ps(&m_translationY[i]);
+		columns[3][2] = _mm_loadu_ps(&m_translationZ[i]);
+		columns[3][3] = one;
+
+		//Transposing turns one component of 4 nodes into 4 components of one node
+		for (int column = 0; column < 4; column++) {
+			_MM_TRANSPOSE4_PS(columns[column][0], columns[column][1], columns[column][2], columns[column][3]);
+			for (int node = 0; node < 4; node++) {
+				_mm_storeu_ps(&m_world[i + node][column][0], columns[column][node]);
+			}
+		}
+	}
+#endif
+
+	/*
+	Box under affine transform: center is transformed, extents are
+	projected onto world axes through absolute values of the matrix (Arvo)
+	*/
+	void transformBounds(size_t i) {
+		const glm::mat4& m = m_world[i];
+		float cx = m_localBounds.centerX[i], cy = m_localBounds.centerY[i], cz = m_localBounds.centerZ[i];
+		float ex = m_localBounds.extentX[i], ey = m_localBounds.extentY[i], ez = m_localBounds.extentZ[i];
+
+		m_worldBounds.centerX[i] = m[0][0] * cx + m[1][0] * cy + m[2][0] * cz + m[3][0];
+		m_worldBounds.centerY[i] = m[0][1] * cx + m[1][1] * cy + m[2][1] * cz + m[3][1];
+		m_worldBounds.centerZ[i] = m[0][2] * cx + m[1][2] * cy + m[2][2] * cz + m[3][2];
+		m_worldBounds.extentX[i] = std::abs(m[0][0]) * ex + std::abs(m[1][0]) * ey + std::abs(m[2][0]) * ez;
+		m_worldBounds.extentY[i] = std::abs(m[0][1]) * ex + std::abs(m[1][1]) * ey + std::abs(m[2][1]) * ez;
+		m_worldBounds.extentZ[i] = std::abs(m[0][2]) * ex + std::abs(m[1][2]) * ey + std::abs(m[2][2]) * ez;
+	}
+
+	//Hierarchy
+	std::vector<uint32_t>	m_parent;
+	std::vector<uint32_t>	m_depth;
+	std::vector<uint32_t>	m_handleToIndex;
+	std::vector<SceneNode>	m_indexToHandle;
+	std::vector<size_t>		m_levels;
+	bool					m_sorted = true;
+	bool					m_levelsValid = false;
+
+	//Local transforms
+	std::vector<float>		m_translationX;
+	std::vector<float>		m_translationY;
+	std::vector<float>		m_translationZ;
+	std::vector<float>		m_rotationX;
+	std::vector<float>		m_rotationY;
+	std::vector<float>		m_rotationZ;
+	std::vector<float>		m_rotationW;
+	std::vector<float>		m_scaleX;
+	std::vector<float>		m_scaleY;
+	std::vector<float>		m_scaleZ;
+	SceneBounds				m_localBounds;
+	std::vector<uint64_t>	m_drawState;
+
+	//Results
+	std::vector<glm::mat4>	m_world;
+	SceneBounds				m_worldBounds;
+};
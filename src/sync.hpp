@@ -0,0 +1,293 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <iterator>
+#include <cstdint>
+
+/*
+Completion of GPU work as one monotonically increasing value.
+Every submission made through the timeline signals the next value,
+CPU code waits for or polls exactly the value it depends on instead of
+idling whole queues, and callbacks retire resources once their value completed.
+Uses a VK_KHR_timeline_semaphore when the device supports it, otherwise
+a fence per submission (values still complete in submission order)
+*/
+class GpuTimeline {
+public:
+	void init(VkDevice device, bool timelineSemaphore) {
+		m_device = device;
+		m_submitted = 0;
+		m_completed = 0;
+		m_timelineSemaphore = false;
+#ifdef VK_KHR_timeline_semaphore
+		if (timelineSemaphore) {
+			m_getCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+			m_waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+			m_timelineSemaphore = m_getCounterValue && m_waitSemaphores;
+		}
+		if (m_timelineSemaphore) {
+			VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			typeInfo.initialValue = 0;
+
+			VkSemaphoreCreateInfo createInfo = {};
+			createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			createInfo.pNext = &typeInfo;
+
+			if (vkCreateSemaphore(m_device, &createInfo, nullptr, &m_semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("ERROR: Failed to create timeline semaphore!");
+			}
+		}
+#else
+		(void)timelineSemaphore;
+#endif
+	}
+
+	/*
+	Runs remaining callbacks, the GPU must be idle
+	*/
+	void cleanup() {
+		m_completed = m_submitted;
+		for (auto& callback : takeFinishedCallbacks()) {
+			callback.function();
+		}
+		for (auto& pending : m_pendingFences) {
+			vkDestroyFence(m_device, pending.fence, nullptr);
+		}
+		for (VkFence fence : m_freeFences) {
+			vkDestroyFence(m_device, fence, nullptr);
+		}
+		m_pendingFences.clear();
+		m_freeFences.clear();
+		if (m_semaphore != VK_NULL_HANDLE) {
+			vkDestroySemaphore(m_device, m_semaphore, nullptr);
+			m_semaphore = VK_NULL_HANDLE;
+		}
+	}
+
+	/*
+	Submits one batch which signals the next timeline value and returns it.
+	Submissions are serialized, so values are signaled in order and the queue
+	gets the external synchronization it needs
+	*/
+	uint64_t submit(VkQueue queue, const VkSubmitInfo& info) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint64_t value = m_submitted + 1;
+		VkSubmitInfo submitInfo = info;
+		VkFence fence = VK_NULL_HANDLE;
+
+#ifdef VK_KHR_timeline_semaphore
+		std::vector<VkSemaphore> signalSemaphores;
+		std::vector<uint64_t> waitValues;
+		std::vector<uint64_t> signalValues;
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+		if (m_timelineSemaphore) {
+			//Binary semaphores need entries too, their values are ignored
+			signalSemaphores.assign(info.pSignalSemaphores, info.pSignalSemaphores + info.signalSemaphoreCount);
+			signalSemaphores.push_back(m_semaphore);
+			waitValues.assign(info.waitSemaphoreCount, 0);
+			signalValues.assign(info.signalSemaphoreCount, 0);
+			signalValues.push_back(value);
+
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineInfo.pNext = info.pNext;
+			timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+			timelineInfo.pWaitSemaphoreValues = waitValues.data();
+			timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+			timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+			submitInfo.pSignalSemaphores = signalSemaphores.data();
+		}
+#endif
+		if (!m_timelineSemaphore) {
+			fence = acquireFence();
+		}
+
+		VkResult result = vkQueueSubmit(queue, 1, &submitInfo, fence);
+		if (result != VK_SUCCESS) {
+			if (fence != VK_NULL_HANDLE) {
+				m_freeFences.push_back(fence);
+			}
+			throw std::runtime_error("ERROR: Failed to submit command buffer!");
+		}
+		if (fence != VK_NULL_HANDLE) {
+			m_pendingFences.push_back({ value, fence });
+		}
+		m_submitted = value;
+		return value;
+	}
+
+	/*
+	Blocks until the value completed, returns immediately for completed ones
+	*/
+	void wait(uint64_t value) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		value = std::min(value, m_submitted);
+		if (value <= m_completed) {
+			return;
+		}
+		std::vector<Callback> finished;
+#ifdef VK_KHR_timeline_semaphore
+		if (m_timelineSemaphore) {
+			VkSemaphoreWaitInfoKHR waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &m_semaphore;
+			waitInfo.pValues = &value;
+			//Other threads may submit while this one waits
+			lock.unlock();
+			m_waitSemaphores(m_device, &waitInfo, std::numeric_limits<uint64_t>::max());
+			lock.lock();
+		}
+#endif
+		if (!m_timelineSemaphore) {
+			auto pending = std::find_if(m_pendingFences.begin(), m_pendingFences.end(), [value](const PendingFence& fence) {
+				return fence.value >= value;
+			});
+			if (pending != m_pendingFences.end()) {
+				VkFence fence = pending->fence;
+				lock.unlock();
+				vkWaitForFences(m_device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+				lock.lock();
+			}
+		}
+		finished = updateCompleted();
+		lock.unlock();
+		for (auto& callback : finished) {
+			callback.function();
+		}
+	}
+
+	/*
+	Waits for everything submitted so far
+	*/
+	void waitIdle() {
+		wait(submitted());
+	}
+
+	/*
+	Polls the GPU without blocking
+	*/
+	uint64_t completed() {
+		std::vector<Callback> finished;
+		uint64_t value;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			finished = updateCompleted();
+			value = m_completed;
+		}
+		for (auto& callback : finished) {
+			callback.function();
+		}
+		return value;
+	}
+
+	bool isComplete(uint64_t value) {
+		return value <= completed();
+	}
+
+	uint64_t submitted() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_submitted;
+	}
+
+	/*
+	Calls function once the value completed. It runs on the thread which
+	noticed it in wait, completed or cleanup, without the timeline locked
+	*/
+	void onComplete(uint64_t value, std::function<void()> function) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (value > m_completed) {
+				m_callbacks.push_back({ value, std::move(function) });
+				return;
+			}
+		}
+		function();
+	}
+
+	bool usesTimelineSemaphore() const {
+		return m_timelineSemaphore;
+	}
+
+private:
+	struct PendingFence {
+		uint64_t value;
+		VkFence fence;
+	};
+
+	struct Callback {
+		uint64_t value;
+		std::function<void()> function;
+	};
+
+	VkFence acquireFence() {
+		if (!m_freeFences.empty()) {
+			VkFence fence = m_freeFences.back();
+			m_freeFences.pop_back();
+			vkResetFences(m_device, 1, &fence);
+			return fence;
+		}
+		VkFenceCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence;
+		if (vkCreateFence(m_device, &createInfo, nullptr, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create fence!");
+		}
+		return fence;
+	}
+
+	/*
+	Expects the mutex to be locked, returns callbacks to run once it is released
+	*/
+	std::vector<Callback> updateCompleted() {
+#ifdef VK_KHR_timeline_semaphore
+		if (m_timelineSemaphore) {
+			uint64_t value = 0;
+			if (m_getCounterValue(m_device, m_semaphore, &value) == VK_SUCCESS) {
+				m_completed = std::max(m_completed, value);
+			}
+		}
+#endif
+		while (!m_pendingFences.empty() && vkGetFenceStatus(m_device, m_pendingFences.front().fence) == VK_SUCCESS) {
+			m_completed = std::max(m_completed, m_pendingFences.front().value);
+			m_freeFences.push_back(m_pendingFences.front().fence);
+			m_pendingFences.pop_front();
+		}
+		return takeFinishedCallbacks();
+	}
+
+	std::vector<Callback> takeFinishedCallbacks() {
+		auto finished = std::stable_partition(m_callbacks.begin(), m_callbacks.end(), [this](const Callback& callback) {
+			return callback.value > m_completed;
+		});
+		std::vector<Callback> ready(std::make_move_iterator(finished), std::make_move_iterator(m_callbacks.end()));
+		m_callbacks.erase(finished, m_callbacks.end());
+		return ready;
+	}
+
+	VkDevice					m_device = VK_NULL_HANDLE;
+	bool						m_timelineSemaphore = false;
+	VkSemaphore					m_semaphore = VK_NULL_HANDLE;
+#ifdef VK_KHR_timeline_semaphore
+	PFN_vkGetSemaphoreCounterValueKHR	m_getCounterValue = nullptr;
+	PFN_vkWaitSemaphoresKHR		m_waitSemaphores = nullptr;
+#endif
+	std::mutex					m_mutex;
+	uint64_t					m_submitted = 0;
+	uint64_t					m_completed = 0;
+	std::deque<PendingFence>	m_pendingFences;
+	std::vector<VkFence>		m_freeFences;
+	std::vector<Callback>		m_callbacks;
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <initializer_list>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+#include "thread_pool.hpp"
+
+typedef uint32_t TaskId;
+
+/*
+Tasks with dependencies, executed on the thread pool.
+Task is submitted once all its dependencies finished, so independent
+chains overlap and the pool's work stealing balances them.
+Graph is built once and can be run repeatedly (eg. every frame),
+a run records CPU time of each task
+*/
+class TaskGraph {
+public:
+	/*
+	Dependencies must already be in the graph, so it can not contain cycles
+	*/
+	TaskId add(const char* name, std::function<void()> function, std::initializer_list<TaskId> dependencies = {}) {
+		return add(name, std::move(function), std::vector<TaskId>(dependencies));
+	}
+
+	/*
+	Dependencies collected at runtime, ie. one chain per window
+	*/
+	TaskId add(const char* name, std::function<void()> function, const std::vector<TaskId>& dependencies) {
+		TaskId id = static_cast<TaskId>(m_tasks.size());
+		m_tasks.emplace_back(new Task());
+		m_tasks.back()->name = name;
+		m_tasks.back()->function = std::move(function);
+
+		for (TaskId dependency : dependencies) {
+			if (dependency >= id) {
+				throw std::runtime_error("ERROR: Task " + std::string(name) + " depends on unknown task!");
+			}
+			m_tasks[dependency]->dependents.push_back(id);
+			m_tasks.back()->dependencyCount++;
+		}
+		return id;
+	}
+
+	/*
+	Submits tasks without dependencies, the rest follows as they become ready.
+	Calling thread is free to do other work (eg. main thread only calls) until wait
+	*/
+	void start(ThreadPool& pool) {
+		m_startTime = std::chrono::high_resolution_clock::now();
+		m_remaining = static_cast<uint32_t>(m_tasks.size());
+		m_failed = false;
+		m_exception = nullptr;
+		for (auto& task : m_tasks) {
+			task->pending = task->dependencyCount;
+		}
+
+		for (TaskId id = 0; id < m_tasks.size(); id++) {
+			if (m_tasks[id]->dependencyCount == 0) {
+				launch(pool, id);
+			}
+		}
+	}
+
+	/*
+	Executes tasks until the whole graph is done. Once a task throws,
+	tasks not yet started are skipped and the exception is rethrown here
+	*/
+	void wait(ThreadPool& pool) {
+		pool.waitUntil([this]() { return finished(); });
+		if (m_exception) {
+			std::rethrow_exception(m_exception);
+		}
+	}
+
+	void run(ThreadPool& pool) {
+		start(pool);
+		wait(pool);
+	}
+
+	bool finished() const {
+		return m_remaining == 0;
+	}
+
+	size_t size() const {
+		return m_tasks.size();
+	}
+
+	const char* name(TaskId id) const {
+		return m_tasks[id]->name;
+	}
+
+	/*
+	Time spent in the task during the last run
+	*/
+	double milliseconds(TaskId id) const {
+		return m_tasks[id]->milliseconds;
+	}
+
+	/*
+	When the task started in the last run, relative to startTime
+	*/
+	double startMilliseconds(TaskId id) const {
+		return m_tasks[id]->startMilliseconds;
+	}
+
+	std::chrono::high_resolution_clock::time_point startTime() const {
+		return m_startTime;
+	}
+
+private:
+	struct Task {
+		const char* name = nullptr;
+		std::function<void()> function;
+		std::vector<TaskId> dependents;
+		uint32_t dependencyCount = 0;
+		std::atomic<uint32_t> pending{ 0 };
+		double milliseconds = 0.0;
+		double startMilliseconds = 0.0;
+	};
+
+	void launch(ThreadPool& pool, TaskId id) {
+		pool.submit([this, &pool, id]() { execute(pool, id); });
+	}
+
+	void execute(ThreadPool& pool, TaskId id) {
+		Task& task = *m_tasks[id];
+		auto start = std::chrono::high_resolution_clock::now();
+		task.startMilliseconds = std::chrono::duration<double, std::milli>(start - m_startTime).count();
+		task.milliseconds = 0.0;
+		if (!m_failed) {
+			try {
+				task.function();
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(m_exceptionMutex);
+				if (!m_exception) {
+					m_exception = std::current_exception();
+				}
+				m_failed = true;
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			task.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+		}
+
+		for (TaskId dependent : task.dependents) {
+			if (--m_tasks[dependent]->pending == 0) {
+				launch(pool, dependent);
+			}
+		}
+		//Last, waiting thread may return and destroy the graph right after
+		m_remaining--;
+	}
+
+	std::vector<std::unique_ptr<Task>>	m_tasks;
+	std::atomic<uint32_t>				m_remaining{ 0 };
+	std::atomic<bool>					m_failed{ false };
+	std::mutex							m_exceptionMutex;
+	std::exception_ptr					m_exception;
+	std::chrono::high_resolution_clock::time_point	m_startTime;
+};
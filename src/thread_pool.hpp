@@ -0,0 +1,201 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+/*
+Work-stealing thread pool.
+Every thread owns a deque of tasks: it pops its own tasks from the back
+(most recent, cache warm) and when it runs dry, it steals from the front
+of other deques (oldest, usually the biggest remaining work).
+Thread which waits for work to finish keeps executing tasks meanwhile,
+so the calling thread always takes part and nested waits can not deadlock.
+Pool of size 1 has no workers and runs everything inline
+*/
+class ThreadPool {
+public:
+	explicit ThreadPool(uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+		threadCount = std::max(threadCount, 1u);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			m_queues.emplace_back(new WorkQueue());
+		}
+		for (uint32_t i = 1; i < threadCount; i++) {
+			m_workers.emplace_back([this, i]() { workerLoop(i); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/*
+	Number of threads executing tasks, including the calling one
+	*/
+	uint32_t size() const {
+		return static_cast<uint32_t>(m_queues.size());
+	}
+
+	/*
+	Queues task on the calling thread's deque, other threads may steal it
+	*/
+	void submit(std::function<void()> task) {
+		//Counted before it is visible, so the count never drops below zero
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_queuedTasks++;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_queues[currentQueue()]->mutex);
+			m_queues[currentQueue()]->tasks.push_back(std::move(task));
+		}
+		m_wake.notify_one();
+	}
+
+	/*
+	Runs queued tasks until done() returns true
+	*/
+	void waitUntil(const std::function<bool()>& done) {
+		while (!done()) {
+			if (!tryRunTask(currentQueue())) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	/*
+	Calls function(begin, end) for chunks of [0, count) and returns when all are done.
+	Chunks are dealt out to all deques in contiguous blocks, so each thread starts on
+	neighbouring data and stealing only rebalances the tail. Function must not throw
+	*/
+	void parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& function) {
+		if (count == 0) {
+			return;
+		}
+		chunkSize = std::max<size_t>(chunkSize, 1);
+		if (m_workers.empty() || count <= chunkSize) {
+			function(0, count);
+			return;
+		}
+
+		const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+		const size_t queueCount = m_queues.size();
+		const size_t self = currentQueue();
+		std::atomic<size_t> remaining(chunkCount);
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_queuedTasks += chunkCount;
+		}
+
+		for (size_t q = 0; q < queueCount; q++) {
+			//Calling thread gets the first block, it starts working right away
+			size_t queue = (self + q) % queueCount;
+			size_t firstChunk = chunkCount * q / queueCount;
+			size_t lastChunk = chunkCount * (q + 1) / queueCount;
+
+			std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+			//Owner pops from the back, so push in reverse to run chunks in order
+			for (size_t chunk = lastChunk; chunk-- > firstChunk;) {
+				size_t begin = chunk * chunkSize;
+				size_t end = std::min(begin + chunkSize, count);
+				m_queues[queue]->tasks.push_back([&function, &remaining, begin, end]() {
+					function(begin, end);
+					remaining--;
+				});
+			}
+		}
+		m_wake.notify_all();
+
+		waitUntil([&remaining]() { return remaining == 0; });
+	}
+
+private:
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	/*
+	Deque of the calling thread, threads outside of the pool share deque 0
+	*/
+	uint32_t currentQueue() const {
+		return currentPool() == this ? currentPoolQueue() : 0;
+	}
+
+	static const ThreadPool*& currentPool() {
+		static thread_local const ThreadPool* pool = nullptr;
+		return pool;
+	}
+
+	static uint32_t& currentPoolQueue() {
+		static thread_local uint32_t queue = 0;
+		return queue;
+	}
+
+	bool tryRunTask(uint32_t self) {
+		std::function<void()> task;
+		{
+			std::lock_guard<std::mutex> lock(m_queues[self]->mutex);
+			if (!m_queues[self]->tasks.empty()) {
+				task = std::move(m_queues[self]->tasks.back());
+				m_queues[self]->tasks.pop_back();
+			}
+		}
+		for (size_t i = 1; !task && i < m_queues.size(); i++) {
+			WorkQueue& victim = *m_queues[(self + i) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+			}
+		}
+		if (!task) {
+			return false;
+		}
+
+		m_queuedTasks--;
+		task();
+		return true;
+	}
+
+	void workerLoop(uint32_t index) {
+		currentPool() = this;
+		currentPoolQueue() = index;
+
+		while (true) {
+			if (tryRunTask(index)) {
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_wake.wait(lock, [this]() { return m_stop || m_queuedTasks > 0; });
+			if (m_stop && m_queuedTasks == 0) {
+				return;
+			}
+		}
+	}
+
+	std::vector<std::unique_ptr<WorkQueue>>	m_queues;
+	std::vector<std::thread>				m_workers;
+	std::mutex								m_sleepMutex;
+	std::condition_variable					m_wake;
+	std::atomic<size_t>						m_queuedTasks{ 0 };
+	bool									m_stop = false;
+};
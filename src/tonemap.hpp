@@ -0,0 +1,513 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+
+#include "descriptors.hpp"
+#include "push_constants.hpp"
+
+/*
+Scene is rendered into half floats, every device supports them as sampled color attachments
+*/
+const VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+/*
+Histogram bins, also the invocations of both compute workgroups (16x16 pixels, 256 bins)
+*/
+const uint32_t EXPOSURE_HISTOGRAM_BINS = 256;
+const uint32_t EXPOSURE_HISTOGRAM_GROUP_SIZE = 16;
+
+/*
+Log2 luminance covered by the histogram, darker and brighter pixels go to the end bins
+*/
+const float EXPOSURE_MIN_LOG_LUMINANCE = -10.0f;
+const float EXPOSURE_MAX_LOG_LUMINANCE = 4.0f;
+
+/*
+Exposure follows the scene with this rate per second of render time,
+so offline renders adapt the same way on every run
+*/
+const double EXPOSURE_ADAPTATION_RATE = 1.5;
+
+/*
+Middle grey the average luminance is mapped to
+*/
+const float EXPOSURE_KEY = 0.18f;
+
+struct ExposureConstants {
+	float minLogLuminance;
+	float logLuminanceRange;
+	float adaptation; //fraction of the way to the new average luminance
+	uint32_t renderWidth; //part of the HDR image the scene was rendered into
+	uint32_t renderHeight;
+};
+
+struct ToneMapConstants {
+	float key;
+	uint32_t encodeGamma; //swapchain is not sRGB, shader applies gamma
+	float uvScale[2]; //output pixel to HDR image coordinates of the rendered part
+	float uvMax[2]; //bilinear taps stay inside the rendered part
+};
+
+typedef PushConstantBlock<ExposureConstants, VK_SHADER_STAGE_COMPUTE_BIT> ExposurePushConstants;
+typedef PushConstantBlock<ToneMapConstants, VK_SHADER_STAGE_FRAGMENT_BIT> ToneMapPushConstants;
+
+/*
+Layout of exposureBuffer in the shaders. Histogram is cleared by the exposure pass
+once it is read, average luminance carries over to the next frame
+*/
+struct ExposureBuffer {
+	uint32_t bins[EXPOSURE_HISTOGRAM_BINS];
+	float averageLuminance;
+};
+
+/*
+Exposure of one view, outlives swapchain recreation so adaptation does not restart
+*/
+struct ExposureState {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	bool cleared = false;
+	double time = 0.0; //render time of the last adaptation
+};
+
+/*
+Descriptors of one HDR image. The image is recreated with the render graph while
+frames may still use the old one, so the set is released once they completed
+*/
+struct ToneMapView {
+	VkDescriptorSet set = VK_NULL_HANDLE;
+};
+
+inline bool isSrgbFormat(VkFormat format) {
+	return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+/*
+Auto-exposed tone mapping of the HDR scene, recorded as three render graph passes:
+	histogram: log luminance of every pixel is counted in shared memory of its
+			workgroup, which then adds its non-empty bins to the global histogram
+	exposure: one workgroup reduces the histogram to the average luminance (with
+			subgroup arithmetic when the device has it) and adapts the previous value towards it
+	tone map: full screen triangle upscales the rendered part of the HDR image, scales
+			radiance by the exposure, applies the filmic curve and dithers into the swapchain format
+Exposure never leaves the GPU, the CPU only records the passes
+*/
+class ToneMapper {
+public:
+	struct Shaders {
+		VkShaderModule histogram;
+		VkShaderModule exposure;
+		VkShaderModule vertex;
+		VkShaderModule fragment;
+	};
+
+	void init(VkDevice device, std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)> findMemoryType,
+		DescriptorLayoutCache& layoutCache, DescriptorAllocator& descriptorAllocator, VkFormat outputFormat, const Shaders& shaders) {
+		m_device = device;
+		m_findMemoryType = std::move(findMemoryType);
+		m_descriptorAllocator = &descriptorAllocator;
+		m_encodeGamma = !isSrgbFormat(outputFormat);
+
+		VkDescriptorSetLayoutBinding imageBinding = {};
+		imageBinding.binding = 0;
+		imageBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		imageBinding.descriptorCount = 1;
+		imageBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutBinding exposureBinding = {};
+		exposureBinding.binding = 1;
+		exposureBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		exposureBinding.descriptorCount = 1;
+		exposureBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		m_setLayout = layoutCache.getLayout({ imageBinding, exposureBinding });
+		m_computeLayout = createPipelineLayout(ExposurePushConstants::range());
+		m_toneMapLayout = createPipelineLayout(ToneMapPushConstants::range());
+
+		createSampler();
+		m_histogramPipeline = createComputePipeline(shaders.histogram);
+		m_exposurePipeline = createComputePipeline(shaders.exposure);
+		createRenderPass(outputFormat);
+		createToneMapPipeline(shaders.vertex, shaders.fragment);
+	}
+
+	void cleanup() {
+		vkDestroyPipeline(m_device, m_toneMapPipeline, nullptr);
+		vkDestroyPipeline(m_device, m_exposurePipeline, nullptr);
+		vkDestroyPipeline(m_device, m_histogramPipeline, nullptr);
+		vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+		vkDestroyPipelineLayout(m_device, m_toneMapLayout, nullptr);
+		vkDestroyPipelineLayout(m_device, m_computeLayout, nullptr);
+		vkDestroySampler(m_device, m_sampler, nullptr);
+	}
+
+	/*
+	Tone map pass renders into framebuffers of the swapchain images with it
+	*/
+	VkRenderPass renderPass() const {
+		return m_renderPass;
+	}
+
+	void createExposure(ExposureState& state) {
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = sizeof(ExposureBuffer);
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &state.buffer) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create exposure buffer!");
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetBufferMemoryRequirements(m_device, state.buffer, &requirements);
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = requirements.size;
+		allocInfo.memoryTypeIndex = m_findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &state.memory) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to allocate exposure buffer memory!");
+		}
+		vkBindBufferMemory(m_device, state.buffer, state.memory, 0);
+		//Zeroed by the first histogram pass
+		state.cleared = false;
+	}
+
+	void destroyExposure(ExposureState& state) {
+		vkDestroyBuffer(m_device, state.buffer, nullptr);
+		vkFreeMemory(m_device, state.memory, nullptr);
+		state = ExposureState();
+	}
+
+	ToneMapView createView(VkImageView hdrView, const ExposureState& state) {
+		ToneMapView view;
+		view.set = m_descriptorAllocator->allocate(m_setLayout);
+
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.sampler = m_sampler;
+		imageInfo.imageView = hdrView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = state.buffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet writes[2] = {};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = view.set;
+		writes[0].dstBinding = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].pImageInfo = &imageInfo;
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet = view.set;
+		writes[1].dstBinding = 1;
+		writes[1].descriptorCount = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[1].pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+
+		return view;
+	}
+
+	/*
+	Called once frames using the view completed, its set is reused by a later view
+	*/
+	void destroyView(const ToneMapView& view) {
+		m_descriptorAllocator->release(view.set, m_setLayout);
+	}
+
+	/*
+	HDR image must be readable by compute shaders, scene covers renderExtent of it
+	*/
+	void recordHistogram(VkCommandBuffer commandBuffer, const ToneMapView& view, ExposureState& state, VkExtent2D renderExtent) {
+		if (!state.cleared) {
+			vkCmdFillBuffer(commandBuffer, state.buffer, 0, VK_WHOLE_SIZE, 0);
+			bufferBarrier(commandBuffer, state.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			state.cleared = true;
+		}
+		else {
+			//Bins cleared by the previous frame's exposure pass
+			bufferBarrier(commandBuffer, state.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_histogramPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computeLayout, 0, 1, &view.set, 0, nullptr);
+		ExposurePushConstants::push(commandBuffer, m_computeLayout, exposureConstants(0.0, renderExtent));
+		vkCmdDispatch(commandBuffer,
+			(renderExtent.width + EXPOSURE_HISTOGRAM_GROUP_SIZE - 1) / EXPOSURE_HISTOGRAM_GROUP_SIZE,
+			(renderExtent.height + EXPOSURE_HISTOGRAM_GROUP_SIZE - 1) / EXPOSURE_HISTOGRAM_GROUP_SIZE, 1);
+	}
+
+	/*
+	Adapts towards the histogram average by the render time elapsed since the last frame
+	*/
+	void recordExposure(VkCommandBuffer commandBuffer, const ToneMapView& view, ExposureState& state, double renderTime) {
+		double elapsed = std::max(renderTime - state.time, 0.0);
+		state.time = renderTime;
+
+		//Previous frame's tone map still reads the average luminance this pass overwrites
+		bufferBarrier(commandBuffer, state.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_exposurePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computeLayout, 0, 1, &view.set, 0, nullptr);
+		//Histogram is complete, the extent is not used
+		ExposurePushConstants::push(commandBuffer, m_computeLayout, exposureConstants(1.0 - std::exp(-elapsed * EXPOSURE_ADAPTATION_RATE), VkExtent2D{ 0, 0 }));
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+	}
+
+	/*
+	HDR image must be readable by fragment shaders, framebuffer is the swapchain image.
+	Both have the extent, the scene covers renderExtent of the HDR image
+	*/
+	void recordToneMap(VkCommandBuffer commandBuffer, const ToneMapView& view, const ExposureState& state, VkFramebuffer framebuffer,
+		VkExtent2D extent, VkExtent2D renderExtent) {
+		bufferBarrier(commandBuffer, state.buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = m_renderPass;
+		renderPassInfo.framebuffer = framebuffer;
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = extent;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_toneMapPipeline);
+
+		VkViewport viewport = {};
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.extent = extent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_toneMapLayout, 0, 1, &view.set, 0, nullptr);
+		ToneMapConstants constants = {};
+		constants.key = EXPOSURE_KEY;
+		constants.encodeGamma = m_encodeGamma ? 1u : 0u;
+		//At full scale pixel centers hit texel centers, the image is copied unfiltered
+		constants.uvScale[0] = static_cast<float>(renderExtent.width) / (static_cast<float>(extent.width) * extent.width);
+		constants.uvScale[1] = static_cast<float>(renderExtent.height) / (static_cast<float>(extent.height) * extent.height);
+		constants.uvMax[0] = (renderExtent.width - 0.5f) / extent.width;
+		constants.uvMax[1] = (renderExtent.height - 0.5f) / extent.height;
+		ToneMapPushConstants::push(commandBuffer, m_toneMapLayout, constants);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+private:
+	static ExposureConstants exposureConstants(double adaptation, VkExtent2D renderExtent) {
+		ExposureConstants constants = {};
+		constants.minLogLuminance = EXPOSURE_MIN_LOG_LUMINANCE;
+		constants.logLuminanceRange = EXPOSURE_MAX_LOG_LUMINANCE - EXPOSURE_MIN_LOG_LUMINANCE;
+		constants.adaptation = static_cast<float>(adaptation);
+		constants.renderWidth = renderExtent.width;
+		constants.renderHeight = renderExtent.height;
+		return constants;
+	}
+
+	static void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+		VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	VkPipelineLayout createPipelineLayout(VkPushConstantRange pushConstantRange) {
+		VkPipelineLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &m_setLayout;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout layout;
+		if (vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create tone map pipeline layout!");
+		}
+		return layout;
+	}
+
+	/*
+	Bilinear upscale of scenes rendered below the swapchain extent, histogram reads texels directly
+	*/
+	void createSampler() {
+		VkSamplerCreateInfo samplerInfo = {};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = 0.0f;
+
+		if (vkCreateSampler(m_device, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create tone map sampler!");
+		}
+	}
+
+	VkPipeline createComputePipeline(VkShaderModule shader) {
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shader;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = m_computeLayout;
+
+		VkPipeline pipeline;
+		if (vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create exposure pipeline!");
+		}
+		return pipeline;
+	}
+
+	/*
+	Every pixel is overwritten, previous contents are not loaded. Render graph
+	transitions the swapchain image around the pass
+	*/
+	void createRenderPass(VkFormat outputFormat) {
+		VkAttachmentDescription colorAttachment = {};
+		colorAttachment.format = outputFormat;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentRef = {};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+
+		VkRenderPassCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		createInfo.attachmentCount = 1;
+		createInfo.pAttachments = &colorAttachment;
+		createInfo.subpassCount = 1;
+		createInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(m_device, &createInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create tone map render pass!");
+		}
+	}
+
+	void createToneMapPipeline(VkShaderModule vertexShader, VkShaderModule fragmentShader) {
+		VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = vertexShader;
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = fragmentShader;
+		shaderStages[1].pName = "main";
+
+		//Full screen triangle comes from gl_VertexIndex
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkPipelineViewportStateCreateInfo viewportState = {};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer = {};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+		VkPipelineMultisampleStateCreateInfo multisampling = {};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending = {};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+
+		VkDynamicState dynamicStates[] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+
+		VkPipelineDynamicStateCreateInfo dynamicState = {};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = m_toneMapLayout;
+		pipelineInfo.renderPass = m_renderPass;
+		pipelineInfo.subpass = 0;
+		pipelineInfo.basePipelineIndex = -1;
+
+		if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_toneMapPipeline) != VK_SUCCESS) {
+			throw std::runtime_error("ERROR: Failed to create tone map pipeline!");
+		}
+	}
+
+	VkDevice				m_device = VK_NULL_HANDLE;
+	std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)>	m_findMemoryType;
+	bool					m_encodeGamma = true;
+	VkDescriptorSetLayout	m_setLayout = VK_NULL_HANDLE; //owned by the layout cache
+	DescriptorAllocator*	m_descriptorAllocator = nullptr; //views allocate their sets from it
+	VkPipelineLayout		m_computeLayout = VK_NULL_HANDLE;
+	VkPipelineLayout		m_toneMapLayout = VK_NULL_HANDLE;
+	VkSampler				m_sampler = VK_NULL_HANDLE;
+	VkPipeline				m_histogramPipeline = VK_NULL_HANDLE;
+	VkPipeline				m_exposurePipeline = VK_NULL_HANDLE;
+	VkRenderPass			m_renderPass = VK_NULL_HANDLE;
+	VkPipeline				m_toneMapPipeline = VK_NULL_HANDLE;
+};
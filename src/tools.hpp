@@ -0,0 +1,370 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#include <thread>
+#include <atomic>
+
+#include "assets.hpp"
+#include "mesh.hpp"
+#include "mesh_import.hpp"
+#include "mesh_optimizer.hpp"
+#include "scene.hpp"
+#include "visibility.hpp"
+#include "thread_pool.hpp"
+
+/*
+Offline tools reachable from the command line, see main()
+*/
+
+inline int packAssetsTool(int argc, char* argv[]) {
+	if (argc < 4) {
+		std::cerr << "Usage: " << argv[0] << " --pack <archive> <files...>" << std::endl;
+		return EXIT_FAILURE;
+	}
+	writeAssetArchive(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+
+	return EXIT_SUCCESS;
+}
+
+/*
+Converts OBJ files into .vmesh, arguments go in <input> <output> pairs.
+Vertices are packed into MeshVertexLayout unless --standard is given.
+Meshes are optimized (see mesh_optimizer.hpp) unless --no-optimize is given.
+Conversion of separate meshes is independent, so it runs on all hardware threads
+*/
+inline int convertMeshTool(int argc, char* argv[]) {
+	int first = 2;
+	bool standardLayout = false;
+	bool optimize = true;
+	for (; first < argc && std::string(argv[first]).compare(0, 2, "--") == 0; first++) {
+		std::string option = argv[first];
+		if (option == "--standard") {
+			standardLayout = true;
+		}
+		else if (option == "--no-optimize") {
+			optimize = false;
+		}
+		else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - first < 2 || (argc - first) % 2 != 0) {
+		std::cerr << "Usage: " << argv[0] << " --convert-mesh [--standard] [--no-optimize] <input.obj> <output.vmesh> [<input.obj> <output.vmesh> ...]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	struct ConversionJob {
+		std::string input;
+		std::string output;
+		std::string report;
+		std::string error;
+	};
+	std::vector<ConversionJob> jobs;
+	for (int i = first; i < argc; i += 2) {
+		ConversionJob job;
+		job.input = argv[i];
+		job.output = argv[i + 1];
+		jobs.push_back(job);
+	}
+
+	auto convert = [standardLayout, optimize](ConversionJob& job) {
+		ImportedMesh imported = importObj(job.input);
+		std::ostringstream report;
+		if (optimize) {
+			MeshOptimizationStats stats = optimizeMesh(imported);
+			report << std::fixed << std::setprecision(3)
+				<< "\n  vertices " << stats.vertexCountBefore << " -> " << stats.vertexCountAfter
+				<< ", ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+				<< ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr;
+		}
+		MeshData mesh = standardLayout ? buildMeshData<StandardVertexLayout>(imported) : buildMeshData<MeshVertexLayout>(imported);
+
+		std::ofstream out(job.output, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) {
+			throw std::runtime_error("ERROR: Failed to create " + job.output + "!");
+		}
+		writeMeshFile(out, mesh);
+
+		std::ostringstream summary;
+		summary << job.input << " -> " << job.output << ": " << mesh.vertexCount << " vertices, "
+			<< mesh.indexCount / 3 << " triangles, " << mesh.vertexStride << "B per vertex, "
+			<< (mesh.indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << "-bit indices, " << mesh.meshletData.size() / MESHLET_SIZE << " meshlets" << report.str();
+		job.report = summary.str();
+	};
+
+	//Workers pick up meshes one by one, so one big mesh does not hold back the rest
+	std::atomic<size_t> nextJob(0);
+	auto worker = [&jobs, &nextJob, &convert]() {
+		for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+			try {
+				convert(jobs[i]);
+			}
+			catch (const std::exception& e) {
+				jobs[i].error = e.what();
+			}
+		}
+	};
+
+	size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), jobs.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threadCount; i++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	int result = EXIT_SUCCESS;
+	for (const auto& job : jobs) {
+		if (job.error.empty()) {
+			std::cout << job.report << std::endl;
+		}
+		else {
+			std::cerr << job.input << ": " << job.error << std::endl;
+			result = EXIT_FAILURE;
+		}
+	}
+
+	return result;
+}
+
+/*
+Returns median duration in milliseconds of given number of runs
+*/
+template<typename Function>
+double benchmarkMedian(int iterations, Function function) {
+	std::vector<double> times;
+	for (int i = 0; i < iterations; i++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		function();
+		auto end = std::chrono::high_resolution_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	std::sort(times.begin(), times.end());
+
+	return times[times.size() / 2];
+}
+
+/*
+Measures load time of a mesh file into preallocated memory standing in
+for the staging buffer. Compares the old whole-file copy approach with
+chunked streaming and memory mapping. First run warms the page cache,
+so the numbers show the CPU side cost of each path
+*/
+inline int benchmarkMeshTool(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " --bench-mesh <mesh.vmesh> [iterations]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const std::string filename = argv[2];
+	const int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 20;
+
+	MeshFile mesh;
+	mesh.open(filename);
+	std::vector<char> staging(static_cast<size_t>(mesh.sectionSize(MESH_SECTION_VERTICES) + mesh.sectionSize(MESH_SECTION_INDICES)));
+	char* vertexDst = staging.data();
+	char* indexDst = staging.data() + mesh.sectionSize(MESH_SECTION_VERTICES);
+
+	double wholeFile = benchmarkMedian(iterations, [&]() {
+		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+		std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(buffer.data(), buffer.size());
+
+		const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(buffer.data());
+		const MeshSection* vertexSection = header->findSection(MESH_SECTION_VERTICES);
+		const MeshSection* indexSection = header->findSection(MESH_SECTION_INDICES);
+		memcpy(vertexDst, buffer.data() + vertexSection->offset, static_cast<size_t>(vertexSection->size));
+		memcpy(indexDst, buffer.data() + indexSection->offset, static_cast<size_t>(indexSection->size));
+	});
+
+	double streamed = benchmarkMedian(iterations, [&]() {
+		MeshFile streamedMesh;
+		streamedMesh.open(filename);
+		streamedMesh.readSection(MESH_SECTION_VERTICES, vertexDst);
+		streamedMesh.readSection(MESH_SECTION_INDICES, indexDst);
+	});
+
+	double mapped = benchmarkMedian(iterations, [&]() {
+		MappedFile file(filename);
+		MeshFile mappedMesh;
+		mappedMesh.open(file.view(), filename);
+		mappedMesh.readSection(MESH_SECTION_VERTICES, vertexDst);
+		mappedMesh.readSection(MESH_SECTION_INDICES, indexDst);
+	});
+
+	double megabytes = staging.size() / (1024.0 * 1024.0);
+	std::cout << filename << ": " << mesh.header().vertexCount << " vertices, " << mesh.header().indexCount << " indices, "
+		<< megabytes << " MiB, median of " << iterations << " runs" << std::endl;
+	std::cout << "  whole file + copy : " << wholeFile << " ms (" << megabytes / (wholeFile / 1000.0) << " MiB/s)" << std::endl;
+	std::cout << "  chunked streaming : " << streamed << " ms (" << megabytes / (streamed / 1000.0) << " MiB/s)" << std::endl;
+	std::cout << "  memory mapped     : " << mapped << " ms (" << megabytes / (mapped / 1000.0) << " MiB/s)" << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+Measures scene update of a generated hierarchy (8 children per node) on one
+thread and on all hardware threads. World matrices are also written into
+a separate array, standing in for the mapped object buffer.
+Then measures visibility stage with random draw states and a view
+which sees roughly a quarter of the scene
+*/
+inline int benchmarkSceneTool(int argc, char* argv[]) {
+	const size_t nodeCount = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 1000000;
+	const int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 20;
+
+	uint32_t seed = 1;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+	};
+
+	Scene scene;
+	for (size_t i = 0; i < nodeCount; i++) {
+		SceneNode node = scene.addNode(i == 0 ? SCENE_NO_PARENT : static_cast<SceneNode>((i - 1) / 8));
+		glm::vec4 rotation(random() - 0.5f, random() - 0.5f, random() - 0.5f, random() - 0.5f);
+		rotation = rotation / std::sqrt(glm::dot(rotation, rotation));
+		scene.setTranslation(node, glm::vec3(random() * 2.0f - 1.0f, random() * 2.0f - 1.0f, random() * 2.0f - 1.0f));
+		scene.setRotation(node, glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+		scene.setScale(node, glm::vec3(0.5f + random()));
+		scene.setLocalBounds(node, glm::vec3(0.0f), glm::vec3(1.0f));
+		scene.setDrawState(node, makeDrawStateKey(static_cast<uint16_t>(random() * 8), static_cast<uint16_t>(random() * 64), static_cast<uint16_t>(random() * 256)));
+	}
+
+	std::vector<glm::mat4> objects(nodeCount);
+	ThreadPool singleThread(1);
+	ThreadPool pool;
+	double single = benchmarkMedian(iterations, [&]() { scene.update(singleThread, objects.data()); });
+	double parallel = benchmarkMedian(iterations, [&]() { scene.update(pool, objects.data()); });
+
+	std::cout << nodeCount << " nodes, median of " << iterations << " runs" << std::endl;
+	std::cout << "  1 thread   : " << single << " ms (" << nodeCount / (single * 1000.0) << " M nodes/s)" << std::endl;
+	std::cout << "  " << pool.size() << " threads" << (pool.size() < 10 ? "  " : " ") << ": " << parallel << " ms ("
+		<< nodeCount / (parallel * 1000.0) << " M nodes/s)" << std::endl;
+
+	glm::mat4 viewProjection(1.0f);
+	viewProjection[0][0] = 0.25f;
+	viewProjection[3][0] = -0.75f;
+	viewProjection[1][1] = 0.25f;
+	viewProjection[3][1] = -0.75f;
+	viewProjection[2][2] = 0.01f;
+	viewProjection[3][2] = 0.5f;
+	VisibilityStage visibility;
+	double visibilityTime = benchmarkMedian(iterations, [&]() { visibility.run(pool, scene, viewProjection); });
+	const VisibilityStats& stats = visibility.stats();
+	std::cout << "  visibility : " << visibilityTime << " ms (cull " << stats.cullMilliseconds << " ms, sort " << stats.sortMilliseconds << " ms), "
+		<< stats.visible << " visible, " << stats.culled << " culled, " << stats.stateChanges << " state changes" << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+Case text is pasted into a shell command, so only characters without
+a meaning to sh or cmd are accepted: names, numbers, paths and option values
+*/
+inline bool isPlainCaseText(const std::string& text) {
+	const std::string punctuation = " \t_-./:=+,";
+	return std::all_of(text.begin(), text.end(), [&punctuation](char c) {
+		return std::isalnum(static_cast<unsigned char>(c)) || punctuation.find(c) != std::string::npos;
+	});
+}
+
+/*
+Runs golden image cases, each in its own process of this executable, as many
+at once as there are hardware threads (or jobs). Suite file has one case per line,
+	<name> <application options>
+empty lines and lines starting with # are skipped. A case passes when the process
+exits successfully, so it should capture with --capture-format compare,
+--offline-fps and --headless. Output of each case goes to <name>.log.
+For a software device point VK_ICD_FILENAMES to the lavapipe ICD and add --device llvmpipe
+*/
+inline int goldenSuiteTool(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " --golden-suite <suite file> [jobs]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::ifstream suite(argv[2]);
+	if (!suite.is_open()) {
+		std::cerr << "Failed to open " << argv[2] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	struct GoldenCase {
+		std::string name;
+		std::string options;
+		int exitCode = 0;
+		double seconds = 0.0;
+	};
+	std::vector<GoldenCase> cases;
+	std::string line;
+	for (size_t lineNumber = 1; std::getline(suite, line); lineNumber++) {
+		//Suites edited on Windows keep the carriage return
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		std::istringstream stream(line);
+		GoldenCase golden;
+		if (!(stream >> golden.name) || golden.name[0] == '#') {
+			continue;
+		}
+		std::getline(stream, golden.options);
+		if (!isPlainCaseText(golden.name) || !isPlainCaseText(golden.options)) {
+			std::cerr << argv[2] << ":" << lineNumber << ": case " << golden.name << " has characters the shell would interpret" << std::endl;
+			return EXIT_FAILURE;
+		}
+		cases.push_back(golden);
+	}
+
+	const std::string executable = argv[0];
+	auto run = [&executable](GoldenCase& golden) {
+		std::string command = "\"" + executable + "\" " + golden.options + " > \"" + golden.name + ".log\" 2>&1";
+#ifdef _WIN32
+		//cmd strips the outer quotes of a command starting with one
+		command = "\"" + command + "\"";
+#endif
+		auto start = std::chrono::high_resolution_clock::now();
+		golden.exitCode = std::system(command.c_str());
+		auto end = std::chrono::high_resolution_clock::now();
+		golden.seconds = std::chrono::duration<double>(end - start).count();
+	};
+
+	std::atomic<size_t> nextCase(0);
+	auto worker = [&cases, &nextCase, &run]() {
+		for (size_t i = nextCase++; i < cases.size(); i = nextCase++) {
+			run(cases[i]);
+		}
+	};
+
+	size_t jobs = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : std::max(1u, std::thread::hardware_concurrency());
+	size_t threadCount = std::min(jobs, std::max<size_t>(cases.size(), 1));
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threadCount; i++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	size_t failed = 0;
+	for (const auto& golden : cases) {
+		std::cout << (golden.exitCode == 0 ? "PASS " : "FAIL ") << golden.name << " (" << golden.seconds << " s)" << std::endl;
+		failed += golden.exitCode == 0 ? 0 : 1;
+	}
+	std::cout << cases.size() - failed << "/" << cases.size() << " golden cases passed" << std::endl;
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <tuple>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+/*
+Converts float into IEEE half, rounding to nearest even.
+Overflow goes to infinity, tiny values become half denormals
+*/
+inline uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	uint32_t exponent = (bits >> 23) & 0xffu;
+	uint32_t mantissa = bits & 0x7fffffu;
+
+	if (exponent == 0xffu) { //Inf or NaN, keep NaN quiet
+		return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+	}
+
+	int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+	if (halfExponent >= 0x1f) {
+		return static_cast<uint16_t>(sign | 0x7c00u);
+	}
+
+	if (halfExponent <= 0) {
+		if (halfExponent < -10) {
+			return static_cast<uint16_t>(sign);
+		}
+		//Denormal: shift in the implicit one and round
+		mantissa |= 0x800000u;
+		uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+		uint32_t halfMantissa = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1u);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (halfMantissa & 1u))) {
+			halfMantissa++;
+		}
+		return static_cast<uint16_t>(sign | halfMantissa);
+	}
+
+	uint32_t half = sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fffu;
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+		half++; //May carry into exponent, which correctly rounds up to next power of two or infinity
+	}
+	return static_cast<uint16_t>(half);
+}
+
+inline uint8_t floatToUnorm8(float value) {
+	return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+/*
+Vertex attribute types
+Each one knows its Vulkan format, packed size and how to pack its source value.
+	Float2Attribute: vec2 as VK_FORMAT_R32G32_SFLOAT (8B)
+	Float3Attribute: vec3 as VK_FORMAT_R32G32B32_SFLOAT (12B)
+	Half2Attribute: vec2 as VK_FORMAT_R16G16_SFLOAT (4B)
+	Unorm8x4Attribute: vec3 color as VK_FORMAT_R8G8B8A8_UNORM with alpha 1 (4B)
+Shaders keep reading vec2/vec3 inputs, the conversion happens in the vertex fetch
+*/
+struct Float2Attribute {
+	typedef glm::vec2 Source;
+	static const VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+	static const uint32_t size = 8;
+
+	static void pack(const Source& value, char* dst) {
+		const float packed[] = { value.x, value.y };
+		memcpy(dst, packed, size);
+	}
+};
+
+struct Float3Attribute {
+	typedef glm::vec3 Source;
+	static const VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+	static const uint32_t size = 12;
+
+	static void pack(const Source& value, char* dst) {
+		const float packed[] = { value.x, value.y, value.z };
+		memcpy(dst, packed, size);
+	}
+};
+
+struct Half2Attribute {
+	typedef glm::vec2 Source;
+	static const VkFormat format = VK_FORMAT_R16G16_SFLOAT;
+	static const uint32_t size = 4;
+
+	static void pack(const Source& value, char* dst) {
+		const uint16_t packed[] = { floatToHalf(value.x), floatToHalf(value.y) };
+		memcpy(dst, packed, size);
+	}
+};
+
+struct Unorm8x4Attribute {
+	typedef glm::vec3 Source;
+	static const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	static const uint32_t size = 4;
+
+	static void pack(const Source& value, char* dst) {
+		const uint8_t packed[] = { floatToUnorm8(value.x), floatToUnorm8(value.y), floatToUnorm8(value.z), 255 };
+		memcpy(dst, packed, size);
+	}
+};
+
+/*
+Compile time size and offset helpers for attribute lists
+*/
+template<typename... Attributes>
+struct AttributeSizeSum;
+
+template<>
+struct AttributeSizeSum<> {
+	static const uint32_t value = 0;
+};
+
+template<typename First, typename... Rest>
+struct AttributeSizeSum<First, Rest...> {
+	static const uint32_t value = First::size + AttributeSizeSum<Rest...>::value;
+};
+
+template<size_t Index, typename... Attributes>
+struct AttributeOffset;
+
+template<typename First, typename... Rest>
+struct AttributeOffset<0, First, Rest...> {
+	static const uint32_t value = 0;
+};
+
+template<size_t Index, typename First, typename... Rest>
+struct AttributeOffset<Index, First, Rest...> {
+	static const uint32_t value = First::size + AttributeOffset<Index - 1, Rest...>::value;
+};
+
+/*
+Tightly packed interleaved vertex made of given attributes.
+Attribute i is bound to shader location i, binding and attribute
+descriptions are generated at compile time from the attribute list
+*/
+template<typename... Attributes>
+struct VertexLayout {
+	static const uint32_t attributeCount = sizeof...(Attributes);
+	static const uint32_t stride = AttributeSizeSum<Attributes...>::value;
+
+	template<size_t Index>
+	using Attribute = typename std::tuple_element<Index, std::tuple<Attributes...>>::type;
+
+	/*
+	Returns description of at which rate to load data from memory throughout the vertices
+	*/
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = stride;
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, attributeCount> getAttributeDescriptions() {
+		return makeAttributeDescriptions(std::index_sequence_for<Attributes...>());
+	}
+
+	/*
+	Writes one vertex at dst, values go in the attribute order
+	*/
+	static void pack(char* dst, const typename Attributes::Source&... values) {
+		packAttributes(std::index_sequence_for<Attributes...>(), dst, values...);
+	}
+
+private:
+	template<size_t... Indices>
+	static std::array<VkVertexInputAttributeDescription, attributeCount> makeAttributeDescriptions(std::index_sequence<Indices...>) {
+		return { {
+			{ static_cast<uint32_t>(Indices), 0, Attribute<Indices>::format, AttributeOffset<Indices, Attributes...>::value }...
+		} };
+	}
+
+	template<size_t... Indices>
+	static void packAttributes(std::index_sequence<Indices...>, char* dst, const typename Attributes::Source&... values) {
+		int expand[] = { 0, (Attribute<Indices>::pack(values, dst + AttributeOffset<Indices, Attributes...>::value), 0)... };
+		(void)expand;
+	}
+};
+
+/*
+Position + color layouts
+	StandardVertexLayout: full precision, 20B per vertex
+	CompactVertexLayout: half float position and 8-bit color, 8B per vertex
+*/
+typedef VertexLayout<Float2Attribute, Float3Attribute> StandardVertexLayout;
+typedef VertexLayout<Half2Attribute, Unorm8x4Attribute> CompactVertexLayout;
+
+static_assert(StandardVertexLayout::stride == 20, "Standard vertex is expected to be 20B");
+static_assert(CompactVertexLayout::stride == 8, "Compact vertex is expected to be 8B");
+
+/*
+Smallest index type able to address all vertices.
+0xFFFF is kept free, it is the primitive restart value for 16-bit indices
+*/
+inline VkIndexType chooseIndexType(size_t vertexCount) {
+	return vertexCount < 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
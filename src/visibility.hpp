@@ -0,0 +1,230 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "math.hpp"
+#include "scene.hpp"
+#include "thread_pool.hpp"
+
+/*
+Scene nodes per culling task
+*/
+const size_t VISIBILITY_CHUNK_SIZE = 16384;
+
+/*
+Draw sort key, most significant bits change state the most expensively:
+	pipeline (16b) | descriptor set (16b) | mesh (16b) | depth (16b)
+Depth is filled in by culling, so draws sharing all state go front to back
+*/
+inline uint64_t makeDrawStateKey(uint16_t pipeline, uint16_t descriptorSet, uint16_t mesh) {
+	return (uint64_t(pipeline) << 48) | (uint64_t(descriptorSet) << 32) | (uint64_t(mesh) << 16);
+}
+
+struct DrawItem {
+	uint64_t key;
+	uint32_t object; //scene node index, also index into the object buffer
+	uint32_t reserved;
+};
+
+struct VisibilityStats {
+	uint32_t drawable = 0;
+	uint32_t visible = 0;
+	uint32_t culled = 0;
+	uint32_t stateChanges = 0; //pipeline, descriptor set or mesh switches in sorted list
+	double cullMilliseconds = 0.0;
+	double sortMilliseconds = 0.0;
+};
+
+/*
+Per-frame visibility: culls world bounds of all drawable scene nodes against
+the view frustum in parallel chunks and radix sorts survivors by draw key
+*/
+class VisibilityStage {
+public:
+	const std::vector<DrawItem>& run(ThreadPool& pool, const Scene& scene, const glm::mat4& viewProjection) {
+		auto cullStart = std::chrono::high_resolution_clock::now();
+
+		glm::vec4 planes[6];
+		extractFrustumPlanes(viewProjection, planes);
+		const glm::vec4 depthRow(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		const glm::vec4 wRow(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		const size_t count = scene.size();
+		const size_t chunkCount = (count + VISIBILITY_CHUNK_SIZE - 1) / VISIBILITY_CHUNK_SIZE;
+		//Inline runs put the whole range into the first chunk, others must not keep old draws
+		m_chunkDraws.resize(std::max<size_t>(chunkCount, m_chunkDraws.size()));
+		for (auto& chunkDraws : m_chunkDraws) {
+			chunkDraws.clear();
+		}
+		m_chunkDrawable.assign(chunkCount, 0);
+
+		pool.parallelFor(count, VISIBILITY_CHUNK_SIZE, [&](size_t begin, size_t end) {
+			size_t chunk = begin / VISIBILITY_CHUNK_SIZE;
+			m_chunkDrawable[chunk] = cullRange(scene, planes, depthRow, wRow, begin, end, m_chunkDraws[chunk]);
+		});
+
+		m_draws.clear();
+		m_stats.drawable = 0;
+		for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+			m_draws.insert(m_draws.end(), m_chunkDraws[chunk].begin(), m_chunkDraws[chunk].end());
+			m_stats.drawable += m_chunkDrawable[chunk];
+		}
+
+		auto sortStart = std::chrono::high_resolution_clock::now();
+		radixSort();
+		auto sortEnd = std::chrono::high_resolution_clock::now();
+
+		m_stats.visible = static_cast<uint32_t>(m_draws.size());
+		m_stats.culled = m_stats.drawable - m_stats.visible;
+		m_stats.stateChanges = 0;
+		for (size_t i = 0; i < m_draws.size(); i++) {
+			m_stats.stateChanges += i == 0 || (m_draws[i].key >> 16) != (m_draws[i - 1].key >> 16);
+		}
+		m_stats.cullMilliseconds = std::chrono::duration<double, std::milli>(sortStart - cullStart).count();
+		m_stats.sortMilliseconds = std::chrono::duration<double, std::milli>(sortEnd - sortStart).count();
+
+		return m_draws;
+	}
+
+	const std::vector<DrawItem>& draws() const {
+		return m_draws;
+	}
+
+	const VisibilityStats& stats() const {
+		return m_stats;
+	}
+
+private:
+	/*
+	Box vs plane: box is outside if its center is further behind the plane
+	than the box extent projected onto the plane normal.
+	Returns number of drawable nodes in the range
+	*/
+	static uint32_t cullRange(const Scene& scene, const glm::vec4 planes[6], const glm::vec4& depthRow, const glm::vec4& wRow,
+		size_t begin, size_t end, std::vector<DrawItem>& draws) {
+		const SceneBounds& bounds = scene.worldBounds();
+		const std::vector<uint64_t>& drawStates = scene.drawStates();
+		uint32_t drawable = 0;
+
+		auto emit = [&](size_t i) {
+			float depth = depthRow.x * bounds.centerX[i] + depthRow.y * bounds.centerY[i] + depthRow.z * bounds.centerZ[i] + depthRow.w;
+			float w = wRow.x * bounds.centerX[i] + wRow.y * bounds.centerY[i] + wRow.z * bounds.centerZ[i] + wRow.w;
+			float normalized = w > 0.0f ? std::min(std::max(depth / w, 0.0f), 1.0f) : 0.0f;
+
+			DrawItem item;
+			item.key = drawStates[i] | static_cast<uint64_t>(normalized * 65535.0f);
+			item.object = static_cast<uint32_t>(i);
+			item.reserved = 0;
+			draws.push_back(item);
+		};
+
+		size_t i = begin;
+#ifdef SCENE_USE_SSE
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; p++) {
+			planeX[p] = _mm_set1_ps(planes[p].x);
+			planeY[p] = _mm_set1_ps(planes[p].y);
+			planeZ[p] = _mm_set1_ps(planes[p].z);
+			planeW[p] = _mm_set1_ps(planes[p].w);
+			absX[p] = _mm_set1_ps(std::abs(planes[p].x));
+			absY[p] = _mm_set1_ps(std::abs(planes[p].y));
+			absZ[p] = _mm_set1_ps(std::abs(planes[p].z));
+		}
+		const __m128 zero = _mm_setzero_ps();
+
+		for (; i + 4 <= end; i += 4) {
+			__m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+			__m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+			__m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+			__m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+			__m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+			__m128 inside = _mm_cmpeq_ps(zero, zero);
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			for (size_t k = 0; k < 4; k++) {
+				if (drawStates[i + k] != DRAW_STATE_NONE) {
+					drawable++;
+					if (mask & (1 << k)) {
+						emit(i + k);
+					}
+				}
+			}
+		}
+#endif
+		for (; i < end; i++) {
+			if (drawStates[i] == DRAW_STATE_NONE) {
+				continue;
+			}
+			drawable++;
+
+			bool inside = true;
+			for (int p = 0; p < 6; p++) {
+				float distance = planes[p].x * bounds.centerX[i] + planes[p].y * bounds.centerY[i] + planes[p].z * bounds.centerZ[i] + planes[p].w;
+				float radius = std::abs(planes[p].x) * bounds.extentX[i] + std::abs(planes[p].y) * bounds.extentY[i] + std::abs(planes[p].z) * bounds.extentZ[i];
+				inside &= distance + radius >= 0.0f;
+			}
+			if (inside) {
+				emit(i);
+			}
+		}
+
+		return drawable;
+	}
+
+	/*
+	LSD radix sort over 8-bit digits of the key, stable.
+	All histograms are built in one pass and digits shared by all keys
+	(typically most of them, few pipelines and meshes) are skipped
+	*/
+	void radixSort() {
+		const size_t count = m_draws.size();
+		if (count < 2) {
+			return;
+		}
+
+		size_t histograms[8][256] = {};
+		for (const auto& draw : m_draws) {
+			for (int digit = 0; digit < 8; digit++) {
+				histograms[digit][(draw.key >> (digit * 8)) & 0xff]++;
+			}
+		}
+
+		m_sortScratch.resize(count);
+		for (int digit = 0; digit < 8; digit++) {
+			size_t* histogram = histograms[digit];
+			if (histogram[(m_draws[0].key >> (digit * 8)) & 0xff] == count) {
+				continue;
+			}
+
+			size_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++) {
+				size_t bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+			for (const auto& draw : m_draws) {
+				m_sortScratch[histogram[(draw.key >> (digit * 8)) & 0xff]++] = draw;
+			}
+			m_draws.swap(m_sortScratch);
+		}
+	}
+
+	std::vector<std::vector<DrawItem>>	m_chunkDraws;
+	std::vector<uint32_t>				m_chunkDrawable;
+	std::vector<DrawItem>				m_draws;
+	std::vector<DrawItem>				m_sortScratch;
+	VisibilityStats						m_stats;
+};